@@ -0,0 +1,613 @@
+// Micro and macro benchmarks for NeuralNetworkLib. Every case is warmed up,
+// calibrated so one sample lasts at least --min-time seconds, and sampled
+// --repetitions times; the summary statistics are written as JSON so runs on
+// different commits can be diffed.
+//
+//   run_benchmarks [--filter=substring] [--repetitions=N] [--min-time=seconds]
+//                  [--rows=N] [--out=file.json | --out=-] [--list]
+#include "../include/ActivationFunctions.h"
+#include "../include/Adam.h"
+#include "../include/CpuFeatures.h"
+#include "../include/DataLoader.h"
+#include "../include/DataPipeline.h"
+#include "../include/InferencePlan.h"
+#include "../include/Layer.h"
+#include "../include/LossFunction.h"
+#include "../include/Momentum.h"
+#include "../include/NeuralNetwork.h"
+#include "../include/SGD.h"
+#include "../include/StaticNetwork.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+    struct Options {
+        std::string filter;
+        size_t repetitions = 15;
+        double minTime = 0.005;
+        size_t rows = 20000;
+        std::string output = "benchmark_results.json";
+        bool list = false;
+    };
+
+    struct Result {
+        std::string name;
+        size_t iterations = 0;
+        // nanoseconds per iteration, one entry per repetition, sorted
+        std::vector<double> samples;
+        double items = 0;
+        std::string unit;
+    };
+
+    // Keeps the compiler from discarding a computation whose result is unused.
+    template <typename T>
+    void keep(const T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    double percentile(const std::vector<double>& sorted, double p) {
+        const double position = p * (sorted.size() - 1);
+        const size_t below = static_cast<size_t>(position);
+        const size_t above = std::min(below + 1, sorted.size() - 1);
+        return sorted[below] + (sorted[above] - sorted[below]) * (position - below);
+    }
+
+    double mean(const std::vector<double>& values) {
+        double sum = 0.0;
+        for (double v : values) sum += v;
+        return sum / values.size();
+    }
+
+    double stddev(const std::vector<double>& values) {
+        const double m = mean(values);
+        double sum = 0.0;
+        for (double v : values) sum += (v - m) * (v - m);
+        return values.size() > 1 ? std::sqrt(sum / (values.size() - 1)) : 0.0;
+    }
+
+    std::string jsonString(const std::string& text) {
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Silences the library's progress output (epoch losses, "Loaded ..." lines)
+    // while a case is being measured.
+    class QuietStdout {
+    public:
+        QuietStdout() : saved(std::cout.rdbuf(nullptr)) {}
+        ~QuietStdout() {
+            std::cout.rdbuf(saved);
+            std::cout.clear();
+        }
+
+    private:
+        std::streambuf* saved;
+    };
+
+    class Runner {
+    public:
+        explicit Runner(const Options& options) : options(options) {}
+
+        // `items` is the work one call of `body` does (samples, elements, ...),
+        // reported as `unit` per second.
+        void run(const std::string& name, double items, const std::string& unit,
+                 const std::function<void()>& body) {
+            if (name.find(options.filter) == std::string::npos) return;
+            if (options.list) {
+                std::cout << name << std::endl;
+                return;
+            }
+
+            Result result;
+            result.name = name;
+            result.items = items;
+            result.unit = unit;
+            {
+                QuietStdout quiet;
+                // warm caches, page in buffers and settle the clock for ~50 ms
+                size_t iterations = 1;
+                double elapsed = time(body, iterations);
+                for (double warm = elapsed; warm < 0.05; warm += elapsed) {
+                    elapsed = time(body, iterations);
+                }
+                // enough iterations per sample that timer resolution does not matter
+                while (elapsed < options.minTime) {
+                    const double growth = elapsed > 0 ? options.minTime / elapsed * 1.2 : 10.0;
+                    iterations = static_cast<size_t>(std::ceil(iterations * std::min(growth, 10.0)));
+                    elapsed = time(body, iterations);
+                }
+                result.iterations = iterations;
+                for (size_t r = 0; r < options.repetitions; ++r) {
+                    result.samples.push_back(time(body, iterations) * 1e9 / iterations);
+                }
+            }
+            std::sort(result.samples.begin(), result.samples.end());
+
+            const double median = percentile(result.samples, 0.5);
+            std::cout << std::left << std::setw(56) << name << std::right
+                      << std::setw(14) << std::fixed << std::setprecision(1) << median << " ns"
+                      << std::setw(10) << std::setprecision(1)
+                      << 100.0 * (percentile(result.samples, 0.9) - percentile(result.samples, 0.1)) / median
+                      << " %  " << std::setprecision(3) << std::scientific
+                      << items / (median * 1e-9) << " " << unit << "/s" << std::defaultfloat << std::endl;
+            results.push_back(std::move(result));
+        }
+
+        void writeJson(std::ostream& out) const {
+            const std::time_t now = std::time(nullptr);
+            char date[32];
+            std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+            out << "{\n  \"context\": {\n"
+                << "    \"date\": " << jsonString(date) << ",\n"
+                << "    \"compiler\": " << jsonString(__VERSION__) << ",\n"
+                << "    \"simd\": " << jsonString(CpuFeatures::name(CpuFeatures::detected())) << ",\n"
+                << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+                << "    \"repetitions\": " << options.repetitions << ",\n"
+                << "    \"rows\": " << options.rows << "\n  },\n"
+                << "  \"benchmarks\": [";
+            out << std::setprecision(6);
+            for (size_t i = 0; i < results.size(); ++i) {
+                const Result& r = results[i];
+                const double median = percentile(r.samples, 0.5);
+                out << (i ? "," : "") << "\n    {"
+                    << "\"name\": " << jsonString(r.name)
+                    << ", \"iterations\": " << r.iterations
+                    << ", \"repetitions\": " << r.samples.size()
+                    << ", \"median_ns\": " << median
+                    << ", \"p10_ns\": " << percentile(r.samples, 0.1)
+                    << ", \"p90_ns\": " << percentile(r.samples, 0.9)
+                    << ", \"min_ns\": " << r.samples.front()
+                    << ", \"max_ns\": " << r.samples.back()
+                    << ", \"mean_ns\": " << mean(r.samples)
+                    << ", \"stddev_ns\": " << stddev(r.samples)
+                    << ", \"unit\": " << jsonString(r.unit)
+                    << ", \"items_per_second\": " << r.items / (median * 1e-9) << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+
+        const Options& options;
+
+    private:
+        static double time(const std::function<void()>& body, size_t iterations) {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                body();
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::vector<Result> results;
+    };
+
+    template <typename T>
+    Matrix<T> randomMatrix(size_t rows, size_t cols, std::mt19937& g, T low = T(-1), T high = T(1)) {
+        std::uniform_real_distribution<double> uniform(low, high);
+        Matrix<T> m(rows, cols);
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                m(i, j) = static_cast<T>(uniform(g));
+            }
+        }
+        return m;
+    }
+
+    // Gaussian blobs, one per class, so training has something to learn.
+    DataLoader::Dataset syntheticDataset(size_t rows, size_t features, size_t classes, unsigned int seed) {
+        std::mt19937 g(seed);
+        Matrix<double> centers = randomMatrix<double>(classes, features, g, -2.0, 2.0);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        DataLoader::Dataset dataset;
+        std::vector<int> labels(rows);
+        dataset.inputs.resize(rows, features);
+        for (size_t i = 0; i < rows; ++i) {
+            labels[i] = static_cast<int>(i % classes);
+            for (size_t j = 0; j < features; ++j) {
+                dataset.inputs(i, j) = centers(labels[i], j) + noise(g);
+            }
+        }
+        dataset.targets = DataLoader::oneHotEncode(labels, static_cast<int>(classes));
+        for (size_t c = 0; c < classes; ++c) {
+            dataset.classNames.push_back("class" + std::to_string(c));
+        }
+        return dataset;
+    }
+
+    template <typename T>
+    void layerBenchmarks(Runner& runner, const char* type) {
+        struct Shape { int in, out; size_t batch; };
+        const Shape shapes[] = {{16, 16, 32}, {64, 64, 32}, {256, 256, 64}, {784, 128, 64}};
+        std::mt19937 g(1);
+        for (const Shape& shape : shapes) {
+            const std::string suffix = "/" + std::to_string(shape.in) + "x" + std::to_string(shape.out) +
+                                       "/batch" + std::to_string(shape.batch) + "/" + type;
+            BasicLayer<T> layer(shape.in, shape.out, ActivationFunctions::Kind::Relu, 1);
+            typename BasicLayer<T>::Context context;
+            Matrix<T> inputs = randomMatrix<T>(shape.batch, shape.in, g);
+            Matrix<T> gradients = randomMatrix<T>(shape.batch, shape.out, g);
+            const T scale = T(1) / static_cast<T>(shape.batch);
+
+            runner.run("layer/forward" + suffix, shape.batch, "samples", [&] {
+                keep(layer.forwardBatch(inputs, context));
+            });
+            layer.forwardBatch(inputs, context);
+            runner.run("layer/backward" + suffix, shape.batch, "samples", [&] {
+                keep(layer.backwardBatch(gradients, context, scale));
+            });
+
+            std::vector<T> output(shape.out);
+            runner.run("layer/forward_single" + suffix, 1, "samples", [&] {
+                layer.forward(inputs[0], Span<T>(output));
+                keep(output);
+            });
+
+            // the same passes on bfloat16 weights and stored inputs
+            BasicLayer<T> mixed(shape.in, shape.out, ActivationFunctions::Kind::Relu, 1);
+            mixed.setMixedPrecision(true);
+            typename BasicLayer<T>::Context mixedContext;
+            runner.run("layer/forward_bf16" + suffix, shape.batch, "samples", [&] {
+                keep(mixed.forwardBatch(inputs, mixedContext));
+            });
+            mixed.forwardBatch(inputs, mixedContext);
+            runner.run("layer/backward_bf16" + suffix, shape.batch, "samples", [&] {
+                keep(mixed.backwardBatch(gradients, mixedContext, scale));
+            });
+
+            // 90% of the weights pruned, in compressed sparse rows
+            BasicLayer<T> sparse(shape.in, shape.out, ActivationFunctions::Kind::Relu, 1);
+            sparse.prune(0.9);
+            sparse.sparsify();
+            typename BasicLayer<T>::Context sparseContext;
+            runner.run("layer/forward_sparse90" + suffix, shape.batch, "samples", [&] {
+                keep(sparse.forwardBatch(inputs, sparseContext));
+            });
+            sparse.forwardBatch(inputs, sparseContext);
+            runner.run("layer/backward_sparse90" + suffix, shape.batch, "samples", [&] {
+                keep(sparse.backwardBatch(gradients, sparseContext, scale));
+            });
+            runner.run("layer/forward_single_sparse90" + suffix, 1, "samples", [&] {
+                sparse.forward(inputs[0], Span<T>(output));
+                keep(output);
+            });
+        }
+    }
+
+    template <typename T>
+    void activationBenchmarks(Runner& runner, const char* type) {
+        using namespace ActivationFunctions;
+        const size_t n = 4096;
+        std::mt19937 g(2);
+        Matrix<T> source = randomMatrix<T>(1, n, g, T(-4), T(4));
+        std::vector<T> x(n), y(n), d(n);
+        std::vector<T> gradient(source.rowData(0), source.rowData(0) + n);
+        const std::string suffix = "/" + std::to_string(n) + "/" + type;
+        auto reset = [&] { std::copy(source.rowData(0), source.rowData(0) + n, x.begin()); };
+
+        runner.run("activation/relu" + suffix, n, "elements", [&] { reset(); reluInPlace(x.data(), n); keep(x); });
+        runner.run("activation/sigmoid" + suffix, n, "elements", [&] { reset(); sigmoidInPlace(x.data(), n); keep(x); });
+        // rows of 16 classes, the usual width of a softmax output layer
+        runner.run("activation/softmax" + suffix, n, "elements", [&] {
+            reset();
+            for (size_t i = 0; i < n; i += 16) softmaxInPlace(x.data() + i, 16);
+            keep(x);
+        });
+        reset();
+        sigmoidInPlace(x.data(), n);
+        runner.run("activation/sigmoid_backward" + suffix, n, "elements", [&] {
+            sigmoidBackward(gradient.data(), x.data(), d.data(), n);
+            keep(d);
+        });
+        runner.run("activation/relu_backward" + suffix, n, "elements", [&] {
+            reluBackward(gradient.data(), x.data(), d.data(), n);
+            keep(d);
+        });
+    }
+
+    void lossBenchmarks(Runner& runner) {
+        const size_t batch = 256, classes = 10;
+        DataLoader::Dataset dataset = syntheticDataset(batch, 1, classes, 3);
+        std::mt19937 g(3);
+        Matrix<double> predicted = randomMatrix<double>(batch, classes, g, 0.01, 1.0);
+        Matrix<double> derivative;
+        const std::string suffix = "/" + std::to_string(batch) + "x" + std::to_string(classes);
+
+        runner.run("loss/crossEntropy" + suffix, batch, "samples", [&] {
+            keep(LossFunction::crossEntropy(predicted, dataset.targets));
+        });
+        runner.run("loss/crossEntropy_derivative" + suffix, batch, "samples", [&] {
+            LossFunction::crossEntropyDerivative(predicted, dataset.targets, derivative);
+            keep(derivative);
+        });
+        runner.run("loss/meanSquaredError" + suffix, batch, "samples", [&] {
+            keep(LossFunction::meanSquaredError(predicted, dataset.targets));
+        });
+        runner.run("loss/meanSquaredError_derivative" + suffix, batch, "samples", [&] {
+            LossFunction::meanSquaredErrorDerivative(predicted, dataset.targets, derivative);
+            keep(derivative);
+        });
+    }
+
+    void optimizerBenchmarks(Runner& runner) {
+        // the parameters of a 256 x 256 layer
+        std::mt19937 g(4);
+        Matrix<double> weights = randomMatrix<double>(256, 256, g);
+        Matrix<double> weightGradients = randomMatrix<double>(256, 256, g, -1e-3, 1e-3);
+        std::vector<double> biases(256, 0.0), biasGradients(256, 1e-3);
+        const std::vector<Optimizer::ParameterGroup> groups = {
+            {weights.data(), weightGradients.data(), weights.capacity()},
+            {biases.data(), biasGradients.data(), biases.size()}};
+        const double parameters = static_cast<double>(weights.capacity() + biases.size());
+
+        SGD sgd;
+        Momentum momentum;
+        Adam adam;
+        const std::pair<const char*, Optimizer*> optimizers[] = {{"SGD", &sgd}, {"Momentum", &momentum}, {"Adam", &adam}};
+        for (const auto& entry : optimizers) {
+            Optimizer* optimizer = entry.second;
+            runner.run(std::string("optimizer/") + entry.first + "/256x256", parameters, "parameters", [&] {
+                optimizer->step(groups, 1e-6);
+            });
+        }
+    }
+
+    void dataBenchmarks(Runner& runner) {
+        const size_t rows = runner.options.rows;
+        const std::string rowsSuffix = "/" + std::to_string(rows);
+        DataLoader::Dataset dataset = syntheticDataset(rows, 16, 4, 5);
+
+        const std::string csvFile = "run_benchmarks_data.csv";
+        const std::string binaryFile = "run_benchmarks_data.bin";
+        {
+            std::ofstream csv(csvFile);
+            csv << std::setprecision(9);
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < dataset.inputs.cols(); ++j) {
+                    csv << dataset.inputs(i, j) << ",";
+                }
+                csv << "class" << i % 4 << "\n";
+            }
+        }
+        DataLoader::CsvSpec spec;
+        for (size_t j = 0; j < dataset.inputs.cols(); ++j) spec.featureColumns.push_back(j);
+        spec.labelColumn = dataset.inputs.cols();
+
+        for (size_t threads : {size_t(1), size_t(0)}) {
+            spec.threads = threads;
+            runner.run("data/loadCSV" + rowsSuffix + "/threads" + (threads ? "1" : "All"), rows, "rows", [&] {
+                keep(DataLoader::loadCSV(csvFile, spec));
+            });
+        }
+        DataLoader::saveDataset(dataset, binaryFile);
+        runner.run("data/mapDataset" + rowsSuffix, rows, "rows", [&] {
+            keep(DataLoader::mapDataset(binaryFile));
+        });
+        std::remove(csvFile.c_str());
+        std::remove(binaryFile.c_str());
+
+        runner.run("data/splitIndices" + rowsSuffix, rows, "rows", [&] {
+            keep(DataLoader::splitIndices(rows, 0.6, 0.2, 0.2, 7));
+        });
+        runner.run("data/stratifiedSplit" + rowsSuffix, rows, "rows", [&] {
+            keep(DataLoader::stratifiedSplit(dataset, 0.6, 0.2, 0.2, 7));
+        });
+        runner.run("data/kFold5" + rowsSuffix, rows, "rows", [&] {
+            keep(DataLoader::kFold(rows, 5, 7));
+        });
+        DataLoader::Dataset trainSet, validationSet, testSet;
+        runner.run("data/trainValidationTestSplit_copy" + rowsSuffix, rows, "rows", [&] {
+            DataLoader::trainValidationTestSplit(dataset, trainSet, validationSet, testSet, 0.6, 0.2, 0.2, 7);
+        });
+    }
+
+    void epochBenchmarks(Runner& runner) {
+        const size_t rows = runner.options.rows;
+        const int batchSize = 64;
+        DataLoader::Dataset dataset = syntheticDataset(rows, 32, 10, 6);
+        const std::string suffix = "/32-128-64-10/" + std::to_string(rows) + "/batch" + std::to_string(batchSize);
+
+        for (size_t threads : {size_t(1), size_t(0)}) {
+            NeuralNetwork network({32, 128, 64, 10}, "relu", "softmax", "crossEntropy", "Adam", 8);
+            network.setThreadCount(threads);
+            runner.run("epoch/train" + suffix + "/threads" + (threads ? "1" : "All"), rows, "samples", [&] {
+                network.train(dataset.inputs, dataset.targets, 1, 1e-3, batchSize);
+            });
+        }
+
+        // per-sample SGD, where a synchronous step per sample leaves little to
+        // split between threads and the asynchronous mode updates without a reduction
+        const std::string sampleSuffix = "/32-128-64-10/" + std::to_string(rows) + "/batch1";
+        for (bool asynchronous : {false, true}) {
+            for (size_t threads : {size_t(1), size_t(0)}) {
+                NeuralNetwork network({32, 128, 64, 10}, "relu", "softmax", "crossEntropy", "SGD", 8);
+                network.setThreadCount(threads);
+                network.setAsynchronous(asynchronous, 1);
+                runner.run(std::string(asynchronous ? "epoch/train_async" : "epoch/train") + sampleSuffix +
+                               "/threads" + (threads ? "1" : "All"),
+                           rows, "samples", [&] {
+                    network.train(dataset.inputs, dataset.targets, 1, 1e-3, 1);
+                });
+            }
+        }
+
+        NeuralNetwork network({32, 128, 64, 10}, "relu", "softmax", "crossEntropy", "Adam", 8);
+        DataPipeline::Options options;
+        options.batchSize = batchSize;
+        options.seed = 9;
+        DataPipeline pipeline(dataset.inputs, dataset.targets, options);
+        runner.run("epoch/train_pipeline" + suffix + "/threads1", rows, "samples", [&] {
+            network.train(pipeline, 1, 1e-3);
+        });
+        runner.run("epoch/evaluate/32-128-64-10/" + std::to_string(rows), rows, "samples", [&] {
+            keep(network.evaluate(dataset.inputs, dataset.targets));
+        });
+    }
+
+    void inferenceBenchmarks(Runner& runner) {
+        const size_t batch = 32;
+        DataLoader::Dataset dataset = syntheticDataset(batch, 32, 10, 10);
+        NeuralNetwork network({32, 128, 64, 10}, "relu", "softmax", "crossEntropy", "Adam", 8);
+        NeuralNetwork::Workspace workspace = network.makeWorkspace();
+        Matrix<double> outputs(batch, 10);
+        const std::string suffix = "/32-128-64-10/batch" + std::to_string(batch);
+
+        runner.run("inference/predict_rows" + suffix, batch, "samples", [&] {
+            for (size_t r = 0; r < batch; ++r) {
+                network.predict(dataset.inputs[r], outputs[r], workspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/predictBatch" + suffix, batch, "samples", [&] {
+            network.predictBatch(dataset.inputs, outputs, workspace);
+            keep(outputs);
+        });
+
+        const InferencePlan plan = network.compile();
+        InferencePlan::Workspace planWorkspace = plan.makeWorkspace();
+        runner.run("inference/plan_predict_rows" + suffix, batch, "samples", [&] {
+            for (size_t r = 0; r < batch; ++r) {
+                plan.predict(dataset.inputs[r], outputs[r], planWorkspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/plan_predictBatch" + suffix, batch, "samples", [&] {
+            plan.predictBatch(dataset.inputs, outputs, planWorkspace);
+            keep(outputs);
+        });
+
+        NeuralNetwork int8 = network.quantized(dataset.inputs);
+        NeuralNetwork::Workspace int8Workspace = int8.makeWorkspace();
+        runner.run("inference/predict_rows_int8" + suffix, batch, "samples", [&] {
+            for (size_t r = 0; r < batch; ++r) {
+                int8.predict(dataset.inputs[r], outputs[r], int8Workspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/predictBatch_int8" + suffix, batch, "samples", [&] {
+            int8.predictBatch(dataset.inputs, outputs, int8Workspace);
+            keep(outputs);
+        });
+
+        NeuralNetwork sparse({32, 128, 64, 10}, "relu", "softmax", "crossEntropy", "Adam", 8);
+        sparse.prune(0.9);
+        sparse.sparsify();
+        runner.run("inference/predict_rows_sparse90" + suffix, batch, "samples", [&] {
+            for (size_t r = 0; r < batch; ++r) {
+                sparse.predict(dataset.inputs[r], outputs[r], workspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/predictBatch_sparse90" + suffix, batch, "samples", [&] {
+            sparse.predictBatch(dataset.inputs, outputs, workspace);
+            keep(outputs);
+        });
+    }
+
+    // Iris-sized models, where per-call overhead rather than arithmetic decides
+    void tinyInferenceBenchmarks(Runner& runner) {
+        const size_t rows = 32;
+        DataLoader::Dataset dataset = syntheticDataset(rows, 4, 3, 11);
+        NeuralNetwork network({4, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", 8);
+        NeuralNetwork::Workspace workspace = network.makeWorkspace();
+        const InferencePlan plan = network.compile();
+        InferencePlan::Workspace planWorkspace = plan.makeWorkspace();
+        const StaticNetwork<double, 4, 8, 3> fixed(network);
+        Matrix<double> outputs(rows, 3);
+        const std::string suffix = "/4-8-3/rows" + std::to_string(rows);
+
+        runner.run("inference/predict_rows" + suffix, rows, "samples", [&] {
+            for (size_t r = 0; r < rows; ++r) {
+                network.predict(dataset.inputs[r], outputs[r], workspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/plan_predict_rows" + suffix, rows, "samples", [&] {
+            for (size_t r = 0; r < rows; ++r) {
+                plan.predict(dataset.inputs[r], outputs[r], planWorkspace);
+            }
+            keep(outputs);
+        });
+        runner.run("inference/static_predict_rows" + suffix, rows, "samples", [&] {
+            for (size_t r = 0; r < rows; ++r) {
+                fixed.predict(dataset.inputs.rowData(r), outputs.rowData(r));
+            }
+            keep(outputs);
+        });
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            auto value = [&](const char* flag) -> const char* {
+                const std::string prefix = std::string(flag) + "=";
+                return arg.compare(0, prefix.size(), prefix) == 0 ? argv[i] + prefix.size() : nullptr;
+            };
+            if (const char* v = value("--filter")) options.filter = v;
+            else if (const char* v = value("--repetitions")) options.repetitions = std::max(1ul, std::strtoul(v, nullptr, 10));
+            else if (const char* v = value("--min-time")) options.minTime = std::strtod(v, nullptr);
+            else if (const char* v = value("--rows")) options.rows = std::max(1ul, std::strtoul(v, nullptr, 10));
+            else if (const char* v = value("--out")) options.output = v;
+            else if (arg == "--list") options.list = true;
+            else {
+                std::cerr << "Unknown argument " << arg << "\n"
+                          << "usage: run_benchmarks [--filter=substring] [--repetitions=N] [--min-time=seconds]\n"
+                          << "                      [--rows=N] [--out=file.json | --out=-] [--list]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) return 2;
+
+    Runner runner(options);
+    if (!options.list) {
+        std::cout << std::left << std::setw(56) << "benchmark" << std::right << std::setw(17) << "median"
+                  << std::setw(12) << "p90-p10" << "  throughput" << std::endl;
+    }
+    layerBenchmarks<float>(runner, "float");
+    layerBenchmarks<double>(runner, "double");
+    activationBenchmarks<float>(runner, "float");
+    activationBenchmarks<double>(runner, "double");
+    lossBenchmarks(runner);
+    optimizerBenchmarks(runner);
+    dataBenchmarks(runner);
+    epochBenchmarks(runner);
+    inferenceBenchmarks(runner);
+    tinyInferenceBenchmarks(runner);
+    if (options.list) return 0;
+
+    if (options.output == "-") {
+        runner.writeJson(std::cout);
+    } else {
+        std::ofstream out(options.output);
+        runner.writeJson(out);
+        if (!out) {
+            std::cerr << "Could not write " << options.output << std::endl;
+            return 1;
+        }
+        std::cout << "Results written to " << options.output << std::endl;
+    }
+    return 0;
+}
@@ -3,8 +3,18 @@
 
 #include <vector>
 #include <cmath>
+#include <cstddef>
+#include <string>
 
 namespace ActivationFunctions {
+    // Built-in activations that layers apply with the vectorized kernels below;
+    // Custom marks a user-supplied std::function. The values are stored in
+    // model files, so they must not change.
+    enum class Kind { Linear = 0, Relu = 1, Sigmoid = 2, Softmax = 3, Custom = 4 };
+
+    // "linear", "relu", "sigmoid" or "softmax"; any other name maps to Custom.
+    Kind kindFromName(const std::string& name);
+
     double sigmoid(double x);
     std::vector<double> sigmoid(const std::vector<double>& x);
     
@@ -18,6 +28,26 @@ namespace ActivationFunctions {
     
     double reluDerivative(double x);
 
+    // Vectorized in-place kernels over contiguous arrays, dispatched on the CPU's
+    // SIMD level. sigmoidDerivativeInPlace takes sigmoid outputs, reluDerivativeInPlace
+    // takes pre-activations; softmaxInPlace subtracts the maximum before exponentiating.
+    // sigmoidBackward/reluBackward compute d = g * f'(y) from the activated outputs y.
+    void sigmoidInPlace(float* x, size_t n);
+    void reluInPlace(float* x, size_t n);
+    void softmaxInPlace(float* x, size_t n);
+    void sigmoidDerivativeInPlace(float* y, size_t n);
+    void reluDerivativeInPlace(float* x, size_t n);
+    void sigmoidBackward(const float* g, const float* y, float* d, size_t n);
+    void reluBackward(const float* g, const float* y, float* d, size_t n);
+
+    void sigmoidInPlace(double* x, size_t n);
+    void reluInPlace(double* x, size_t n);
+    void softmaxInPlace(double* x, size_t n);
+    void sigmoidDerivativeInPlace(double* y, size_t n);
+    void reluDerivativeInPlace(double* x, size_t n);
+    void sigmoidBackward(const double* g, const double* y, double* d, size_t n);
+    void reluBackward(const double* g, const double* y, double* d, size_t n);
+
 }
 
 #endif 
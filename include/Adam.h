@@ -3,23 +3,20 @@
 
 #include "Optimizer.h"
 
-class Adam : public Optimizer {
+template <typename T>
+class BasicAdam : public BasicOptimizer<T> {
 public:
-    Adam(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8);
+    using typename BasicOptimizer<T>::ParameterGroup;
 
-    void updateWeights(std::vector<std::vector<double>>& weights,
-                       const std::vector<std::vector<double>>& weightGradients,
-                       double learningRate) override;
+    BasicAdam(T beta1 = T(0.9), T beta2 = T(0.999), T epsilon = T(1e-8));
 
-    void updateBiases(std::vector<double>& biases,
-                      const std::vector<double>& biasGradients,
-                      double learningRate) override;
+protected:
+    void apply(const std::vector<ParameterGroup>& groups, T learningRate) override;
 
 private:
-    double beta1, beta2, epsilon;
-    int timeStep;
-    std::vector<std::vector<double>> mWeights, vWeights;
-    std::vector<double> mBiases, vBiases;
+    T beta1, beta2, epsilon;
 };
 
-#endif
\ No newline at end of file
+using Adam = BasicAdam<double>;
+
+#endif
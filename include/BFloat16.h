@@ -0,0 +1,48 @@
+#ifndef BFLOAT16_H
+#define BFLOAT16_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Brain floating point: the upper half of an IEEE float32, with the same
+// exponent range and an 8-bit significand. Widening to float is exact;
+// narrowing rounds to nearest even and flushes subnormals to zero, as
+// AVX512-BF16's vcvtneps2bf16 does, so every conversion path agrees bit for
+// bit.
+struct BFloat16 {
+    uint16_t bits = 0;
+
+    BFloat16() = default;
+    explicit BFloat16(float value) : bits(round(value)) {}
+
+    explicit operator float() const {
+        const uint32_t wide = static_cast<uint32_t>(bits) << 16;
+        float value;
+        std::memcpy(&value, &wide, sizeof(value));
+        return value;
+    }
+
+    static uint16_t round(float value) {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        const uint32_t magnitude = u & 0x7fffffffu;
+        if (magnitude > 0x7f800000u) return static_cast<uint16_t>((u >> 16) | 0x40u); // quiet NaN
+        if (magnitude < 0x00800000u) return static_cast<uint16_t>((u >> 16) & 0x8000u); // signed zero
+        return static_cast<uint16_t>((u + 0x7fffu + ((u >> 16) & 1u)) >> 16);
+    }
+};
+
+namespace Precision {
+
+    // Whole-array conversions, dispatched on the CPU like the activation
+    // kernels: vcvtneps2bf16 where AVX512-BF16 is available, vectorized
+    // integer rounding otherwise. Doubles narrow through float.
+    void convert(const float* x, BFloat16* y, size_t n);
+    void convert(const double* x, BFloat16* y, size_t n);
+    void convert(const BFloat16* x, float* y, size_t n);
+    void convert(const BFloat16* x, double* y, size_t n);
+
+}
+
+#endif
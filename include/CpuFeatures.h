@@ -0,0 +1,25 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+namespace CpuFeatures {
+
+    enum class SimdLevel { Scalar = 0, SSE4 = 1, AVX2 = 2, AVX512 = 3 };
+
+    // Widest vector instruction set usable on this machine (CPU and OS support),
+    // queried through CPUID once and cached for the lifetime of the process.
+    SimdLevel detected();
+
+    // Whether the detected level also has VNNI (vpdpbusd, unsigned x signed
+    // 8-bit dot products into 32-bit sums): AVX512-VNNI at AVX512, AVX-VNNI at
+    // AVX2. Cached like detected().
+    bool hasVnni();
+
+    // Whether AVX512-BF16 (vcvtneps2bf16, bfloat16 conversions and dot
+    // products) is available on top of AVX512. Cached like detected().
+    bool hasBf16();
+
+    const char* name(SimdLevel level);
+
+}
+
+#endif
@@ -1,47 +1,176 @@
 #ifndef DATA_LOADER_H
 #define DATA_LOADER_H
 
+#include "Matrix.h"
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 
+class MappedFile;
+
+// Loading and splitting helpers are templated on the scalar type of the
+// dataset; float and double are instantiated in DataLoader.cpp. Functions that
+// cannot deduce it (the loaders, oneHotEncode) default to double.
 class DataLoader {
 public:
-    struct Dataset {
-        std::vector<std::vector<double>> inputs;
-        std::vector<std::vector<double>> targets;
+    template <typename T>
+    struct BasicDataset {
+        Matrix<T> inputs;
+        Matrix<T> targets;
         std::vector<std::string> featureNames;
         std::vector<std::string> classNames;
     };
 
-    static Dataset loadIrisDataset();
+    using Dataset = BasicDataset<double>;
+
+    // Column layout of a tabular CSV file: which columns become features (in
+    // the given order) and which one holds the class label. Other columns are
+    // ignored.
+    struct CsvSpec {
+        std::vector<size_t> featureColumns;
+        size_t labelColumn = 0;
+        bool hasHeader = false;
+        char delimiter = ',';
+        size_t threads = 0; // 0 uses every hardware thread
+    };
+
+    // Maps the file and parses newline-aligned chunks in parallel with
+    // std::from_chars, accepting one leading plus sign as well. Class names
+    // are sorted and one-hot encoded into targets; rows with a missing or
+    // malformed field are skipped with a warning.
+    // Feature names come from the header row when there is one.
+    template <typename T = double>
+    static BasicDataset<T> loadCSV(const std::string& filename, const CsvSpec& spec);
+
+    // Read-only view of a binary dataset file written by saveDataset. Features
+    // and labels stay in the mapping: inputs(), row() and batch() are views into
+    // it and keep the file mapped for as long as they are alive.
+    template <typename T>
+    class BasicMappedDataset {
+    public:
+        size_t rows() const;
+        size_t featureCount() const;
+        size_t classCount() const;
+
+        const Matrix<T>& inputs() const;
+        // class index of every row
+        Span<const uint32_t> labels() const;
+        Span<const T> row(size_t i) const;
+        // rows [first, first + count) without copying
+        Matrix<T> batch(size_t first, size_t count) const;
+        // one-hot targets of rows [first, first + count)
+        Matrix<T> targets(size_t first, size_t count) const;
+        // Dataset whose inputs are a view of the mapping; only the one-hot
+        // targets are materialized.
+        BasicDataset<T> toDataset() const;
+
+        const std::vector<std::string>& featureNames() const;
+        const std::vector<std::string>& classNames() const;
+
+    private:
+        friend class DataLoader;
+
+        std::shared_ptr<MappedFile> file;
+        Matrix<T> inputView;
+        const uint32_t* labelData = nullptr;
+        std::vector<std::string> featureNameList;
+        std::vector<std::string> classNameList;
+    };
+
+    using MappedDataset = BasicMappedDataset<double>;
+
+    // Binary dataset file: a header with the feature and class names, the
+    // features as a 64-byte aligned padded matrix and one uint32 label per row.
+    // Targets must be one-hot; each row's label is its largest target.
+    template <typename T>
+    static void saveDataset(const BasicDataset<T>& dataset, const std::string& filename);
+
+    // Maps a file written by saveDataset with the same scalar type.
+    template <typename T = double>
+    static BasicMappedDataset<T> mapDataset(const std::string& filename);
+
+    // Parses a CSV file once and stores it with saveDataset, so later runs
+    // can mapDataset it instead of parsing again.
+    template <typename T = double>
+    static void convertCSV(const std::string& csvFilename, const CsvSpec& spec,
+                           const std::string& datasetFilename);
+
+    template <typename T = double>
+    static BasicDataset<T> loadIrisDataset();
     
     static bool downloadIrisDataset(const std::string& filename);
     
-    static Dataset loadIrisFromCSV(const std::string& filename);
+    template <typename T = double>
+    static BasicDataset<T> loadIrisFromCSV(const std::string& filename);
     
-    static void normalizeFeatures(std::vector<std::vector<double>>& data);
+    template <typename T>
+    static void normalizeFeatures(Matrix<T>& data);
+
+    // Row indices into one dataset, in the order the rows should be visited.
+    // NeuralNetwork::train and evaluate take them directly, so a split costs
+    // one index per row instead of a copy of the data.
+    struct Split {
+        std::vector<size_t> train;
+        std::vector<size_t> validation;
+        std::vector<size_t> test;
+    };
+
+    // Shuffles 0 .. samples - 1 and cuts it by ratio; the same rows as
+    // trainValidationTestSplit picks for the same seed.
+    static Split splitIndices(size_t samples, double trainRatio, double validationRatio,
+                              double testRatio = 0.2, unsigned int seed = 0);
+
+    // Applies the ratios within every class (the largest target of a row), so
+    // each part keeps the class balance of the dataset.
+    template <typename T>
+    static Split stratifiedSplit(const BasicDataset<T>& dataset, double trainRatio,
+                                 double validationRatio, double testRatio = 0.2,
+                                 unsigned int seed = 0);
+
+    // k folds over one shuffle: fold i validates on its share of the rows and
+    // trains on the others. The test indices are left empty.
+    static std::vector<Split> kFold(size_t samples, size_t k, unsigned int seed = 0);
+
+    // kFold with every class dealt evenly across the folds.
+    template <typename T>
+    static std::vector<Split> stratifiedKFold(const BasicDataset<T>& dataset, size_t k,
+                                              unsigned int seed = 0);
+
+    // Copies the listed rows into a dataset of their own.
+    template <typename T>
+    static BasicDataset<T> subset(const BasicDataset<T>& dataset, const std::vector<size_t>& rows);
     
-    static void trainTestSplit(const Dataset& dataset, 
-                              Dataset& trainSet, 
-                              Dataset& testSet, 
+    template <typename T>
+    static void trainTestSplit(const BasicDataset<T>& dataset, 
+                              BasicDataset<T>& trainSet, 
+                              BasicDataset<T>& testSet, 
                               double testRatio = 0.2,
                               unsigned int seed = 0);
     
-    static void trainValidationTestSplit(const Dataset& dataset,
-                                       Dataset& trainSet,
-                                       Dataset& validationSet,
-                                       Dataset& testSet,
+    template <typename T>
+    static void trainValidationTestSplit(const BasicDataset<T>& dataset,
+                                       BasicDataset<T>& trainSet,
+                                       BasicDataset<T>& validationSet,
+                                       BasicDataset<T>& testSet,
                                        double trainRatio,
                                        double validationRatio,
                                        double testRatio = 0.2,
                                        unsigned int seed = 0);
     
-    static std::vector<std::vector<double>> oneHotEncode(const std::vector<int>& labels, int numClasses);
+    template <typename T = double>
+    static Matrix<T> oneHotEncode(const std::vector<int>& labels, int numClasses);
 
 private:
-    static std::vector<double> computeMean(const std::vector<std::vector<double>>& data);
-    static std::vector<double> computeStd(const std::vector<std::vector<double>>& data, 
+    // statistics are accumulated in double regardless of the dataset's type
+    template <typename T>
+    static std::vector<double> computeMean(const Matrix<T>& data);
+    template <typename T>
+    static std::vector<double> computeStd(const Matrix<T>& data, 
                                          const std::vector<double>& mean);
+    static std::vector<size_t> shuffledIndices(size_t samples, unsigned int seed);
+    template <typename T>
+    static std::vector<std::vector<size_t>> rowsByClass(const BasicDataset<T>& dataset);
 };
 
 #endif
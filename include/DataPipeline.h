@@ -0,0 +1,88 @@
+#ifndef DATA_PIPELINE_H
+#define DATA_PIPELINE_H
+
+#include "Matrix.h"
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Produces training mini-batches on a background thread. Each batch is packed
+// into a contiguous slot of a bounded ring while the consumer trains on the
+// previous one, so gathering, shuffling and normalizing rows overlap with
+// compute. The source matrices are only read and must outlive the pipeline.
+template <typename T>
+class BasicDataPipeline {
+public:
+    struct Options {
+        size_t batchSize = 32;
+        // reshuffle the rows at the start of every epoch
+        bool shuffle = true;
+        // 0 seeds from std::random_device
+        unsigned int seed = 0;
+        // ring depth; 2 double-buffers the batches
+        size_t slots = 2;
+        // standardize every feature with the mean and standard deviation of
+        // the pipeline's rows while packing
+        bool normalize = false;
+    };
+
+    struct Batch {
+        Matrix<T> inputs;
+        Matrix<T> targets;
+        size_t epoch = 0;
+    };
+
+    BasicDataPipeline(const Matrix<T>& inputs, const Matrix<T>& targets, const Options& options);
+    // Only the listed rows, e.g. one part of a DataLoader::Split.
+    BasicDataPipeline(const Matrix<T>& inputs, const Matrix<T>& targets,
+                      std::vector<size_t> rows, const Options& options);
+    ~BasicDataPipeline();
+
+    BasicDataPipeline(const BasicDataPipeline&) = delete;
+    BasicDataPipeline& operator=(const BasicDataPipeline&) = delete;
+
+    size_t samples() const;
+    size_t batchesPerEpoch() const;
+
+    // Blocks until the next batch is packed and hands it out; it stays valid
+    // until the following call. Rethrows anything the producer thread threw.
+    const Batch& next();
+
+    // Feature statistics used by the normalization (empty when it is off), so
+    // validation data can be transformed the same way. Constant features get
+    // mean 0 and deviation 1 and pass through unchanged.
+    const std::vector<T>& featureMean() const;
+    const std::vector<T>& featureStd() const;
+
+private:
+    void produce();
+    void pack(Batch& batch, const size_t* order, size_t count) const;
+
+    const Matrix<T>& inputs;
+    const Matrix<T>& targets;
+    std::vector<size_t> rows;
+    Options options;
+    std::vector<T> mean;
+    std::vector<T> stddev;
+    std::vector<T> inverseStd;
+
+    std::vector<Batch> ring;
+    std::mutex mutex;
+    std::condition_variable slotFilled;
+    std::condition_variable slotFreed;
+    // batch n lives in ring[n % ring.size()]; the consumer keeps the last one
+    // it was handed until it asks for the next
+    size_t produced = 0;
+    size_t handedOut = 0;
+    size_t released = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+    std::thread producer;
+};
+
+using DataPipeline = BasicDataPipeline<double>;
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "Matrix.h"
+#include "BFloat16.h"
+#include <cstddef>
+#include <cstdint>
+
+// Dense matrix kernels on row-major storage. Leading dimensions (lda, ldb, ldc)
+// are row strides in elements, as returned by Matrix::stride().
+namespace Gemm {
+
+    enum class Transpose { No, Yes };
+
+    // C = alpha * op(A) * op(B) + beta * C, where op(A) is M x K and op(B) is K x N.
+    void gemm(Transpose transA, Transpose transB,
+              size_t M, size_t N, size_t K,
+              float alpha, const float* A, size_t lda,
+              const float* B, size_t ldb,
+              float beta, float* C, size_t ldc);
+    void gemm(Transpose transA, Transpose transB,
+              size_t M, size_t N, size_t K,
+              double alpha, const double* A, size_t lda,
+              const double* B, size_t ldb,
+              double beta, double* C, size_t ldc);
+
+    // Mixed precision: B holds bfloat16 values, widened as they are packed, so
+    // each product reads half the bytes of B (a layer's weights or stored
+    // activations) and accumulates in the precision of C.
+    void gemm(Transpose transA, Transpose transB,
+              size_t M, size_t N, size_t K,
+              float alpha, const float* A, size_t lda,
+              const BFloat16* B, size_t ldb,
+              float beta, float* C, size_t ldc);
+    void gemm(Transpose transA, Transpose transB,
+              size_t M, size_t N, size_t K,
+              double alpha, const double* A, size_t lda,
+              const BFloat16* B, size_t ldb,
+              double beta, double* C, size_t ldc);
+
+    // y = alpha * op(A) * x + beta * y, where A is M x N.
+    void gemv(Transpose transA, size_t M, size_t N,
+              float alpha, const float* A, size_t lda,
+              const float* x, float beta, float* y);
+    void gemv(Transpose transA, size_t M, size_t N,
+              double alpha, const double* A, size_t lda,
+              const double* x, double beta, double* y);
+
+    // The right-hand side of products computed many times, such as a layer's
+    // weights, rearranged once into the panels the blocked kernel reads. The
+    // layout depends on the kernel the CPU selects, so packed matrices are not
+    // meant to be stored.
+    template <typename T>
+    struct PackedMatrix {
+        size_t rows = 0;
+        size_t cols = 0;
+        size_t panelWidth = 0;
+        Matrix<T> panels;
+    };
+
+    // Packs op(B), which is K x N.
+    void pack(Transpose transB, size_t K, size_t N, const float* B, size_t ldb, PackedMatrix<float>& packed);
+    void pack(Transpose transB, size_t K, size_t N, const double* B, size_t ldb, PackedMatrix<double>& packed);
+
+    // The panelWidth pack() would give on this CPU, without packing anything.
+    template <typename T>
+    size_t packedPanelWidth();
+    template <>
+    size_t packedPanelWidth<float>();
+    template <>
+    size_t packedPanelWidth<double>();
+
+    // C = A * B + beta * C with B packed by pack(), where A is M x B.rows.
+    // Rows of A fewer than a micro-tile are read in place by a one-row
+    // kernel, so a single row costs no packing either.
+    void gemm(size_t M, const float* A, size_t lda, const PackedMatrix<float>& B,
+              float beta, float* C, size_t ldc);
+    void gemm(size_t M, const double* A, size_t lda, const PackedMatrix<double>& B,
+              double beta, double* C, size_t ldc);
+
+    // Int8 matrices for gemmU8S8 are packed once into its own layout: the
+    // N x K matrix B becomes packedS8Size(N, K) bytes, 64-byte aligned.
+    size_t packedS8Size(size_t N, size_t K);
+    void packS8(size_t N, size_t K, const int8_t* B, size_t ldb, int8_t* packed);
+
+    // C = A * B^T in exact 32-bit integer arithmetic, where A is M x K unsigned
+    // and B is N x K signed 8-bit, packed by packS8: the product of quantized
+    // layer inputs and int8 weights. Uses VNNI dot products where the CPU has
+    // them; K must stay below 2^16 so the sums cannot overflow.
+    void gemmU8S8(size_t M, size_t N, size_t K,
+                  const uint8_t* A, size_t lda,
+                  const int8_t* packedB,
+                  int32_t* C, size_t ldc);
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef INFERENCE_PLAN_H
+#define INFERENCE_PLAN_H
+
+#include "Matrix.h"
+#include "Gemm.h"
+#include "ActivationFunctions.h"
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class BasicNeuralNetwork;
+
+// An immutable inference-only copy of a trained network (see
+// BasicNeuralNetwork::compile). Each layer runs as one fused step: its biases
+// seed the output rows, the product accumulates onto them and the activation
+// is applied while the rows are still in cache. Weights are laid out once for
+// the kernel chosen by the layer's shape, and the rows of a batch flow through
+// every layer in blocks of RowBlock, so the activations fit two fixed buffers.
+//
+// The plan owns its weights and does not change after construction; any
+// number of threads can run it at once, each with its own Workspace.
+template <typename T>
+class BasicInferencePlan {
+public:
+    // rows carried through all layers before the next block starts
+    static constexpr size_t RowBlock = 64;
+
+    enum class Kernel {
+        // transposed weights read row by row; for layers too small to repay
+        // the packed panels
+        Direct,
+        // weights packed once into the blocked GEMM's panels
+        Packed
+    };
+
+    // Throws std::invalid_argument when supports(network) is false.
+    explicit BasicInferencePlan(const BasicNeuralNetwork<T>& network);
+
+    // False for networks without layers and for those with custom activation
+    // functions, quantized or sparse layers.
+    static bool supports(const BasicNeuralNetwork<T>& network);
+
+    // The two activation buffers, RowBlock x the widest hidden layer.
+    struct Workspace {
+        Matrix<T> ping;
+        Matrix<T> pong;
+    };
+
+    Workspace makeWorkspace() const;
+
+    // Same results as the network's predict and predictBatch. Neither
+    // allocates once `workspace` has been sized by makeWorkspace.
+    void predict(Span<const T> input, Span<T> output, Workspace& workspace) const;
+    void predictBatch(const Matrix<T>& inputs, Matrix<T>& outputs, Workspace& workspace) const;
+
+    std::vector<T> predict(const std::vector<T>& input) const;
+
+    size_t getInputSize() const;
+    size_t getOutputSize() const;
+    size_t getLayerCount() const;
+    Kernel getKernel(size_t layer) const;
+
+private:
+    struct Step {
+        size_t inputs = 0;
+        size_t outputs = 0;
+        ActivationFunctions::Kind activation = ActivationFunctions::Kind::Linear;
+        Kernel kernel = Kernel::Direct;
+        // Direct: inputs x outputs
+        Matrix<T> transposed;
+        Gemm::PackedMatrix<T> packed;
+        std::vector<T> biases;
+    };
+
+    // `rows` rows of `input`, `inputStride` apart, into the rows of `output`
+    void run(const T* input, size_t inputStride, size_t rows,
+             T* output, size_t outputStride, Workspace& workspace) const;
+    void runStep(const Step& step, const T* input, size_t inputStride, size_t rows,
+                 T* output, size_t outputStride) const;
+
+    std::vector<Step> steps;
+    size_t widestHidden = 0;
+};
+
+using InferencePlan = BasicInferencePlan<double>;
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include "NeuralNetwork.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Serves one network to many concurrent clients by dynamic micro-batching:
+// requests queue up until `maxBatchSize` of them are waiting or the oldest has
+// waited `maxQueueDelay`, then a single batched forward pass answers them all.
+// Requests come from submit() in-process or, when `socketPath` is set, over a
+// Unix domain socket (see BasicInferenceClient for the wire format).
+//
+// Batches run on the network's compiled plan (see BasicNeuralNetwork::compile)
+// when it has one, or else on the network itself, which is then only read and
+// must outlive the server; do not train it while the server runs.
+template <typename T>
+class BasicInferenceServer {
+public:
+    struct Options {
+        size_t maxBatchSize = 32;
+        std::chrono::microseconds maxQueueDelay{500};
+        // empty: in-process requests only
+        std::string socketPath;
+    };
+
+    struct Stats {
+        size_t requests = 0;
+        size_t batches = 0;
+        size_t largestBatch = 0;
+    };
+
+    BasicInferenceServer(const BasicNeuralNetwork<T>& network, const Options& options);
+    // stop()
+    ~BasicInferenceServer();
+
+    BasicInferenceServer(const BasicInferenceServer&) = delete;
+    BasicInferenceServer& operator=(const BasicInferenceServer&) = delete;
+
+    // Queues one input row; the future receives its output, or the exception
+    // the batch failed with. Throws std::invalid_argument for a wrong input
+    // size and std::runtime_error once the server is stopping.
+    std::future<std::vector<T>> submit(std::vector<T> input);
+
+    // Closes the socket and its connections, answers the requests already
+    // queued and joins every thread. Idempotent.
+    void stop();
+
+    Stats stats() const;
+
+private:
+    struct Request {
+        std::vector<T> input;
+        std::promise<std::vector<T>> result;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    void batchLoop();
+    void acceptLoop();
+    void serveConnection(int fd);
+    // joins the connection threads that have returned
+    void reapConnections();
+
+    const BasicNeuralNetwork<T>& network;
+    // null for networks that cannot be compiled
+    std::unique_ptr<const BasicInferencePlan<T>> plan;
+    Options options;
+    const size_t inputSize;
+    const size_t outputSize;
+
+    std::mutex mutex;
+    std::condition_variable requestQueued;
+    std::deque<Request> queue;
+    bool stopping = false;
+
+    std::atomic<size_t> requestCount{0};
+    std::atomic<size_t> batchCount{0};
+    std::atomic<size_t> largestBatch{0};
+
+    int listenFd = -1;
+    std::set<int> connections;
+    std::vector<std::thread> connectionThreads;
+    // connection threads that are done and only wait to be joined
+    std::vector<std::thread::id> finishedConnections;
+    std::thread acceptor;
+    std::thread batcher;
+};
+
+// Blocking client for the socket protocol. Every message, in host byte
+// order, is a uint32 element count followed by that many scalars of type T:
+// the request carries one input row, the reply its output row, or no
+// elements when the request was rejected (wrong input size).
+template <typename T>
+class BasicInferenceClient {
+public:
+    explicit BasicInferenceClient(const std::string& socketPath);
+    ~BasicInferenceClient();
+
+    BasicInferenceClient(const BasicInferenceClient&) = delete;
+    BasicInferenceClient& operator=(const BasicInferenceClient&) = delete;
+
+    // Throws std::runtime_error on connection errors and on rejected requests.
+    std::vector<T> predict(const std::vector<T>& input);
+
+private:
+    int fd = -1;
+};
+
+using InferenceServer = BasicInferenceServer<double>;
+using InferenceClient = BasicInferenceClient<double>;
+
+#endif
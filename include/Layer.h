@@ -1,52 +1,204 @@
 #ifndef LAYER_H
 #define LAYER_H
 
+#include "Matrix.h"
+#include "ActivationFunctions.h"
+#include "BFloat16.h"
+#include "Sparse.h"
+#include <cstdint>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <string>
 
-class Layer {
+// Fully connected layer templated on its scalar type; float and double are
+// instantiated in NeuralNetworkLib.
+template <typename T>
+class BasicLayer {
 public:
-    Layer(int inputSize, int outputSize, unsigned int seed = 0);
-    Layer(int inputSize, int outputSize, std::function<double(double)> activation,
-          std::function<double(double)> activationDerivative, unsigned int seed = 0);
-    Layer(int inputSize, int outputSize, std::function<double(double)> activation,
-          std::function<double(double)> activationDerivative, const std::string& activationName, 
-          unsigned int seed = 0);
-    Layer(int inputSize, int outputSize, bool useSoftmax, unsigned int seed = 0);
+    BasicLayer(int inputSize, int outputSize, unsigned int seed = 0);
+    BasicLayer(int inputSize, int outputSize, ActivationFunctions::Kind activation,
+               unsigned int seed = 0);
+    // std::function activations are applied one element at a time; prefer the
+    // Kind constructor for the built-in ones.
+    BasicLayer(int inputSize, int outputSize, std::function<T(T)> activation,
+               std::function<T(T)> activationDerivative, unsigned int seed = 0);
+    BasicLayer(int inputSize, int outputSize, std::function<T(T)> activation,
+               std::function<T(T)> activationDerivative, const std::string& activationName,
+               unsigned int seed = 0);
+    BasicLayer(int inputSize, int outputSize, bool useSoftmax, unsigned int seed = 0);
+    // Takes trained parameters as they are; `weights` is outputSize x inputSize
+    // and may be a view adopted from a mapped model file.
+    BasicLayer(Matrix<T> weights, std::vector<T> biases, ActivationFunctions::Kind activation);
 
-    std::vector<double> forward(const std::vector<double>& inputs);
+    // Activations and gradients of one batched pass. The layer keeps its own
+    // context for the single-threaded API; data-parallel training gives each
+    // worker a separate one so the weights can be shared read-only.
+    struct Context {
+        Matrix<T> inputs;
+        Matrix<T> outputs;
+        Matrix<T> deltas;
+        Matrix<T> inputGradients;
+        Matrix<T> weightGradients;
+        std::vector<T> biasGradients;
+        // mixed precision keeps the inputs for backward here instead
+        Matrix<BFloat16> halfInputs;
+    };
 
-    std::vector<double> backward(const std::vector<double>& gradients);
+    std::vector<T> forward(Span<const T> inputs);
 
-    std::vector<std::vector<double>> computeWeightGradients(const std::vector<double>& gradients);
-    std::vector<double> computeBiasGradients(const std::vector<double>& gradients);
+    // Inference only: writes f(W x + b) into `outputs` (getOutputSize() elements)
+    // without touching the layer's state, so it is safe to call concurrently.
+    void forward(Span<const T> inputs, Span<T> outputs) const;
+
+    // Computes the deltas once and fills the weight, bias and input gradients
+    // in place; the returned input gradients stay valid until the next call.
+    const std::vector<T>& backward(const std::vector<T>& gradients);
+
+    // Batched variants: rows are samples. backwardBatch averages the weight and
+    // bias gradients over the batch and returns the gradients w.r.t. the inputs.
+    const Matrix<T>& forwardBatch(const Matrix<T>& inputs);
+    const Matrix<T>& backwardBatch(const Matrix<T>& gradients);
+
+    // Context variants: gradients land in `context`, scaled by `scale` instead
+    // of 1 / rows, so shards of one batch can be summed into its average. The
+    // first layer of a network passes propagate = false to skip the input
+    // gradients nobody reads; the returned matrix is then empty.
+    const Matrix<T>& forwardBatch(const Matrix<T>& inputs, Context& context) const;
+    // Inference only: writes the activations of every row of `inputs` into
+    // `outputs` (resized to rows x outputSize); keeps nothing for backward.
+    void forwardBatch(const Matrix<T>& inputs, Matrix<T>& outputs) const;
+    const Matrix<T>& backwardBatch(const Matrix<T>& gradients, Context& context, T scale,
+                                   bool propagate = true) const;
+
+    // Allocating helpers kept for callers outside training; backward() already
+    // leaves the same values, laid out the same way, in getWeightGradients()
+    // and getBiasGradients().
+    Matrix<T> computeWeightGradients(const std::vector<T>& gradients);
+    std::vector<T> computeBiasGradients(const std::vector<T>& gradients);
+
+    // Post-training int8 quantization for inference. Each output gets its own
+    // symmetric weight scale; inputs are quantized on the fly to 8 bits with a
+    // single scale calibrated on the rows of `calibration` (unsigned when they
+    // are never negative, as after a relu). The floating-point weights are
+    // released: forward passes run Gemm::gemmU8S8 and dequantize with the bias
+    // and activation in the same pass, and backward passes throw
+    // std::logic_error.
+    void quantize(const Matrix<T>& calibration);
+    bool isQuantized() const;
+
+    // Mixed precision for training: forward and backward passes read a
+    // bfloat16 copy of the weights and keep the inputs the weight gradients
+    // need in bfloat16, halving that traffic, while products still accumulate
+    // in T. The T weights stay the master copy the optimizer updates; call
+    // refreshMixedPrecision() after each update to round them again. bfloat16
+    // has the exponent range of float, so gradients need no loss scaling.
+    // Throws std::logic_error for quantized layers.
+    void setMixedPrecision(bool enabled);
+    bool isMixedPrecision() const;
+    void refreshMixedPrecision();
+
+    // Magnitude pruning: zeroes the smallest-magnitude weights until a
+    // `sparsity` fraction (0 to 1) of the layer's inputSize x outputSize
+    // weights are zero. Already pruned weights count towards the target, so
+    // raising it step by step prunes gradually. Dense layers remember the
+    // pattern in a mask that applyPruningMask() re-imposes after each
+    // optimizer step; sparse layers drop the pruned entries. Throws
+    // std::invalid_argument for a sparsity outside [0, 1] and
+    // std::logic_error for quantized layers.
+    void prune(double sparsity);
+    void applyPruningMask();
+    // Zeroes the gradients of pruned weights in `weightGradients` (laid out
+    // like getWeightGradients()), so an optimizer step leaves them at zero
+    // without writing the shared weights again, as asynchronous training
+    // needs. Does nothing unless the layer holds a pruning mask.
+    void maskGradients(Matrix<T>& weightGradients) const;
+    // Converts the weights to compressed sparse rows and releases the dense
+    // ones: forward and backward passes then run the Sparse kernels, whose
+    // cost scales with the nonzeros, and training updates only those, so the
+    // pattern stays fixed. Throws std::logic_error for quantized and
+    // mixed-precision layers; calling it again does nothing.
+    void sparsify();
+    bool isSparse() const;
+    // fraction of the inputSize x outputSize weights that are zero
+    double getSparsity() const;
+    // What the optimizer updates: the dense weights with their row padding,
+    // or the nonzeros of a sparse layer, matching getWeightGradients().
+    Span<T> getWeightParameters();
 
     int getInputSize() const;
     int getOutputSize() const;
-    std::vector<std::vector<double>>& getWeights() ;
-    std::vector<double>& getBiases() ;
-    
-    const std::vector<std::vector<double>>& getWeightGradients() const;
-    const std::vector<double>& getBiasGradients() const;
+    ActivationFunctions::Kind getActivation() const;
+    // weights, biases, quantization scales and the bfloat16 weights of mixed
+    // precision as stored, without row padding; values and indices when sparse
+    size_t getParameterBytes() const;
+    // empty once the layer is quantized or sparse
+    Matrix<T>& getWeights();
+    const Matrix<T>& getWeights() const;
+    std::vector<T>& getBiases();
+    const std::vector<T>& getBiases() const;
+    // empty unless the layer is sparse
+    const Sparse::CsrMatrix<T>& getSparseWeights() const;
+
+    // outputSize x inputSize, or 1 x nonzeros in the order of the sparse
+    // weights' values
+    const Matrix<T>& getWeightGradients() const;
+    const std::vector<T>& getBiasGradients() const;
 
 private:
     int inputSize;
     int outputSize;
-    
-    std::vector<std::vector<double>> weights;
-    std::vector<std::vector<double>> weightsGradients;
-    std::vector<double> biases;
-    std::vector<double> biasGradients;
 
-    std::vector<double> inputs; 
-    std::vector<double> outputs;
+    Matrix<T> weights;
+    std::vector<T> biases;
+    // bfloat16 working copy of `weights`; empty unless mixed precision is on
+    Matrix<BFloat16> halfWeights;
+    // replaces `weights` once sparsified
+    Sparse::CsrMatrix<T> sparseWeights;
+    // 1 for kept weights, 0 for pruned ones; empty until a dense layer is pruned
+    Matrix<T> pruningMask;
+
+    std::vector<T> inputs;
+    std::vector<T> outputs;
+    std::vector<T> delta;
+    std::vector<T> inputGradients;
 
-    std::function<double(double)> activation;
-    std::function<double(double)> activationDerivative;
-    bool isSoftmax = false;
+    // also holds the gradients of the last backward pass
+    Context context;
 
-    void initializeWeights(unsigned int seed, const std::string& activationName);
+    ActivationFunctions::Kind kind = ActivationFunctions::Kind::Custom;
+    std::function<T(T)> activation;
+    std::function<T(T)> activationDerivative;
+
+    struct Quantization {
+        // the outputSize x inputSize int8 weights in Gemm::packS8 layout
+        Matrix<int8_t> weights;
+        // input scale * weight scale, per output
+        std::vector<T> scales;
+        // zero point * sum of the output's int8 weights
+        std::vector<int32_t> offsets;
+        T inputScale = T(1);
+        // 0 for inputs that are never negative, 128 otherwise
+        int32_t zeroPoint = 0;
+    };
+    // shared so copies of a quantized layer stay cheap; never modified
+    std::shared_ptr<const Quantization> quantization;
+
+    // He-uniform for relu, Glorot-uniform otherwise
+    void initializeWeights(unsigned int seed, ActivationFunctions::Kind initialization);
+    // y = f(y) over one sample's outputs
+    void activate(T* outputs, size_t n) const;
+    // delta = dL/dy * f'(y), computed from the activated outputs
+    void activationBackward(const T* gradients, const T* outputs, T* deltas, size_t n) const;
+    // delta * x^T for the sample of the last forward(), reading its bfloat16
+    // copy under mixed precision
+    void sampleWeightGradients(const T* delta, Matrix<T>& weightGradients) const;
+    // f(W x + b) for `rows` rows with the int8 weights
+    void forwardQuantized(const T* inputs, size_t inputStride, size_t rows,
+                          T* outputs, size_t outputStride) const;
+    void checkTrainable() const;
 };
 
+using Layer = BasicLayer<double>;
+
 #endif
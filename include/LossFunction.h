@@ -1,14 +1,32 @@
 #ifndef LOSS_FUNCTION_H
 #define LOSS_FUNCTION_H
 
+#include "Matrix.h"
 #include <vector>
 
+// Loss functions are templated on the scalar type; float and double are
+// instantiated in LossFunction.cpp.
 namespace LossFunction {
 
-    double meanSquaredError(const std::vector<double>& predicted, const std::vector<double>& actual);
-    std::vector<double> meanSquaredErrorDerivative(const std::vector<double>& predicted, const std::vector<double>& actual);
-    double crossEntropy(const std::vector<double>& predicted, const std::vector<double>& actual);
-    std::vector<double> crossEntropyDerivative(const std::vector<double>& predicted, const std::vector<double>& actual);
+    template <typename T>
+    T meanSquaredError(const std::vector<T>& predicted, const std::vector<T>& actual);
+    template <typename T>
+    std::vector<T> meanSquaredErrorDerivative(const std::vector<T>& predicted, const std::vector<T>& actual);
+    template <typename T>
+    T crossEntropy(const std::vector<T>& predicted, const std::vector<T>& actual);
+    template <typename T>
+    std::vector<T> crossEntropyDerivative(const std::vector<T>& predicted, const std::vector<T>& actual);
+
+    // Batched variants: rows are samples. The loss is summed over the rows and
+    // the derivative is written row by row into `derivative`.
+    template <typename T>
+    T meanSquaredError(const Matrix<T>& predicted, const Matrix<T>& actual);
+    template <typename T>
+    void meanSquaredErrorDerivative(const Matrix<T>& predicted, const Matrix<T>& actual, Matrix<T>& derivative);
+    template <typename T>
+    T crossEntropy(const Matrix<T>& predicted, const Matrix<T>& actual);
+    template <typename T>
+    void crossEntropyDerivative(const Matrix<T>& predicted, const Matrix<T>& actual, Matrix<T>& derivative);
 
 }
 
@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// A whole file mapped into memory copy-on-write: processes mapping the same
+// file share its physical pages until they write to them. The mapping is
+// released when the last shared_ptr goes away, so views into it can hold one
+// as their keep-alive.
+class MappedFile {
+public:
+    static std::shared_ptr<MappedFile> open(const std::string& filename);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* data() const;
+    size_t size() const;
+
+private:
+    MappedFile(void* address, size_t length);
+
+    void* address;
+    size_t length;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Non-owning view over a contiguous run of elements (one matrix row, a vector, ...).
+template <typename T>
+class Span {
+public:
+    Span() = default;
+    Span(T* data, std::size_t size) : ptr(data), count(size) {}
+
+    template <typename U, typename A>
+    Span(const std::vector<U, A>& vec) : ptr(vec.data()), count(vec.size()) {}
+
+    template <typename U, typename A>
+    Span(std::vector<U, A>& vec) : ptr(vec.data()), count(vec.size()) {}
+
+    template <typename U>
+    Span(const Span<U>& other) : ptr(other.data()), count(other.size()) {}
+
+    T* data() const { return ptr; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T& operator[](std::size_t i) const { return ptr[i]; }
+
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + count; }
+
+    std::vector<typename std::remove_const<T>::type> toVector() const {
+        return std::vector<typename std::remove_const<T>::type>(begin(), end());
+    }
+
+private:
+    T* ptr = nullptr;
+    std::size_t count = 0;
+};
+
+// Blocks allocated by every Matrix so far, for the training telemetry.
+inline std::atomic<std::size_t>& matrixAllocationCount() {
+    static std::atomic<std::size_t> count{0};
+    return count;
+}
+
+// Dense row-major matrix stored in a single 64-byte aligned block.
+// Rows are padded so that every row starts on an alignment boundary; stride()
+// is the distance in elements between consecutive rows.
+template <typename T>
+class Matrix {
+public:
+    static constexpr std::size_t Alignment = 64;
+
+    Matrix() = default;
+
+    Matrix(std::size_t rows, std::size_t cols, T value = T())
+        : nRows(rows), nCols(cols), rowStride(paddedStride(cols)) {
+        allocate();
+        fill(value);
+    }
+
+    Matrix(std::initializer_list<std::initializer_list<T>> rows)
+        : Matrix(rows.size(), rows.size() ? rows.begin()->size() : 0) {
+        std::size_t i = 0;
+        for (const auto& row : rows) {
+            if (row.size() != nCols) {
+                throw std::invalid_argument("Matrix rows must all have the same length");
+            }
+            std::copy(row.begin(), row.end(), rowData(i++));
+        }
+    }
+
+    Matrix(const std::vector<std::vector<T>>& rows)
+        : Matrix(rows.size(), rows.empty() ? 0 : rows[0].size()) {
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            if (rows[i].size() != nCols) {
+                throw std::invalid_argument("Matrix rows must all have the same length");
+            }
+            std::copy(rows[i].begin(), rows[i].end(), rowData(i));
+        }
+    }
+
+    Matrix(const Matrix& other)
+        : nRows(other.nRows), nCols(other.nCols), rowStride(other.rowStride) {
+        allocate();
+        std::copy(other.buffer.get(), other.buffer.get() + capacity(), buffer.get());
+    }
+
+    // Wraps storage owned elsewhere (a memory-mapped file, ...) without copying.
+    // `data` must be Alignment-aligned with paddedStride(cols) elements per row;
+    // `owner` is kept alive for as long as the matrix uses the storage. Resizing
+    // beyond the adopted block or copying moves to ordinary owned storage.
+    static Matrix adopt(T* data, std::size_t rows, std::size_t cols, std::shared_ptr<void> owner) {
+        Matrix adopted;
+        adopted.nRows = rows;
+        adopted.nCols = cols;
+        adopted.rowStride = paddedStride(cols);
+        adopted.buffer = Buffer(data, Deleter{std::move(owner)});
+        adopted.allocated = adopted.capacity();
+        return adopted;
+    }
+
+    Matrix(Matrix&& other) noexcept
+        : nRows(other.nRows), nCols(other.nCols), rowStride(other.rowStride),
+          allocated(other.allocated), buffer(std::move(other.buffer)) {
+        other.nRows = other.nCols = other.rowStride = other.allocated = 0;
+    }
+
+    // Reuses the current block when it is large enough, so assigning batches of
+    // a steady shape does not allocate.
+    Matrix& operator=(const Matrix& other) {
+        if (this == &other) return *this;
+        if (!buffer || other.capacity() > allocated) {
+            Matrix copy(other);
+            *this = std::move(copy);
+            return *this;
+        }
+        nRows = other.nRows;
+        nCols = other.nCols;
+        rowStride = other.rowStride;
+        std::copy(other.buffer.get(), other.buffer.get() + capacity(), buffer.get());
+        return *this;
+    }
+
+    Matrix& operator=(Matrix&& other) noexcept {
+        nRows = other.nRows;
+        nCols = other.nCols;
+        rowStride = other.rowStride;
+        allocated = other.allocated;
+        buffer = std::move(other.buffer);
+        other.nRows = other.nCols = other.rowStride = other.allocated = 0;
+        return *this;
+    }
+
+    std::size_t rows() const { return nRows; }
+    std::size_t cols() const { return nCols; }
+    std::size_t stride() const { return rowStride; }
+    bool empty() const { return nRows == 0 || nCols == 0; }
+
+    // Number of elements in the underlying block, padding included.
+    std::size_t capacity() const { return nRows * rowStride; }
+
+    T* data() { return buffer.get(); }
+    const T* data() const { return buffer.get(); }
+
+    T* rowData(std::size_t i) { return buffer.get() + i * rowStride; }
+    const T* rowData(std::size_t i) const { return buffer.get() + i * rowStride; }
+
+    T& operator()(std::size_t i, std::size_t j) { return buffer[i * rowStride + j]; }
+    const T& operator()(std::size_t i, std::size_t j) const { return buffer[i * rowStride + j]; }
+
+    Span<T> operator[](std::size_t i) { return Span<T>(rowData(i), nCols); }
+    Span<const T> operator[](std::size_t i) const { return Span<const T>(rowData(i), nCols); }
+
+    // Reshapes the matrix, discarding its contents when the shape changes. The
+    // block is only reallocated when it is too small for the new shape, so a
+    // matrix that shrank can grow back to its largest shape without one.
+    void resize(std::size_t rows, std::size_t cols, T value = T()) {
+        if (rows == nRows && cols == nCols) return;
+        std::size_t newStride = paddedStride(cols);
+        if (rows * newStride > allocated || !buffer) {
+            nRows = rows;
+            nCols = cols;
+            rowStride = newStride;
+            allocate();
+        } else {
+            nRows = rows;
+            nCols = cols;
+            rowStride = newStride;
+        }
+        fill(value);
+    }
+
+    // Copies rows [first, first + count) of source into this matrix.
+    void assignRows(const Matrix& source, std::size_t first, std::size_t count) {
+        resize(count, source.cols());
+        std::copy(source.rowData(first), source.rowData(first) + count * rowStride, data());
+    }
+
+    // Copies rows indices[0], ..., indices[count - 1] of source into this matrix.
+    void assignRows(const Matrix& source, const std::size_t* indices, std::size_t count) {
+        resize(count, source.cols());
+        for (std::size_t i = 0; i < count; ++i) {
+            std::copy(source.rowData(indices[i]), source.rowData(indices[i]) + rowStride, rowData(i));
+        }
+    }
+
+    // Reshapes the matrix, keeping the elements that fall inside both shapes.
+    void conservativeResize(std::size_t rows, std::size_t cols, T value = T()) {
+        if (rows == nRows && cols == nCols) return;
+        Matrix resized(rows, cols, value);
+        for (std::size_t i = 0; i < std::min(rows, nRows); ++i) {
+            std::copy(rowData(i), rowData(i) + std::min(cols, nCols), resized.rowData(i));
+        }
+        *this = std::move(resized);
+    }
+
+    void fill(T value) {
+        std::fill(buffer.get(), buffer.get() + capacity(), T());
+        for (std::size_t i = 0; i < nRows; ++i) {
+            std::fill(rowData(i), rowData(i) + nCols, value);
+        }
+    }
+
+    void setZero() { std::fill(buffer.get(), buffer.get() + capacity(), T()); }
+
+    std::vector<std::vector<T>> toNested() const {
+        std::vector<std::vector<T>> out(nRows);
+        for (std::size_t i = 0; i < nRows; ++i) {
+            out[i].assign(rowData(i), rowData(i) + nCols);
+        }
+        return out;
+    }
+
+    static std::size_t paddedStride(std::size_t cols) {
+        const std::size_t lanes = Alignment / sizeof(T);
+        return (cols + lanes - 1) / lanes * lanes;
+    }
+
+private:
+    // Frees blocks from allocate(); adopted storage is released by dropping `owner`.
+    struct Deleter {
+        std::shared_ptr<void> owner;
+        void operator()(T* p) const {
+            if (!owner) std::free(p);
+        }
+    };
+    using Buffer = std::unique_ptr<T[], Deleter>;
+
+    void allocate() {
+        std::size_t bytes = capacity() * sizeof(T);
+        if (bytes == 0) {
+            buffer = Buffer();
+            allocated = 0;
+            return;
+        }
+        void* p = std::aligned_alloc(Alignment, bytes);
+        if (!p) throw std::bad_alloc();
+        buffer = Buffer(static_cast<T*>(p), Deleter());
+        allocated = capacity();
+        matrixAllocationCount().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::size_t nRows = 0;
+    std::size_t nCols = 0;
+    std::size_t rowStride = 0;
+    // elements in the block, at least capacity()
+    std::size_t allocated = 0;
+    Buffer buffer;
+};
+
+#endif
@@ -3,22 +3,20 @@
 
 #include "Optimizer.h"
 
-class Momentum : public Optimizer {
+template <typename T>
+class BasicMomentum : public BasicOptimizer<T> {
 public:
-    Momentum(double momentum = 0.9);
+    using typename BasicOptimizer<T>::ParameterGroup;
 
-    void updateWeights(std::vector<std::vector<double>>& weights,
-                       const std::vector<std::vector<double>>& weightGradients,
-                       double learningRate) override;
+    BasicMomentum(T momentum = T(0.9));
 
-    void updateBiases(std::vector<double>& biases,
-                      const std::vector<double>& biasGradients,
-                      double learningRate) override;
+protected:
+    void apply(const std::vector<ParameterGroup>& groups, T learningRate) override;
 
 private:
-    double momentum;
-    std::vector<std::vector<double>> weightVelocities;
-    std::vector<double> biasVelocities;
+    T momentum;
 };
 
-#endif
\ No newline at end of file
+using Momentum = BasicMomentum<double>;
+
+#endif
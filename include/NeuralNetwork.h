@@ -2,45 +2,274 @@
 #define NEURAL_NETWORK_H
 
 #include "Layer.h"
+#include "InferencePlan.h"
+#include "DataPipeline.h"
 #include "LossFunction.h"
 #include "Optimizer.h"
+#include "ThreadPool.h"
+#include "Telemetry.h"
+#include <chrono>
+#include <random>
 #include <vector>
 #include <memory>
 
-class NeuralNetwork {
+// Feed-forward network templated on its scalar type; float and double are
+// instantiated in NeuralNetworkLib.
+template <typename T>
+class BasicNeuralNetwork {
 public:
-    NeuralNetwork();
+    BasicNeuralNetwork();
 
-    NeuralNetwork(const std::vector<int>& layerSizes,
-                  const std::string& activationFunction,
-                  const std::string& lossFunction,
-                  const std::string& optimizer,
-                  unsigned int seed = 0);
+    BasicNeuralNetwork(const std::vector<int>& layerSizes,
+                       const std::string& activationFunction,
+                       const std::string& lossFunction,
+                       const std::string& optimizer,
+                       unsigned int seed = 0);
 
-    NeuralNetwork(const std::vector<int>& layerSizes,
-                  const std::string& hiddenActivation,
-                  const std::string& outputActivation,
-                  const std::string& lossFunction,
-                  const std::string& optimizer,
-                  unsigned int seed = 0);
+    BasicNeuralNetwork(const std::vector<int>& layerSizes,
+                       const std::string& hiddenActivation,
+                       const std::string& outputActivation,
+                       const std::string& lossFunction,
+                       const std::string& optimizer,
+                       unsigned int seed = 0);
 
-    void train(const std::vector<std::vector<double>>& inputs,
-               const std::vector<std::vector<double>>& targets,
-               int epochs, double learningRate);
+    void train(const Matrix<T>& inputs,
+               const Matrix<T>& targets,
+               int epochs, T learningRate,
+               int batchSize = 1);
 
-    std::vector<double> predict(const std::vector<double>& input);
+    // Trains on rows[0], rows[1], ... of inputs and targets in that order, as
+    // if those rows had been copied out first (see DataLoader::Split).
+    void train(const Matrix<T>& inputs,
+               const Matrix<T>& targets,
+               const std::vector<size_t>& rows,
+               int epochs, T learningRate,
+               int batchSize = 1);
 
-    void addLayer(std::unique_ptr<Layer> layer);
+    // Trains on the pipeline's batches, batchesPerEpoch() of them per epoch;
+    // the next batch is packed in the background during each step.
+    void train(BasicDataPipeline<T>& pipeline, int epochs, T learningRate);
 
-    double evaluate(const std::vector<std::vector<double>>& inputs,
-                    const std::vector<std::vector<double>>& targets,
-                    double tolerance = 0.01);
+    // Ping-pong activation buffers for the allocation-free predict. A model can
+    // serve several threads at once as long as each brings its own workspace.
+    struct Workspace {
+        std::vector<T> ping;
+        std::vector<T> pong;
+        // hidden activations of predictBatch
+        Matrix<T> batchPing;
+        Matrix<T> batchPong;
+    };
+
+    // A workspace sized to the widest hidden layer.
+    Workspace makeWorkspace() const;
+
+    // Writes the network's output for `input` into `output`. Does not allocate
+    // once `workspace` has been sized by makeWorkspace (or a previous call).
+    void predict(Span<const T> input, Span<T> output, Workspace& workspace) const;
+
+    // Batched inference, one GEMM per layer: row r of `outputs` (resized to
+    // rows x output size) is the prediction for row r of `inputs`. Allocates
+    // only when the batch is larger than any before it in `workspace`.
+    void predictBatch(const Matrix<T>& inputs, Matrix<T>& outputs, Workspace& workspace) const;
+
+    std::vector<T> predict(const std::vector<T>& input) const;
+    std::vector<T> predict(Span<const T> input) const;
+
+    void addLayer(std::unique_ptr<BasicLayer<T>> layer);
+
+    // Data-parallel training: each mini-batch is split into contiguous shards,
+    // one per thread, whose gradients are tree-reduced into one optimizer step.
+    // 0 uses every hardware thread, 1 (the default) trains on the caller only.
+    // For a fixed thread count the result does not depend on scheduling.
+    void setThreadCount(size_t threads);
+
+    // Asynchronous ("Hogwild") training for train(inputs, targets[, rows]):
+    // the setThreadCount threads take batches of batchSize samples from one
+    // shuffled order of the epoch's samples and each applies its own
+    // optimizer step straight to the shared weights, without locks or a
+    // reduction. The races are by design: a thread may read weights halfway
+    // through another's update, and concurrent updates of the same weight can
+    // overwrite each other. When updates rarely collide, as with small
+    // batches, sparse layers or sparse inputs, this converges about like
+    // sequential SGD on the same samples and scales with the threads; dense
+    // layers see every update collide and need a smaller learning rate as
+    // threads are added. Each thread keeps its own optimizer state (Momentum
+    // velocity, Adam moments), which starts afresh when the mode is enabled.
+    // With one thread it is shuffled mini-batch training, reproducible for a
+    // fixed `seed` (0 seeds from std::random_device); with more, results
+    // depend on scheduling. train(pipeline) stays synchronous, and training
+    // with mixed precision throws std::logic_error.
+    void setAsynchronous(bool enabled, unsigned int seed = 0);
+    bool isAsynchronous() const;
+
+    // Receives the timings, throughput and allocation count of every training
+    // epoch; the default prints the loss every 100 epochs. nullptr reports
+    // nothing and skips the timers.
+    void setMetricsSink(std::shared_ptr<Telemetry::Sink> sink);
+
+    // bfloat16 mixed-precision training (see BasicLayer::setMixedPrecision)
+    // for every layer, including those added later. Each optimizer step
+    // updates the T master weights and rounds them again. Inference runs on
+    // the bfloat16 weights too; save() and compile() use the master weights.
+    // Not stored in model files.
+    void setMixedPrecision(bool enabled);
+    bool isMixedPrecision() const;
+
+    // Magnitude pruning of every layer to `sparsity` (see BasicLayer::prune);
+    // training keeps the pruned weights at zero.
+    void prune(double sparsity);
+    // Converts every layer to compressed sparse rows (see
+    // BasicLayer::sparsify), typically once pruning is done. The optimizer
+    // starts afresh on the nonzeros; sparse networks can be trained and
+    // evaluated but not saved, compiled or quantized.
+    void sparsify();
+
+    // Gradual pruning during train: at the end of epochs startEpoch to
+    // endEpoch of each call every layer is pruned to
+    //   sparsity * (1 - (1 - (epoch - startEpoch + 1) / (endEpoch - startEpoch + 1))^3),
+    // quickly at first and slowly as the target is reached, so the remaining
+    // epochs can recover. A sparsity of 0 (the default) turns it off.
+    struct PruningSchedule {
+        double sparsity = 0.0;
+        int startEpoch = 0;
+        int endEpoch = 0;
+    };
+    void setPruningSchedule(const PruningSchedule& schedule);
+
+    int getInputSize() const;
+    int getOutputSize() const;
+    size_t getLayerCount() const;
+    const BasicLayer<T>& getLayer(size_t index) const;
+    // weights, biases and quantization scales of every layer
+    size_t getParameterBytes() const;
+    // fraction of zero weights over all layers
+    double getSparsity() const;
+
+    // Post-training int8 quantization (see BasicLayer::quantize): an
+    // inference-only copy of this network whose layers are calibrated on the
+    // activations this network produces for `calibration`, a representative
+    // slice of the training inputs. The copy keeps the loss function, so
+    // evaluate() on both shows what quantizing costs; training or saving it
+    // throws.
+    BasicNeuralNetwork quantized(const Matrix<T>& calibration) const;
+    BasicNeuralNetwork quantized(const Matrix<T>& calibration, const std::vector<size_t>& rows) const;
+
+    // Freezes the network into a fused, immutable inference plan that owns a
+    // copy of the weights (see BasicInferencePlan). Throws
+    // std::invalid_argument for layers with custom activation functions and
+    // for quantized and sparse layers.
+    BasicInferencePlan<T> compile() const;
+
+    // Versioned binary model: layer sizes, activations, weights and biases in
+    // host byte order, each weight matrix 64-byte aligned with its padded row
+    // stride, and optionally the optimizer state to resume training. Throws
+    // std::invalid_argument for layers with custom activation functions and
+    // for quantized and sparse layers.
+    void save(const std::string& filename, bool includeOptimizerState = false) const;
+
+    // Maps the file and points every layer's weights at the mapped pages, with
+    // no parsing or copying; the mapping lives as long as the network. Throws
+    // std::runtime_error for malformed files or a different scalar type.
+    static BasicNeuralNetwork load(const std::string& filename);
+
+    // Accuracy, loss and confusion matrix of one pass over a dataset. The task
+    // is decided once from the targets: one-hot rows are scored by arg max, a
+    // single 0/1 column by thresholding the output at 0.5, anything else
+    // element-wise within the tolerance.
+    struct Evaluation {
+        enum class Task { Classification, Binary, Regression };
+        Task task = Task::Regression;
+        size_t samples = 0;
+        double accuracy = 0.0;
+        // mean loss per sample; 0 when the network has no loss function
+        double loss = 0.0;
+        // confusion(actual, predicted): classes x classes, 2 x 2 for binary
+        // targets, empty for regression
+        Matrix<size_t> confusion;
+    };
+
+    // Forward passes run in batches, split across the setThreadCount threads;
+    // for a fixed thread count the result does not depend on scheduling.
+    Evaluation evaluateDetailed(const Matrix<T>& inputs,
+                                const Matrix<T>& targets,
+                                T tolerance = T(0.01));
+    Evaluation evaluateDetailed(const Matrix<T>& inputs,
+                                const Matrix<T>& targets,
+                                const std::vector<size_t>& rows,
+                                T tolerance = T(0.01));
+
+    // evaluateDetailed(...).accuracy
+    double evaluate(const Matrix<T>& inputs,
+                    const Matrix<T>& targets,
+                    T tolerance = T(0.01));
+    double evaluate(const Matrix<T>& inputs,
+                    const Matrix<T>& targets,
+                    const std::vector<size_t>& rows,
+                    T tolerance = T(0.01));
 
 private:
-    std::vector<std::unique_ptr<Layer>> layers;
-    std::function<double(const std::vector<double>&, const std::vector<double>&)> lossFunction;
-    std::function<std::vector<double>(const std::vector<double>&, const std::vector<double>&)> lossDerivative;
-    std::unique_ptr<Optimizer> optimizer;
+    void setLossFunction(const std::string& name);
+    void setOptimizer(const std::string& name);
+    // throws std::logic_error for quantized networks
+    void checkTrainable() const;
+
+    std::vector<std::unique_ptr<BasicLayer<T>>> layers;
+    std::string lossName;
+    std::string optimizerName;
+    std::function<T(const std::vector<T>&, const std::vector<T>&)> lossFunction;
+    std::function<std::vector<T>(const std::vector<T>&, const std::vector<T>&)> lossDerivative;
+    std::function<T(const Matrix<T>&, const Matrix<T>&)> batchLossFunction;
+    std::function<void(const Matrix<T>&, const Matrix<T>&, Matrix<T>&)> batchLossDerivative;
+    std::unique_ptr<BasicOptimizer<T>> optimizer;
+    // weights and biases of every layer, in layer order; rebuilt in place each step
+    std::vector<typename BasicOptimizer<T>::ParameterGroup> parameterGroups;
+
+    // per-shard activations and gradients; workers[0] receives the reduction
+    struct Worker {
+        std::vector<typename BasicLayer<T>::Context> contexts;
+        Matrix<T> inputs;
+        Matrix<T> targets;
+        Matrix<T> gradients;
+        T loss = T(0);
+        Telemetry::PhaseTimes times;
+        // asynchronous training: this thread's optimizer and its view of the parameters
+        std::unique_ptr<BasicOptimizer<T>> optimizer;
+        std::vector<typename BasicOptimizer<T>::ParameterGroup> parameterGroups;
+    };
+    std::vector<Worker> workers;
+    std::unique_ptr<ThreadPool> pool;
+    bool mixedPrecision = false;
+    bool asynchronous = false;
+    std::mt19937 shuffleGenerator;
+    // the shuffled samples of an asynchronous epoch
+    std::vector<size_t> asynchronousOrder;
+    PruningSchedule pruningSchedule;
+
+    std::shared_ptr<Telemetry::Sink> metricsSink = std::make_shared<Telemetry::ConsoleSink>();
+    Telemetry::EpochMetrics metrics;
+    std::chrono::steady_clock::time_point epochStart;
+    size_t allocationsAtEpochStart = 0;
+
+    // `rows` selects and orders the samples; nullptr means all of them in order
+    void trainRows(const Matrix<T>& inputs, const Matrix<T>& targets, const size_t* rows,
+                   size_t samples, int epochs, T learningRate, int batchSize);
+    Evaluation evaluateRows(const Matrix<T>& inputs, const Matrix<T>& targets, const size_t* rows,
+                            size_t samples, T tolerance);
+    // one optimizer step on samples [start, start + count); returns the summed loss
+    T trainBatch(const Matrix<T>& inputs, const Matrix<T>& targets, const size_t* rows,
+                 size_t start, size_t count, T learningRate);
+    // one lock-free epoch (see setAsynchronous); returns the summed loss
+    T trainAsynchronous(const Matrix<T>& inputs, const Matrix<T>& targets, const size_t* rows,
+                        size_t samples, T learningRate, size_t batchSize);
+    void trainShard(Worker& worker, const Matrix<T>& inputs, const Matrix<T>& targets,
+                    const size_t* rows, size_t first, size_t count, T scale);
+    void reduceGradients(size_t shards);
+    // applies the pruning schedule at the end of `epoch`
+    void pruneEpoch(int epoch);
+    void beginEpoch();
+    void endEpoch(int epoch, T totalLoss, size_t samples, size_t batches);
 };
 
+using NeuralNetwork = BasicNeuralNetwork<double>;
+
 #endif
@@ -1,19 +1,61 @@
 #ifndef OPTIMIZER_H
 #define OPTIMIZER_H
 
+#include "Matrix.h"
 #include <vector>
 
-class Optimizer {
+// Optimizers update a list of parameter groups (one per weight matrix or bias
+// vector) in a single step. Each group owns a separate slice of optimizer state;
+// groups are identified by their position, so callers pass them in the same
+// order every step.
+template <typename T>
+class BasicOptimizer {
 public:
-    virtual ~Optimizer() = default;
+    // A parameter tensor and its gradient, laid out identically (padding
+    // included) so the update is one flat loop over `size` elements.
+    struct ParameterGroup {
+        T* values;
+        const T* gradients;
+        size_t size;
+    };
 
-    virtual void updateWeights(std::vector<std::vector<double>>& weights,
-                               const std::vector<std::vector<double>>& weightGradients,
-                               double learningRate) = 0;
+    virtual ~BasicOptimizer() = default;
 
-    virtual void updateBiases(std::vector<double>& biases,
-                              const std::vector<double>& biasGradients,
-                              double learningRate) = 0;
+    // Applies one update to every group. State is laid out on the first step
+    // and again (zeroed) only if the number or sizes of the groups change.
+    void step(const std::vector<ParameterGroup>& groups, T learningRate);
+
+    // Steps taken since the state was last laid out.
+    int stepCount() const;
+
+    // Serialization: the group sizes the state was laid out for, and the state
+    // itself (one row per slot, groups at 64-byte aligned offsets).
+    const std::vector<size_t>& groupSizes() const;
+    const Matrix<T>& stateData() const;
+    // Restores what groupSizes/stateData/stepCount returned; throws
+    // std::invalid_argument if `state` does not match that layout.
+    void restoreState(const std::vector<size_t>& sizes, const Matrix<T>& state, int steps);
+
+protected:
+    // stateSlots: values kept per parameter (velocity, moments, ...)
+    explicit BasicOptimizer(size_t stateSlots);
+
+    virtual void apply(const std::vector<ParameterGroup>& groups, T learningRate) = 0;
+
+    // State slot `slot` of group `group`; 64-byte aligned, `size` elements long.
+    T* state(size_t slot, size_t group);
+
+private:
+    void layout(const std::vector<size_t>& groupSizes);
+
+    size_t stateSlots;
+    int steps = 0;
+    std::vector<size_t> sizes;
+    std::vector<size_t> offsets;
+    // one row per slot; every group's slice starts on an alignment boundary
+    Matrix<T> stateBuffer;
 };
 
-#endif
\ No newline at end of file
+using Optimizer = BasicOptimizer<double>;
+
+#endif
@@ -4,17 +4,17 @@
 #include "Optimizer.h"
 #include <vector>
 
-class SGD : public Optimizer {
+template <typename T>
+class BasicSGD : public BasicOptimizer<T> {
 public:
-    SGD() = default;
+    using typename BasicOptimizer<T>::ParameterGroup;
 
-    void updateWeights(std::vector<std::vector<double>>& weights,
-                       const std::vector<std::vector<double>>& weightGradients,
-                       double learningRate) override;
+    BasicSGD();
 
-    void updateBiases(std::vector<double>& biases,
-                      const std::vector<double>& biasGradients,
-                      double learningRate) override;
+protected:
+    void apply(const std::vector<ParameterGroup>& groups, T learningRate) override;
 };
 
-#endif
\ No newline at end of file
+using SGD = BasicSGD<double>;
+
+#endif
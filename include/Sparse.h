@@ -0,0 +1,54 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "Matrix.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed sparse row kernels for pruned layers, the sparse counterparts of
+// the Gemm products a dense layer runs. Leading dimensions are row strides in
+// elements, as returned by Matrix::stride().
+namespace Sparse {
+
+    // rows x cols with the nonzeros of row r at [rowStart[r], rowStart[r + 1])
+    // of `columns` and `values`, in increasing column order.
+    template <typename T>
+    struct CsrMatrix {
+        size_t rows = 0;
+        size_t cols = 0;
+        std::vector<uint32_t> rowStart;
+        std::vector<uint32_t> columns;
+        std::vector<T> values;
+
+        size_t nonZeros() const { return values.size(); }
+    };
+
+    // The nonzeros of `dense`; an empty row still gets its rowStart entry.
+    template <typename T>
+    CsrMatrix<T> fromDense(const Matrix<T>& dense);
+
+    // Y += X * W^T, where X is M x W.cols and Y is M x W.rows: the forward
+    // pass of a layer whose sparse weights are W.
+    void multiply(size_t M, const float* X, size_t ldx, const CsrMatrix<float>& W, float* Y, size_t ldy);
+    void multiply(size_t M, const double* X, size_t ldx, const CsrMatrix<double>& W, double* Y, size_t ldy);
+
+    // G = D * W, where D is M x W.rows and G is M x W.cols: the gradients
+    // with respect to the layer's inputs. Zero rows of D, common after a relu,
+    // cost nothing.
+    void multiplyTransposed(size_t M, const float* D, size_t ldd, const CsrMatrix<float>& W,
+                            float* G, size_t ldg);
+    void multiplyTransposed(size_t M, const double* D, size_t ldd, const CsrMatrix<double>& W,
+                            double* G, size_t ldg);
+
+    // gradients[k] = scale * sum over rows i of D(i, r) * X(i, W.columns[k]),
+    // with r the row of nonzero k: the weight gradients restricted to W's
+    // pattern, laid out like W.values.
+    void gradients(size_t M, float scale, const float* D, size_t ldd, const float* X, size_t ldx,
+                   const CsrMatrix<float>& W, float* gradients);
+    void gradients(size_t M, double scale, const double* D, size_t ldd, const double* X, size_t ldx,
+                   const CsrMatrix<double>& W, double* gradients);
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef STATIC_NETWORK_H
+#define STATIC_NETWORK_H
+
+#include "NeuralNetwork.h"
+#include "ActivationFunctions.h"
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A feed-forward network whose layer sizes are template arguments, for models
+// small enough that the bookkeeping of BasicNeuralNetwork outweighs the
+// arithmetic: StaticNetwork<double, 4, 8, 3> has 4 inputs, one hidden layer
+// of 8 and 3 outputs. Weights and activations live in std::arrays, every loop
+// has a compile-time trip count the compiler can unroll, and predict never
+// allocates. The network is built from a trained BasicNeuralNetwork or a
+// saved model and is read-only afterwards, so it can serve any number of
+// threads at once.
+//
+// Unlike the rest of the library it is header-only: its instantiations depend
+// on the sizes, which only the user knows.
+template <typename Scalar, size_t... Sizes>
+class StaticNetwork {
+    static_assert(sizeof...(Sizes) >= 2, "A network needs at least input and output sizes");
+    static_assert(std::is_floating_point<Scalar>::value, "Scalar must be float or double");
+
+    static constexpr std::array<size_t, sizeof...(Sizes)> Dims = {Sizes...};
+
+public:
+    static constexpr size_t LayerCount = sizeof...(Sizes) - 1;
+    static constexpr size_t InputSize = Dims.front();
+    static constexpr size_t OutputSize = Dims.back();
+
+    using Input = std::array<Scalar, InputSize>;
+    using Output = std::array<Scalar, OutputSize>;
+
+    // Copies the weights of `network`. Throws std::invalid_argument when its
+    // layer sizes differ from Sizes, and for layers with custom activation
+    // functions or quantized layers.
+    explicit StaticNetwork(const BasicNeuralNetwork<Scalar>& network) {
+        if (network.getLayerCount() != LayerCount) {
+            throw std::invalid_argument("Network has " + std::to_string(network.getLayerCount()) +
+                                        " layers, expected " + std::to_string(LayerCount));
+        }
+        assignLayers(network, std::make_index_sequence<LayerCount>());
+    }
+
+    // See BasicNeuralNetwork::load; the mapping is released once the weights
+    // are copied.
+    static StaticNetwork load(const std::string& filename) {
+        return StaticNetwork(BasicNeuralNetwork<Scalar>::load(filename));
+    }
+
+    Output predict(const Input& input) const {
+        Output output;
+        predict(input.data(), output.data());
+        return output;
+    }
+
+    // `input` holds InputSize elements, `output` receives OutputSize.
+    void predict(const Scalar* input, Scalar* output) const {
+        forward<0>(input, output);
+    }
+
+private:
+    template <size_t In, size_t Out>
+    struct Dense {
+        // transposed, In x Out: each input scales one contiguous row, so the
+        // inner loop runs across the outputs
+        std::array<Scalar, In * Out> weights{};
+        std::array<Scalar, Out> biases{};
+        ActivationFunctions::Kind activation = ActivationFunctions::Kind::Linear;
+
+        void run(const Scalar* x, Scalar* y) const {
+            // a local accumulator, since y could alias the weights as far as
+            // the compiler knows and would be stored on every step
+            std::array<Scalar, Out> sum = biases;
+            for (size_t k = 0; k < In; ++k) {
+                const Scalar xk = x[k];
+                const Scalar* w = weights.data() + k * Out;
+                for (size_t o = 0; o < Out; ++o) sum[o] += xk * w[o];
+            }
+            for (size_t o = 0; o < Out; ++o) y[o] = sum[o];
+            switch (activation) {
+                case ActivationFunctions::Kind::Relu:
+                    for (size_t o = 0; o < Out; ++o) y[o] = y[o] > Scalar(0) ? y[o] : Scalar(0);
+                    break;
+                case ActivationFunctions::Kind::Sigmoid:
+                    ActivationFunctions::sigmoidInPlace(y, Out);
+                    break;
+                case ActivationFunctions::Kind::Softmax:
+                    ActivationFunctions::softmaxInPlace(y, Out);
+                    break;
+                case ActivationFunctions::Kind::Linear:
+                case ActivationFunctions::Kind::Custom: // rejected when assigned
+                    break;
+            }
+        }
+    };
+
+    template <size_t... I>
+    static std::tuple<Dense<Dims[I], Dims[I + 1]>...> layerTuple(std::index_sequence<I...>);
+
+    decltype(layerTuple(std::make_index_sequence<LayerCount>())) layers;
+
+    // the activations of each hidden layer stay on the stack
+    template <size_t I>
+    void forward(const Scalar* x, Scalar* output) const {
+        if constexpr (I + 1 == LayerCount) {
+            std::get<I>(layers).run(x, output);
+        } else {
+            std::array<Scalar, Dims[I + 1]> y;
+            std::get<I>(layers).run(x, y.data());
+            forward<I + 1>(y.data(), output);
+        }
+    }
+
+    template <size_t... I>
+    void assignLayers(const BasicNeuralNetwork<Scalar>& network, std::index_sequence<I...>) {
+        (assignLayer(std::get<I>(layers), network.getLayer(I), I), ...);
+    }
+
+    template <size_t In, size_t Out>
+    static void assignLayer(Dense<In, Out>& dense, const BasicLayer<Scalar>& layer, size_t index) {
+        if (static_cast<size_t>(layer.getInputSize()) != In || static_cast<size_t>(layer.getOutputSize()) != Out) {
+            throw std::invalid_argument("Layer " + std::to_string(index) + " is " +
+                                        std::to_string(layer.getInputSize()) + " -> " +
+                                        std::to_string(layer.getOutputSize()) + ", expected " +
+                                        std::to_string(In) + " -> " + std::to_string(Out));
+        }
+        if (layer.isQuantized() || layer.isSparse() ||
+            layer.getActivation() == ActivationFunctions::Kind::Custom) {
+            throw std::invalid_argument("Only layers with built-in activations and dense floating-point "
+                                        "weights can be copied into a StaticNetwork");
+        }
+        const Matrix<Scalar>& weights = layer.getWeights();
+        for (size_t o = 0; o < Out; ++o) {
+            for (size_t k = 0; k < In; ++k) {
+                dense.weights[k * Out + o] = weights(o, k);
+            }
+            dense.biases[o] = layer.getBiases()[o];
+        }
+        dense.activation = layer.getActivation();
+    }
+};
+
+#endif
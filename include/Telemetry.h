@@ -0,0 +1,130 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Training instrumentation: where the time of each epoch goes, its throughput
+// and its allocations, reported to a pluggable sink once per epoch.
+namespace Telemetry {
+
+    // Data: gathering batch rows or waiting for a pipeline. Forward, Loss and
+    // Backward are summed over the threads that trained shards of a batch;
+    // Reduce and Optimizer are wall time on the training thread.
+    enum class Phase { Data, Forward, Loss, Backward, Reduce, Optimizer };
+    constexpr size_t PhaseCount = 6;
+    const char* phaseName(Phase phase);
+
+    struct PhaseTimes {
+        std::array<double, PhaseCount> seconds{};
+        // per layer, in layer order
+        std::vector<double> layerForward;
+        std::vector<double> layerBackward;
+
+        double& operator[](Phase phase) { return seconds[static_cast<size_t>(phase)]; }
+        double operator[](Phase phase) const { return seconds[static_cast<size_t>(phase)]; }
+
+        // Sizes the per-layer entries, keeping what has been measured so far.
+        void resize(size_t layers);
+        void clear();
+        void add(const PhaseTimes& other);
+    };
+
+    struct EpochMetrics {
+        int epoch = 0;
+        // average loss per sample
+        double loss = 0.0;
+        size_t samples = 0;
+        size_t batches = 0;
+        double seconds = 0.0;
+        double samplesPerSecond = 0.0;
+        // estimated from the layer shapes: 2 * in * out per sample and layer
+        // forward, twice that backward (once less for the first layer)
+        double flops = 0.0;
+        double flopsPerSecond = 0.0;
+        // Matrix buffers allocated during the epoch
+        size_t allocations = 0;
+        PhaseTimes times;
+    };
+
+    // Receives one record per epoch. NeuralNetwork calls flush() when train()
+    // returns.
+    class Sink {
+    public:
+        virtual ~Sink() = default;
+        virtual void epoch(const EpochMetrics& metrics) = 0;
+        virtual void flush() {}
+    };
+
+    // "Epoch N, Loss: L" every `interval` epochs; the default sink.
+    class ConsoleSink : public Sink {
+    public:
+        explicit ConsoleSink(int interval = 100);
+        void epoch(const EpochMetrics& metrics) override;
+        void flush() override;
+
+    private:
+        int interval;
+    };
+
+    class CallbackSink : public Sink {
+    public:
+        explicit CallbackSink(std::function<void(const EpochMetrics&)> callback);
+        void epoch(const EpochMetrics& metrics) override;
+
+    private:
+        std::function<void(const EpochMetrics&)> callback;
+    };
+
+    // One CSV row per epoch; the header names the per-layer columns of the
+    // first record.
+    class CsvSink : public Sink {
+    public:
+        explicit CsvSink(const std::string& filename);
+        void epoch(const EpochMetrics& metrics) override;
+        void flush() override;
+
+    private:
+        std::ofstream out;
+        bool headerWritten = false;
+    };
+
+    // One JSON object per line and epoch; values that are not finite, such
+    // as a diverged loss, are written as null.
+    class JsonSink : public Sink {
+    public:
+        explicit JsonSink(const std::string& filename);
+        void epoch(const EpochMetrics& metrics) override;
+        void flush() override;
+
+    private:
+        std::ofstream out;
+    };
+
+    // Adds the time until it goes out of scope to *total; does nothing, not
+    // even read the clock, when total is nullptr.
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(double* total) : total(total) {
+            if (total) start = std::chrono::steady_clock::now();
+        }
+        ~ScopedTimer() {
+            if (total) *total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        double* total;
+        std::chrono::steady_clock::time_point start;
+    };
+
+}
+
+#endif
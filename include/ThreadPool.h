@@ -0,0 +1,48 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running indexed tasks. The calling thread takes
+// part in every parallelFor, so a pool of size N starts N - 1 threads.
+class ThreadPool {
+public:
+    // threads == 0 uses std::thread::hardware_concurrency().
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+
+    // Runs task(0) ... task(count - 1) and returns once all of them have
+    // finished. The first exception thrown by a task is rethrown here.
+    // Not reentrant: tasks must not call parallelFor on the same pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    void workerLoop();
+    // Claims and runs indices until none are left; expects `lock` to be held.
+    void runTasks(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+
+    const std::function<void(size_t)>* task = nullptr;
+    size_t nextIndex = 0;
+    size_t taskCount = 0;
+    size_t pending = 0;
+    std::exception_ptr error;
+    bool stopping = false;
+};
+
+#endif
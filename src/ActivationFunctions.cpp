@@ -2,15 +2,21 @@
 
 namespace ActivationFunctions {
 
+    Kind kindFromName(const std::string& name) {
+        if (name == "linear") return Kind::Linear;
+        if (name == "relu") return Kind::Relu;
+        if (name == "sigmoid") return Kind::Sigmoid;
+        if (name == "softmax") return Kind::Softmax;
+        return Kind::Custom;
+    }
+
     double sigmoid(double x) {
         return 1.0 / (1.0 + std::exp(-x));
     }
 
     std::vector<double> sigmoid(const std::vector<double>& x) {
-        std::vector<double> result(x.size());
-        for (size_t i = 0; i < x.size(); ++i) {
-            result[i] = sigmoid(x[i]);
-        }
+        std::vector<double> result(x);
+        sigmoidInPlace(result.data(), result.size());
         return result;
     }
 
@@ -19,32 +25,15 @@ namespace ActivationFunctions {
     }
 
     std::vector<double> relu(const std::vector<double>& x) {
-        std::vector<double> result(x.size());
-        for (size_t i = 0; i < x.size(); ++i) {
-            result[i] = relu(x[i]);
-        }
+        std::vector<double> result(x);
+        reluInPlace(result.data(), result.size());
         return result;
     }
 
     std::vector<double> softmax(const std::vector<double>& x) {
-        // subtract max for numerical stability
-        double maxVal = -std::numeric_limits<double>::infinity();
-        for (double v : x) maxVal = std::max(maxVal, v);
-        std::vector<double> expVals(x.size());
-        double sumExp = 0.0;
-        for (size_t i = 0; i < x.size(); ++i) {
-            double e = std::exp(x[i] - maxVal);
-            expVals[i] = e;
-            sumExp += e;
-        }
-        if (sumExp == 0.0) {
-            double uniform = 1.0 / std::max<size_t>(1, x.size());
-            return std::vector<double>(x.size(), uniform);
-        }
-        for (size_t i = 0; i < x.size(); ++i) {
-            expVals[i] /= sumExp;
-        }
-        return expVals;
+        std::vector<double> result(x);
+        softmaxInPlace(result.data(), result.size());
+        return result;
     }
 
     double sigmoidDerivativeFromInput(double x) {
@@ -0,0 +1,285 @@
+#include "../include/ActivationFunctions.h"
+#include "../include/CpuFeatures.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+// Array kernels behind ActivationFunctions::*InPlace. Every loop is written so
+// the compiler vectorizes it; the same bodies are compiled once per instruction
+// set and the widest variant the CPU supports is picked on first use. This file
+// is built with -fno-trapping-math so the clamps and selects become blends.
+
+namespace ActivationFunctions {
+
+    namespace {
+
+        constexpr size_t ReductionLanes = 16;
+
+        // exp(x) by range reduction x = n*ln2 + r and a Taylor polynomial on
+        // |r| <= ln2/2 (degree 12 for double, 7 for float), accurate to about one
+        // ulp. Inputs are clamped to the normal range, so very negative arguments
+        // give the smallest normal number instead of 0.
+        template <typename T> struct ExpTraits;
+
+        template <> struct ExpTraits<double> {
+            using Bits = uint64_t;
+            static constexpr double Lo = -708.0;
+            static constexpr double Hi = 709.0;
+            static constexpr double Shifter = 6755399441055744.0; // 1.5 * 2^52, rounds to integer
+            static constexpr int MantissaBits = 52;
+            static constexpr Bits Bias = 1023;
+            static constexpr int Degree = 12;
+        };
+
+        template <> struct ExpTraits<float> {
+            using Bits = uint32_t;
+            static constexpr float Lo = -87.0f;
+            static constexpr float Hi = 88.0f;
+            static constexpr float Shifter = 12582912.0f; // 1.5 * 2^23
+            static constexpr int MantissaBits = 23;
+            static constexpr Bits Bias = 127;
+            static constexpr int Degree = 7;
+        };
+
+        template <typename T>
+        inline __attribute__((always_inline)) T expApprox(T x) {
+            using Traits = ExpTraits<T>;
+            const T log2e = T(1.4426950408889634);
+            const T ln2Hi = T(6.93147180369123816490e-01);
+            const T ln2Lo = T(1.90821492927058770002e-10);
+            const T shifter = Traits::Shifter;
+            static constexpr T inverseFactorials[] = {
+                T(1.0), T(1.0), T(1.0 / 2), T(1.0 / 6), T(1.0 / 24), T(1.0 / 120), T(1.0 / 720),
+                T(1.0 / 5040), T(1.0 / 40320), T(1.0 / 362880), T(1.0 / 3628800),
+                T(1.0 / 39916800), T(1.0 / 479001600)};
+
+            x = x < Traits::Lo ? Traits::Lo : x;
+            x = x > Traits::Hi ? Traits::Hi : x;
+            const T t = x * log2e + shifter;
+            const T n = t - shifter;
+            const T r = x - n * ln2Hi - n * ln2Lo;
+
+            T p = inverseFactorials[Traits::Degree];
+            for (int k = Traits::Degree - 1; k >= 0; --k) {
+                p = p * r + inverseFactorials[k];
+            }
+
+            // the low mantissa bits of t hold n; move them into the exponent field
+            typename Traits::Bits tBits, shifterBits;
+            std::memcpy(&tBits, &t, sizeof(t));
+            std::memcpy(&shifterBits, &shifter, sizeof(shifter));
+            const typename Traits::Bits scaleBits = (tBits - shifterBits + Traits::Bias) << Traits::MantissaBits;
+            T scale;
+            std::memcpy(&scale, &scaleBits, sizeof(scale));
+            return p * scale;
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void sigmoidBody(T* x, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = T(1) / (T(1) + expApprox(-x[i]));
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void reluBody(T* x, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = x[i] > T(0) ? x[i] : T(0);
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void sigmoidDerivativeBody(T* y, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                y[i] = y[i] * (T(1) - y[i]);
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void reluDerivativeBody(T* x, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                x[i] = x[i] > T(0) ? T(1) : T(0);
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void sigmoidBackwardBody(const T* g, const T* y, T* d, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                d[i] = g[i] * y[i] * (T(1) - y[i]);
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void reluBackwardBody(const T* g, const T* y, T* d, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                d[i] = y[i] > T(0) ? g[i] : T(0);
+            }
+        }
+
+        // Reductions keep ReductionLanes partial results so they vectorize
+        // without reassociating a single accumulator.
+        template <typename T>
+        inline __attribute__((always_inline)) void softmaxBody(T* x, size_t n) {
+            if (n == 0) return;
+
+            T maxVal = -std::numeric_limits<T>::infinity();
+            size_t i = 0;
+            if (n >= ReductionLanes) {
+                T partial[ReductionLanes];
+                for (size_t j = 0; j < ReductionLanes; ++j) partial[j] = x[j];
+                for (i = ReductionLanes; i + ReductionLanes <= n; i += ReductionLanes) {
+                    for (size_t j = 0; j < ReductionLanes; ++j) {
+                        partial[j] = x[i + j] > partial[j] ? x[i + j] : partial[j];
+                    }
+                }
+                for (size_t j = 0; j < ReductionLanes; ++j) {
+                    maxVal = partial[j] > maxVal ? partial[j] : maxVal;
+                }
+            }
+            for (; i < n; ++i) maxVal = x[i] > maxVal ? x[i] : maxVal;
+
+            for (i = 0; i < n; ++i) {
+                x[i] = expApprox(x[i] - maxVal);
+            }
+
+            T sumExp = T(0);
+            i = 0;
+            if (n >= ReductionLanes) {
+                T partial[ReductionLanes] = {};
+                for (; i + ReductionLanes <= n; i += ReductionLanes) {
+                    for (size_t j = 0; j < ReductionLanes; ++j) partial[j] += x[i + j];
+                }
+                for (size_t j = 0; j < ReductionLanes; ++j) sumExp += partial[j];
+            }
+            for (; i < n; ++i) sumExp += x[i];
+
+            if (sumExp == T(0)) {
+                const T uniform = T(1) / static_cast<T>(n);
+                for (i = 0; i < n; ++i) x[i] = uniform;
+                return;
+            }
+            const T inv = T(1) / sumExp;
+            for (i = 0; i < n; ++i) {
+                x[i] *= inv;
+            }
+        }
+
+        template <typename T>
+        struct KernelTable {
+            void (*sigmoid)(T*, size_t);
+            void (*relu)(T*, size_t);
+            void (*sigmoidDerivative)(T*, size_t);
+            void (*reluDerivative)(T*, size_t);
+            void (*softmax)(T*, size_t);
+            void (*sigmoidBackward)(const T*, const T*, T*, size_t);
+            void (*reluBackward)(const T*, const T*, T*, size_t);
+        };
+
+#define ACTIVATION_KERNELS(suffix, attributes)                                                       \
+        template <typename T> attributes void sigmoid##suffix(T* x, size_t n) { sigmoidBody(x, n); } \
+        template <typename T> attributes void relu##suffix(T* x, size_t n) { reluBody(x, n); }       \
+        template <typename T> attributes void sigmoidDerivative##suffix(T* y, size_t n) {            \
+            sigmoidDerivativeBody(y, n);                                                             \
+        }                                                                                            \
+        template <typename T> attributes void reluDerivative##suffix(T* x, size_t n) {               \
+            reluDerivativeBody(x, n);                                                                \
+        }                                                                                            \
+        template <typename T> attributes void softmax##suffix(T* x, size_t n) { softmaxBody(x, n); } \
+        template <typename T>                                                                        \
+        attributes void sigmoidBackward##suffix(const T* g, const T* y, T* d, size_t n) {           \
+            sigmoidBackwardBody(g, y, d, n);                                                         \
+        }                                                                                            \
+        template <typename T>                                                                        \
+        attributes void reluBackward##suffix(const T* g, const T* y, T* d, size_t n) {              \
+            reluBackwardBody(g, y, d, n);                                                            \
+        }                                                                                            \
+        template <typename T>                                                                        \
+        const KernelTable<T> kernels##suffix = {sigmoid##suffix<T>, relu##suffix<T>,                 \
+                                                sigmoidDerivative##suffix<T>, reluDerivative##suffix<T>, \
+                                                softmax##suffix<T>, sigmoidBackward##suffix<T>,      \
+                                                reluBackward##suffix<T>};
+
+        ACTIVATION_KERNELS(Generic, )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        ACTIVATION_KERNELS(Sse4, __attribute__((target("sse4.2"))))
+        ACTIVATION_KERNELS(Avx2, __attribute__((target("avx2,fma"))))
+        ACTIVATION_KERNELS(Avx512, __attribute__((target("avx512f,avx512dq"))))
+#endif
+
+#undef ACTIVATION_KERNELS
+
+        template <typename T>
+        const KernelTable<T>& kernels() {
+            static const KernelTable<T>& table = []() -> const KernelTable<T>& {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                switch (CpuFeatures::detected()) {
+                    case CpuFeatures::SimdLevel::AVX512: return kernelsAvx512<T>;
+                    case CpuFeatures::SimdLevel::AVX2: return kernelsAvx2<T>;
+                    case CpuFeatures::SimdLevel::SSE4: return kernelsSse4<T>;
+                    default: break;
+                }
+#endif
+                return kernelsGeneric<T>;
+            }();
+            return table;
+        }
+
+    }
+
+    void sigmoidInPlace(float* x, size_t n) {
+        kernels<float>().sigmoid(x, n);
+    }
+
+    void reluInPlace(float* x, size_t n) {
+        kernels<float>().relu(x, n);
+    }
+
+    void softmaxInPlace(float* x, size_t n) {
+        kernels<float>().softmax(x, n);
+    }
+
+    void sigmoidDerivativeInPlace(float* y, size_t n) {
+        kernels<float>().sigmoidDerivative(y, n);
+    }
+
+    void reluDerivativeInPlace(float* x, size_t n) {
+        kernels<float>().reluDerivative(x, n);
+    }
+
+    void sigmoidBackward(const float* g, const float* y, float* d, size_t n) {
+        kernels<float>().sigmoidBackward(g, y, d, n);
+    }
+
+    void reluBackward(const float* g, const float* y, float* d, size_t n) {
+        kernels<float>().reluBackward(g, y, d, n);
+    }
+
+    void sigmoidInPlace(double* x, size_t n) {
+        kernels<double>().sigmoid(x, n);
+    }
+
+    void reluInPlace(double* x, size_t n) {
+        kernels<double>().relu(x, n);
+    }
+
+    void softmaxInPlace(double* x, size_t n) {
+        kernels<double>().softmax(x, n);
+    }
+
+    void sigmoidDerivativeInPlace(double* y, size_t n) {
+        kernels<double>().sigmoidDerivative(y, n);
+    }
+
+    void reluDerivativeInPlace(double* x, size_t n) {
+        kernels<double>().reluDerivative(x, n);
+    }
+
+    void sigmoidBackward(const double* g, const double* y, double* d, size_t n) {
+        kernels<double>().sigmoidBackward(g, y, d, n);
+    }
+
+    void reluBackward(const double* g, const double* y, double* d, size_t n) {
+        kernels<double>().reluBackward(g, y, d, n);
+    }
+
+}
@@ -0,0 +1,129 @@
+#include "../include/BFloat16.h"
+#include "../include/CpuFeatures.h"
+#include <cstdint>
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+// Array kernels behind Precision::convert. As with the activation kernels, the
+// loops are written to vectorize, compiled once per instruction set and the
+// widest variant the CPU supports is picked on first use. With AVX512-BF16
+// narrowing is a single instruction per 16 floats.
+
+namespace Precision {
+
+    namespace {
+
+        // BFloat16::round with selects instead of branches
+        template <typename T>
+        inline __attribute__((always_inline)) void narrowBody(const T* x, BFloat16* y, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const float value = static_cast<float>(x[i]);
+                uint32_t u;
+                std::memcpy(&u, &value, sizeof(u));
+                const uint32_t magnitude = u & 0x7fffffffu;
+                const uint32_t rounded = (u + 0x7fffu + ((u >> 16) & 1u)) >> 16;
+                const uint32_t nan = (u >> 16) | 0x40u;
+                const uint32_t zero = (u >> 16) & 0x8000u;
+                const uint32_t bits = magnitude > 0x7f800000u ? nan : magnitude < 0x00800000u ? zero : rounded;
+                y[i].bits = static_cast<uint16_t>(bits);
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void widenBody(const BFloat16* x, T* y, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const uint32_t wide = static_cast<uint32_t>(x[i].bits) << 16;
+                float value;
+                std::memcpy(&value, &wide, sizeof(value));
+                y[i] = static_cast<T>(value);
+            }
+        }
+
+        template <typename T>
+        struct KernelTable {
+            void (*narrow)(const T*, BFloat16*, size_t);
+            void (*widen)(const BFloat16*, T*, size_t);
+        };
+
+#define PRECISION_KERNELS(suffix, attributes)                                               \
+        template <typename T>                                                               \
+        attributes void narrow##suffix(const T* x, BFloat16* y, size_t n) {                 \
+            narrowBody(x, y, n);                                                            \
+        }                                                                                   \
+        template <typename T>                                                               \
+        attributes void widen##suffix(const BFloat16* x, T* y, size_t n) {                  \
+            widenBody(x, y, n);                                                             \
+        }                                                                                   \
+        template <typename T>                                                               \
+        const KernelTable<T> kernels##suffix = {narrow##suffix<T>, widen##suffix<T>};
+
+        PRECISION_KERNELS(Generic, )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        PRECISION_KERNELS(Avx2, __attribute__((target("avx2"))))
+        PRECISION_KERNELS(Avx512, __attribute__((target("avx512f,avx512bw"))))
+
+        __attribute__((target("avx512f,avx512bf16")))
+        void narrowAvx512Bf16(const float* x, BFloat16* y, size_t n) {
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                const __m256bh packed = _mm512_cvtneps_pbh(_mm512_loadu_ps(x + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(y + i), reinterpret_cast<const __m256i&>(packed));
+            }
+            narrowBody(x + i, y + i, n - i);
+        }
+
+        const KernelTable<float> kernelsAvx512Bf16 = {narrowAvx512Bf16, widenAvx512<float>};
+#endif
+
+#undef PRECISION_KERNELS
+
+        template <typename T>
+        const KernelTable<T>& selectKernels() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            switch (CpuFeatures::detected()) {
+                case CpuFeatures::SimdLevel::AVX512: return kernelsAvx512<T>;
+                case CpuFeatures::SimdLevel::AVX2: return kernelsAvx2<T>;
+                default: break;
+            }
+#endif
+            return kernelsGeneric<T>;
+        }
+
+        template <typename T>
+        const KernelTable<T>& kernels() {
+            static const KernelTable<T>& table = selectKernels<T>();
+            return table;
+        }
+
+        template <>
+        const KernelTable<float>& kernels<float>() {
+            static const KernelTable<float>& table = []() -> const KernelTable<float>& {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                if (CpuFeatures::hasBf16()) return kernelsAvx512Bf16;
+#endif
+                return selectKernels<float>();
+            }();
+            return table;
+        }
+
+    }
+
+    void convert(const float* x, BFloat16* y, size_t n) {
+        kernels<float>().narrow(x, y, n);
+    }
+
+    void convert(const double* x, BFloat16* y, size_t n) {
+        kernels<double>().narrow(x, y, n);
+    }
+
+    void convert(const BFloat16* x, float* y, size_t n) {
+        kernels<float>().widen(x, y, n);
+    }
+
+    void convert(const BFloat16* x, double* y, size_t n) {
+        kernels<double>().widen(x, y, n);
+    }
+
+}
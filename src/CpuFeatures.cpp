@@ -0,0 +1,71 @@
+#include "../include/CpuFeatures.h"
+
+namespace CpuFeatures {
+
+    namespace {
+
+        SimdLevel query() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+                return SimdLevel::AVX512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return SimdLevel::AVX2;
+            }
+            if (__builtin_cpu_supports("sse4.2")) {
+                return SimdLevel::SSE4;
+            }
+#endif
+            return SimdLevel::Scalar;
+        }
+
+        bool queryVnni() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            switch (detected()) {
+                case SimdLevel::AVX512:
+                    return __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+                case SimdLevel::AVX2:
+                    return __builtin_cpu_supports("avxvnni");
+                default:
+                    break;
+            }
+#endif
+            return false;
+        }
+
+        bool queryBf16() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            return detected() == SimdLevel::AVX512 && __builtin_cpu_supports("avx512bf16");
+#else
+            return false;
+#endif
+        }
+
+    }
+
+    SimdLevel detected() {
+        static const SimdLevel level = query();
+        return level;
+    }
+
+    bool hasVnni() {
+        static const bool vnni = queryVnni();
+        return vnni;
+    }
+
+    bool hasBf16() {
+        static const bool bf16 = queryBf16();
+        return bf16;
+    }
+
+    const char* name(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::AVX512: return "avx512";
+            case SimdLevel::AVX2: return "avx2";
+            case SimdLevel::SSE4: return "sse4";
+            default: return "scalar";
+        }
+    }
+
+}
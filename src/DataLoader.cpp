@@ -1,6 +1,14 @@
 #include "../include/DataLoader.h"
+#include "../include/MappedFile.h"
+#include "../include/ThreadPool.h"
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
 #include <random>
+#include <numeric>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -39,90 +47,204 @@ bool DataLoader::downloadIrisDataset(const std::string& filename) {
     return true;
 }
 
-DataLoader::Dataset DataLoader::loadIrisDataset() {
-    return loadIrisFromCSV("data/iris.csv");
+template <typename T>
+DataLoader::BasicDataset<T> DataLoader::loadIrisDataset() {
+    return loadIrisFromCSV<T>("data/iris.csv");
 }
 
-DataLoader::Dataset DataLoader::loadIrisFromCSV(const std::string& filename) {
-    Dataset dataset;
-    std::ifstream file(filename);
-    
-    if (!file.is_open()) {
+template <typename T>
+DataLoader::BasicDataset<T> DataLoader::loadIrisFromCSV(const std::string& filename) {
+    if (!std::ifstream(filename).is_open()) {
         std::cout << "CSV file not found. Attempting to download from UCI ML Repository..." << std::endl;
         if (!downloadIrisDataset(filename)) {
             throw std::runtime_error("Could not download or find Iris dataset file: " + filename);
         }
-        
-        file.open(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Could not open downloaded Iris dataset file: " + filename);
-        }
     }
-    
-    std::set<std::string> uniqueSpecies;
-    std::vector<std::string> allSpecies; 
-    std::string line;
-    
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::vector<double> features;
-        std::string species;
-        
-        std::stringstream ss(line);
-        std::string cell;
-        
-        // first 4 features
-        for (int i = 0; i < 4; ++i) {
-            if (std::getline(ss, cell, ',')) {
-                try {
-                    features.push_back(std::stod(cell));
-                } catch (const std::exception& e) {
-                    std::cerr << "Error parsing feature " << i << " in line: " << line << std::endl;
-                    continue;
+
+    CsvSpec spec;
+    spec.featureColumns = {0, 1, 2, 3};
+    spec.labelColumn = 4;
+    BasicDataset<T> dataset = loadCSV<T>(filename, spec);
+    dataset.featureNames = {"sepal_length", "sepal_width", "petal_length", "petal_width"};
+    return dataset;
+}
+
+namespace {
+
+    std::string_view trim(std::string_view field, const char* characters) {
+        const size_t first = field.find_first_not_of(characters);
+        if (first == std::string_view::npos) return {};
+        return field.substr(first, field.find_last_not_of(characters) - first + 1);
+    }
+
+    // Rows of one newline-aligned chunk, with labels numbered in order of first
+    // appearance within the chunk.
+    template <typename T>
+    struct CsvChunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::vector<T> features;
+        std::vector<uint32_t> labels;
+        std::unordered_map<std::string_view, uint32_t> labelIds;
+        std::vector<std::string_view> labelNames;
+        size_t skipped = 0;
+        size_t firstRow = 0;
+    };
+
+    // columnRoles[c]: feature slot of column c, LabelRole, or IgnoredRole
+    constexpr int LabelRole = -1;
+    constexpr int IgnoredRole = -2;
+
+    template <typename T>
+    void parseCsvChunk(CsvChunk<T>& chunk, const std::vector<int>& columnRoles,
+                       size_t featureCount, char delimiter) {
+        std::vector<T> row(featureCount);
+        const char* line = chunk.begin;
+        while (line < chunk.end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+            if (!lineEnd) lineEnd = chunk.end;
+
+            size_t parsed = 0;
+            bool valid = true;
+            std::string_view label;
+            bool hasLabel = false;
+            size_t column = 0;
+            const char* field = line;
+            while (valid && field <= lineEnd && column < columnRoles.size()) {
+                const char* fieldEnd = static_cast<const char*>(std::memchr(field, delimiter, lineEnd - field));
+                if (!fieldEnd) fieldEnd = lineEnd;
+                const int role = columnRoles[column];
+                if (role == LabelRole) {
+                    label = trim(std::string_view(field, fieldEnd - field), " \t\r\"'");
+                    hasLabel = !label.empty();
+                } else if (role >= 0) {
+                    std::string_view text = trim(std::string_view(field, fieldEnd - field), " \t\r");
+                    // std::stod took an explicit plus sign; from_chars does not
+                    if (text.size() > 1 && text[0] == '+' && text[1] != '+' && text[1] != '-') {
+                        text.remove_prefix(1);
+                    }
+                    auto result = std::from_chars(text.data(), text.data() + text.size(), row[role]);
+                    valid = result.ec == std::errc() && result.ptr == text.data() + text.size();
+                    ++parsed;
                 }
+                field = fieldEnd + 1;
+                ++column;
             }
-        }
-        
-        // species
-        if (std::getline(ss, species, ',')) {
-            species.erase(species.find_last_not_of(" \t\r\n\"'") + 1);
-            species.erase(0, species.find_first_not_of(" \t\r\n\"'"));
-            
-            if (features.size() == 4) {
-                dataset.inputs.push_back(features);
-                allSpecies.push_back(species);
-                uniqueSpecies.insert(species);
+
+            const bool blank = trim(std::string_view(line, lineEnd - line), " \t\r").empty();
+            if (!blank) {
+                if (valid && hasLabel && parsed == featureCount) {
+                    chunk.features.insert(chunk.features.end(), row.begin(), row.end());
+                    auto inserted = chunk.labelIds.emplace(label, static_cast<uint32_t>(chunk.labelNames.size()));
+                    if (inserted.second) chunk.labelNames.push_back(label);
+                    chunk.labels.push_back(inserted.first->second);
+                } else {
+                    ++chunk.skipped;
+                }
             }
+            line = lineEnd + 1;
         }
     }
-    
-    file.close();
-    
-    if (dataset.inputs.empty()) {
+
+}
+
+template <typename T>
+DataLoader::BasicDataset<T> DataLoader::loadCSV(const std::string& filename, const CsvSpec& spec) {
+    if (spec.featureColumns.empty()) {
+        throw std::invalid_argument("CSV spec needs at least one feature column");
+    }
+    size_t columnCount = spec.labelColumn + 1;
+    for (size_t column : spec.featureColumns) {
+        columnCount = std::max(columnCount, column + 1);
+    }
+    std::vector<int> columnRoles(columnCount, IgnoredRole);
+    columnRoles[spec.labelColumn] = LabelRole;
+    for (size_t slot = 0; slot < spec.featureColumns.size(); ++slot) {
+        if (columnRoles[spec.featureColumns[slot]] != IgnoredRole) {
+            throw std::invalid_argument("CSV spec uses a column twice");
+        }
+        columnRoles[spec.featureColumns[slot]] = static_cast<int>(slot);
+    }
+    const size_t featureCount = spec.featureColumns.size();
+
+    std::shared_ptr<MappedFile> file = MappedFile::open(filename);
+    const char* begin = file->data();
+    const char* end = begin + file->size();
+
+    BasicDataset<T> dataset;
+    if (spec.hasHeader && begin < end) {
+        const char* headerEnd = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        if (!headerEnd) headerEnd = end;
+        std::vector<std::string> names;
+        std::string_view header(begin, headerEnd - begin);
+        for (size_t start = 0; start <= header.size();) {
+            size_t stop = std::min(header.find(spec.delimiter, start), header.size());
+            names.emplace_back(trim(header.substr(start, stop - start), " \t\r\"'"));
+            start = stop + 1;
+        }
+        for (size_t column : spec.featureColumns) {
+            dataset.featureNames.push_back(column < names.size() ? names[column] : std::string());
+        }
+        begin = std::min(headerEnd + 1, end);
+    }
+
+    // about 64 KiB per chunk, split on line boundaries
+    ThreadPool pool(spec.threads);
+    const size_t bytes = end - begin;
+    const size_t chunkCount = std::max<size_t>(1, std::min(pool.size() * 4, bytes >> 16));
+    std::vector<CsvChunk<T>> chunks(chunkCount);
+    const char* cursor = begin;
+    for (size_t c = 0; c < chunkCount; ++c) {
+        const char* stop = c + 1 == chunkCount ? end : std::max(cursor, begin + bytes * (c + 1) / chunkCount);
+        if (stop < end) {
+            const char* newline = static_cast<const char*>(std::memchr(stop, '\n', end - stop));
+            stop = newline ? newline + 1 : end;
+        }
+        chunks[c].begin = cursor;
+        chunks[c].end = stop;
+        cursor = stop;
+    }
+    pool.parallelFor(chunkCount, [&](size_t c) {
+        parseCsvChunk(chunks[c], columnRoles, featureCount, spec.delimiter);
+    });
+
+    // class ids follow the sorted class names, whatever chunk saw them first
+    std::vector<std::string_view> classNames;
+    size_t rows = 0, skipped = 0;
+    for (CsvChunk<T>& chunk : chunks) {
+        chunk.firstRow = rows;
+        rows += chunk.labels.size();
+        skipped += chunk.skipped;
+        classNames.insert(classNames.end(), chunk.labelNames.begin(), chunk.labelNames.end());
+    }
+    std::sort(classNames.begin(), classNames.end());
+    classNames.erase(std::unique(classNames.begin(), classNames.end()), classNames.end());
+    if (rows == 0) {
         throw std::runtime_error("No data loaded from file: " + filename);
     }
-    
-    std::vector<std::string> speciesVector(uniqueSpecies.begin(), uniqueSpecies.end());
-    std::sort(speciesVector.begin(), speciesVector.end());
-    
-    dataset.featureNames = {"sepal_length", "sepal_width", "petal_length", "petal_width"};
-    dataset.classNames = speciesVector; 
-    
-    dataset.targets.reserve(allSpecies.size());
-    for (const auto& species : allSpecies) {
-        std::vector<double> target(speciesVector.size(), 0.0);
-        auto it = std::find(speciesVector.begin(), speciesVector.end(), species);
-        if (it != speciesVector.end()) {
-            size_t classIndex = std::distance(speciesVector.begin(), it);
-            target[classIndex] = 1.0;
-            dataset.targets.push_back(target);
-        } else {
-            std::cerr << "Unknown species during encoding: " << species << std::endl;
+
+    dataset.inputs.resize(rows, featureCount);
+    dataset.targets.resize(rows, classNames.size(), T(0));
+    pool.parallelFor(chunkCount, [&](size_t c) {
+        const CsvChunk<T>& chunk = chunks[c];
+        std::vector<uint32_t> classIds(chunk.labelNames.size());
+        for (size_t id = 0; id < classIds.size(); ++id) {
+            classIds[id] = static_cast<uint32_t>(
+                std::lower_bound(classNames.begin(), classNames.end(), chunk.labelNames[id]) - classNames.begin());
+        }
+        for (size_t r = 0; r < chunk.labels.size(); ++r) {
+            const size_t row = chunk.firstRow + r;
+            std::copy(chunk.features.begin() + r * featureCount, chunk.features.begin() + (r + 1) * featureCount,
+                      dataset.inputs.rowData(row));
+            dataset.targets(row, classIds[chunk.labels[r]]) = T(1);
         }
+    });
+    dataset.classNames.assign(classNames.begin(), classNames.end());
+
+    if (skipped > 0) {
+        std::cerr << "Skipped " << skipped << " malformed rows in " << filename << std::endl;
     }
-    
-    std::cout << "Loaded " << dataset.inputs.size() << " samples from " << filename << std::endl;
+    std::cout << "Loaded " << dataset.inputs.rows() << " samples from " << filename << std::endl;
     std::cout << "Discovered " << dataset.classNames.size() << " classes: ";
     for (size_t i = 0; i < dataset.classNames.size(); ++i) {
         std::cout << dataset.classNames[i] << (i < dataset.classNames.size() - 1 ? ", " : "");
@@ -131,33 +253,241 @@ DataLoader::Dataset DataLoader::loadIrisFromCSV(const std::string& filename) {
     return dataset;
 }
 
-void DataLoader::normalizeFeatures(std::vector<std::vector<double>>& data) {
+namespace {
+
+    // Dataset file layout (host byte order):
+    //   DatasetHeader | names: featureCount + classCount entries, each a uint32
+    //   length and its bytes | 64-byte aligned: inputs (rows * padded stride)
+    //   | uint32 labels[rows]
+    constexpr char DatasetMagic[8] = {'N', 'N', 'D', 'A', 'T', 'A', '\0', '\0'};
+    constexpr uint32_t DatasetVersion = 1;
+    constexpr uint64_t DatasetAlignment = 64;
+
+    struct DatasetHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalarBytes;
+        uint64_t rows;
+        uint64_t featureCount;
+        uint64_t classCount;
+        uint64_t stride;
+        uint64_t inputsOffset;
+        uint64_t labelsOffset;
+        uint64_t fileSize;
+    };
+
+}
+
+template <typename T>
+void DataLoader::saveDataset(const BasicDataset<T>& dataset, const std::string& filename) {
+    if (dataset.inputs.rows() != dataset.targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples");
+    }
+    if (!dataset.featureNames.empty() && dataset.featureNames.size() != dataset.inputs.cols()) {
+        throw std::invalid_argument("Expected one feature name per input column");
+    }
+    if (dataset.targets.cols() == 0 && dataset.targets.rows() > 0) {
+        throw std::invalid_argument("Dataset files need one-hot class targets");
+    }
+    const size_t classCount = std::max(dataset.targets.cols(), dataset.classNames.size());
+
+    std::string names;
+    auto appendName = [&names](const std::string& name) {
+        const uint32_t length = static_cast<uint32_t>(name.size());
+        names.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        names.append(name);
+    };
+    for (size_t i = 0; i < dataset.inputs.cols(); ++i) {
+        appendName(i < dataset.featureNames.size() ? dataset.featureNames[i] : std::string());
+    }
+    for (size_t i = 0; i < classCount; ++i) {
+        appendName(i < dataset.classNames.size() ? dataset.classNames[i] : std::string());
+    }
+
+    DatasetHeader header = {};
+    std::memcpy(header.magic, DatasetMagic, sizeof(DatasetMagic));
+    header.version = DatasetVersion;
+    header.scalarBytes = sizeof(T);
+    header.rows = dataset.inputs.rows();
+    header.featureCount = dataset.inputs.cols();
+    header.classCount = classCount;
+    header.stride = Matrix<T>::paddedStride(dataset.inputs.cols());
+    header.inputsOffset = (sizeof(header) + names.size() + DatasetAlignment - 1) / DatasetAlignment * DatasetAlignment;
+    header.labelsOffset = header.inputsOffset + header.rows * header.stride * sizeof(T);
+    header.fileSize = header.labelsOffset + header.rows * sizeof(uint32_t);
+
+    std::vector<uint32_t> labels(dataset.targets.rows());
+    for (size_t r = 0; r < labels.size(); ++r) {
+        const T* target = dataset.targets.rowData(r);
+        labels[r] = static_cast<uint32_t>(std::max_element(target, target + dataset.targets.cols()) - target);
+    }
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open " + filename + " for writing");
+    }
+    const std::string padding(header.inputsOffset - sizeof(header) - names.size(), '\0');
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+    out.write(reinterpret_cast<const char*>(dataset.inputs.data()),
+              static_cast<std::streamsize>(dataset.inputs.capacity() * sizeof(T)));
+    out.write(reinterpret_cast<const char*>(labels.data()),
+              static_cast<std::streamsize>(labels.size() * sizeof(uint32_t)));
+    if (!out.flush()) {
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+template <typename T>
+DataLoader::BasicMappedDataset<T> DataLoader::mapDataset(const std::string& filename) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(filename);
+    auto invalid = [&](const std::string& reason) {
+        return std::runtime_error("Invalid dataset file " + filename + ": " + reason);
+    };
+    auto inFile = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= file->size() && bytes <= file->size() - offset;
+    };
+
+    DatasetHeader header;
+    if (!inFile(0, sizeof(header))) throw invalid("truncated header");
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, DatasetMagic, sizeof(DatasetMagic)) != 0) throw invalid("bad magic");
+    if (header.version != DatasetVersion) throw invalid("unsupported version " + std::to_string(header.version));
+    if (header.scalarBytes != sizeof(T)) throw invalid("saved with a different scalar type");
+    if (header.fileSize != file->size()) throw invalid("truncated file");
+    if (header.stride != Matrix<T>::paddedStride(header.featureCount)) throw invalid("unexpected row stride");
+    if (header.inputsOffset % DatasetAlignment != 0 || header.labelsOffset % alignof(uint32_t) != 0 ||
+        header.rows > file->size() / sizeof(uint32_t) ||
+        !inFile(header.inputsOffset, header.rows * header.stride * sizeof(T)) ||
+        !inFile(header.labelsOffset, header.rows * sizeof(uint32_t))) {
+        throw invalid("data out of bounds");
+    }
+
+    BasicMappedDataset<T> dataset;
+    uint64_t offset = sizeof(header);
+    auto readName = [&]() {
+        uint32_t length;
+        if (!inFile(offset, sizeof(length))) throw invalid("truncated names");
+        std::memcpy(&length, file->data() + offset, sizeof(length));
+        offset += sizeof(length);
+        if (!inFile(offset, length)) throw invalid("truncated names");
+        std::string name(file->data() + offset, length);
+        offset += length;
+        return name;
+    };
+    for (uint64_t i = 0; i < header.featureCount; ++i) {
+        dataset.featureNameList.push_back(readName());
+    }
+    for (uint64_t i = 0; i < header.classCount; ++i) {
+        dataset.classNameList.push_back(readName());
+    }
+
+    dataset.labelData = reinterpret_cast<const uint32_t*>(file->data() + header.labelsOffset);
+    for (uint64_t r = 0; r < header.rows; ++r) {
+        if (dataset.labelData[r] >= header.classCount) throw invalid("label out of range");
+    }
+    dataset.inputView = Matrix<T>::adopt(reinterpret_cast<T*>(file->data() + header.inputsOffset),
+                                         header.rows, header.featureCount, file);
+    dataset.file = std::move(file);
+    return dataset;
+}
+
+template <typename T>
+void DataLoader::convertCSV(const std::string& csvFilename, const CsvSpec& spec,
+                            const std::string& datasetFilename) {
+    saveDataset(loadCSV<T>(csvFilename, spec), datasetFilename);
+}
+
+template <typename T>
+size_t DataLoader::BasicMappedDataset<T>::rows() const {
+    return inputView.rows();
+}
+
+template <typename T>
+size_t DataLoader::BasicMappedDataset<T>::featureCount() const {
+    return featureNameList.size();
+}
+
+template <typename T>
+size_t DataLoader::BasicMappedDataset<T>::classCount() const {
+    return classNameList.size();
+}
+
+template <typename T>
+const Matrix<T>& DataLoader::BasicMappedDataset<T>::inputs() const {
+    return inputView;
+}
+
+template <typename T>
+Span<const uint32_t> DataLoader::BasicMappedDataset<T>::labels() const {
+    return Span<const uint32_t>(labelData, rows());
+}
+
+template <typename T>
+Span<const T> DataLoader::BasicMappedDataset<T>::row(size_t i) const {
+    return inputView[i];
+}
+
+template <typename T>
+Matrix<T> DataLoader::BasicMappedDataset<T>::batch(size_t first, size_t count) const {
+    if (first > rows() || count > rows() - first) {
+        throw std::out_of_range("Batch exceeds the dataset");
+    }
+    return Matrix<T>::adopt(const_cast<T*>(inputView.rowData(first)), count, featureCount(), file);
+}
+
+template <typename T>
+Matrix<T> DataLoader::BasicMappedDataset<T>::targets(size_t first, size_t count) const {
+    if (first > rows() || count > rows() - first) {
+        throw std::out_of_range("Batch exceeds the dataset");
+    }
+    Matrix<T> encoded(count, classCount(), T(0));
+    for (size_t i = 0; i < count; ++i) {
+        encoded(i, labelData[first + i]) = T(1);
+    }
+    return encoded;
+}
+
+template <typename T>
+DataLoader::BasicDataset<T> DataLoader::BasicMappedDataset<T>::toDataset() const {
+    BasicDataset<T> dataset;
+    dataset.inputs = batch(0, rows());
+    dataset.targets = targets(0, rows());
+    dataset.featureNames = featureNameList;
+    dataset.classNames = classNameList;
+    return dataset;
+}
+
+template <typename T>
+const std::vector<std::string>& DataLoader::BasicMappedDataset<T>::featureNames() const {
+    return featureNameList;
+}
+
+template <typename T>
+const std::vector<std::string>& DataLoader::BasicMappedDataset<T>::classNames() const {
+    return classNameList;
+}
+
+template <typename T>
+void DataLoader::normalizeFeatures(Matrix<T>& data) {
     if (data.empty()) return;
     
     std::vector<double> mean = computeMean(data);
     std::vector<double> std = computeStd(data, mean);
     
-    for (auto& sample : data) {
-        for (size_t i = 0; i < sample.size(); ++i) {
+    for (size_t row = 0; row < data.rows(); ++row) {
+        T* sample = data.rowData(row);
+        for (size_t i = 0; i < data.cols(); ++i) {
             if (std[i] > 1e-8) { // Avoid dividing by zero
-                sample[i] = (sample[i] - mean[i]) / std[i];
+                sample[i] = static_cast<T>((sample[i] - mean[i]) / std[i]);
             }
         }
     }
 }
 
-void DataLoader::trainTestSplit(const Dataset& dataset, Dataset& trainSet, Dataset& testSet, double testRatio, unsigned int seed) {
-    if (dataset.inputs.empty()) {
-        throw std::invalid_argument("Dataset cannot be empty");
-    }
-    if (dataset.inputs.size() != dataset.targets.size()) {
-        throw std::invalid_argument("Inputs and targets must have the same number of samples");
-    }
-    size_t totalSamples = dataset.inputs.size();
-    size_t testSize = static_cast<size_t>(totalSamples * testRatio);
-    size_t trainSize = totalSamples - testSize;
-    
-    std::vector<size_t> indices(totalSamples);
+std::vector<size_t> DataLoader::shuffledIndices(size_t samples, unsigned int seed) {
+    std::vector<size_t> indices(samples);
     std::iota(indices.begin(), indices.end(), 0);
     
     std::mt19937 g;
@@ -168,40 +498,152 @@ void DataLoader::trainTestSplit(const Dataset& dataset, Dataset& trainSet, Datas
         g.seed(seed);
     }
     std::shuffle(indices.begin(), indices.end(), g);
-    
-    trainSet.inputs.clear();
-    trainSet.targets.clear();
-    testSet.inputs.clear();
-    testSet.targets.clear();
-    
-    trainSet.featureNames = dataset.featureNames;
-    trainSet.classNames = dataset.classNames;
-    testSet.featureNames = dataset.featureNames;
-    testSet.classNames = dataset.classNames;
-
-    trainSet.inputs.reserve(trainSize);
-    trainSet.targets.reserve(trainSize);
-    testSet.inputs.reserve(testSize);
-    testSet.targets.reserve(testSize);
-    
-    for (size_t i = 0; i < trainSize; ++i) {
-        trainSet.inputs.push_back(dataset.inputs[indices[i]]);
-        trainSet.targets.push_back(dataset.targets[indices[i]]);
+    return indices;
+}
+
+template <typename T>
+std::vector<std::vector<size_t>> DataLoader::rowsByClass(const BasicDataset<T>& dataset) {
+    if (dataset.inputs.rows() != dataset.targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples");
     }
-    
-    for (size_t i = trainSize; i < totalSamples; ++i) {
-        testSet.inputs.push_back(dataset.inputs[indices[i]]);
-        testSet.targets.push_back(dataset.targets[indices[i]]);
+    std::vector<std::vector<size_t>> classes(std::max<size_t>(1, dataset.targets.cols()));
+    for (size_t row = 0; row < dataset.targets.rows(); ++row) {
+        const T* target = dataset.targets.rowData(row);
+        classes[std::max_element(target, target + dataset.targets.cols()) - target].push_back(row);
+    }
+    return classes;
+}
+
+namespace {
+
+    void checkRatios(double trainRatio, double validationRatio, double testRatio) {
+        if (trainRatio < 0 || validationRatio < 0 || testRatio < 0) {
+            throw std::invalid_argument("All ratios must be non-negative");
+        }
+        if (std::abs(trainRatio + validationRatio + testRatio - 1.0) > 1e-6) {
+            throw std::invalid_argument("Train, validation, and test ratios must sum to 1.0");
+        }
+    }
+
+    // Appends the shuffled `rows` to the three parts of `split` by ratio.
+    void cutByRatio(const std::vector<size_t>& rows, double trainRatio, double validationRatio,
+                    DataLoader::Split& split) {
+        const size_t trainSize = static_cast<size_t>(rows.size() * trainRatio);
+        const size_t validationEnd = trainSize + static_cast<size_t>(rows.size() * validationRatio);
+        split.train.insert(split.train.end(), rows.begin(), rows.begin() + trainSize);
+        split.validation.insert(split.validation.end(), rows.begin() + trainSize, rows.begin() + validationEnd);
+        split.test.insert(split.test.end(), rows.begin() + validationEnd, rows.end());
+    }
+
+    // Fold i of a kFold: rows of `folds[i]` validate, all others train.
+    std::vector<DataLoader::Split> assembleFolds(const std::vector<std::vector<size_t>>& folds) {
+        std::vector<DataLoader::Split> splits(folds.size());
+        for (size_t i = 0; i < folds.size(); ++i) {
+            splits[i].validation = folds[i];
+            for (size_t j = 0; j < folds.size(); ++j) {
+                if (j != i) splits[i].train.insert(splits[i].train.end(), folds[j].begin(), folds[j].end());
+            }
+        }
+        return splits;
+    }
+
+}
+
+DataLoader::Split DataLoader::splitIndices(size_t samples, double trainRatio, double validationRatio,
+                                           double testRatio, unsigned int seed) {
+    checkRatios(trainRatio, validationRatio, testRatio);
+    Split split;
+    cutByRatio(shuffledIndices(samples, seed), trainRatio, validationRatio, split);
+    return split;
+}
+
+template <typename T>
+DataLoader::Split DataLoader::stratifiedSplit(const BasicDataset<T>& dataset, double trainRatio,
+                                              double validationRatio, double testRatio,
+                                              unsigned int seed) {
+    checkRatios(trainRatio, validationRatio, testRatio);
+    std::mt19937 g(seed == 0 ? std::random_device()() : seed);
+    Split split;
+    for (std::vector<size_t>& rows : rowsByClass(dataset)) {
+        std::shuffle(rows.begin(), rows.end(), g);
+        cutByRatio(rows, trainRatio, validationRatio, split);
+    }
+    // interleave the classes again; train() visits rows in the given order
+    std::shuffle(split.train.begin(), split.train.end(), g);
+    std::shuffle(split.validation.begin(), split.validation.end(), g);
+    std::shuffle(split.test.begin(), split.test.end(), g);
+    return split;
+}
+
+std::vector<DataLoader::Split> DataLoader::kFold(size_t samples, size_t k, unsigned int seed) {
+    if (k < 2 || k > samples) {
+        throw std::invalid_argument("k-fold needs 2 <= k <= number of samples");
+    }
+    std::vector<size_t> indices = shuffledIndices(samples, seed);
+    std::vector<std::vector<size_t>> folds(k);
+    for (size_t i = 0; i < k; ++i) {
+        folds[i].assign(indices.begin() + samples * i / k, indices.begin() + samples * (i + 1) / k);
+    }
+    return assembleFolds(folds);
+}
+
+template <typename T>
+std::vector<DataLoader::Split> DataLoader::stratifiedKFold(const BasicDataset<T>& dataset, size_t k,
+                                                           unsigned int seed) {
+    if (k < 2 || k > dataset.inputs.rows()) {
+        throw std::invalid_argument("k-fold needs 2 <= k <= number of samples");
     }
+    std::mt19937 g(seed == 0 ? std::random_device()() : seed);
+    std::vector<std::vector<size_t>> folds(k);
+    size_t next = 0;
+    for (std::vector<size_t>& rows : rowsByClass(dataset)) {
+        std::shuffle(rows.begin(), rows.end(), g);
+        // continue the round robin across classes so the fold sizes stay even
+        for (size_t row : rows) {
+            folds[next++ % k].push_back(row);
+        }
+    }
+    for (std::vector<size_t>& fold : folds) {
+        std::shuffle(fold.begin(), fold.end(), g);
+    }
+    return assembleFolds(folds);
+}
+
+template <typename T>
+DataLoader::BasicDataset<T> DataLoader::subset(const BasicDataset<T>& dataset, const std::vector<size_t>& rows) {
+    BasicDataset<T> part;
+    part.featureNames = dataset.featureNames;
+    part.classNames = dataset.classNames;
+    part.inputs.assignRows(dataset.inputs, rows.data(), rows.size());
+    part.targets.assignRows(dataset.targets, rows.data(), rows.size());
+    return part;
+}
+
+template <typename T>
+void DataLoader::trainTestSplit(const BasicDataset<T>& dataset, BasicDataset<T>& trainSet, BasicDataset<T>& testSet, double testRatio, unsigned int seed) {
+    if (dataset.inputs.empty()) {
+        throw std::invalid_argument("Dataset cannot be empty");
+    }
+    if (dataset.inputs.rows() != dataset.targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples");
+    }
+    size_t totalSamples = dataset.inputs.rows();
+    size_t testSize = static_cast<size_t>(totalSamples * testRatio);
+    size_t trainSize = totalSamples - testSize;
+    
+    std::vector<size_t> indices = shuffledIndices(totalSamples, seed);
+    trainSet = subset(dataset, std::vector<size_t>(indices.begin(), indices.begin() + trainSize));
+    testSet = subset(dataset, std::vector<size_t>(indices.begin() + trainSize, indices.end()));
     
-    std::cout << "Train/Test split: " << trainSet.inputs.size() << " train samples, " 
-              << testSet.inputs.size() << " test samples" << std::endl;
+    std::cout << "Train/Test split: " << trainSet.inputs.rows() << " train samples, " 
+              << testSet.inputs.rows() << " test samples" << std::endl;
 }
 
-void DataLoader::trainValidationTestSplit(const Dataset& dataset,
-                                         Dataset& trainSet,
-                                         Dataset& validationSet,
-                                         Dataset& testSet,
+template <typename T>
+void DataLoader::trainValidationTestSplit(const BasicDataset<T>& dataset,
+                                         BasicDataset<T>& trainSet,
+                                         BasicDataset<T>& validationSet,
+                                         BasicDataset<T>& testSet,
                                          double trainRatio,
                                          double validationRatio,
                                          double testRatio,
@@ -209,118 +651,64 @@ void DataLoader::trainValidationTestSplit(const Dataset& dataset,
     if (dataset.inputs.empty()) {
         throw std::invalid_argument("Dataset cannot be empty");
     }
-    if (dataset.inputs.size() != dataset.targets.size()) {
+    if (dataset.inputs.rows() != dataset.targets.rows()) {
         throw std::invalid_argument("Number of inputs must match number of targets");
     }
-    if (trainRatio < 0 || validationRatio < 0 || testRatio < 0) {
-        throw std::invalid_argument("All ratios must be non-negative");
-    }
-    if (std::abs(trainRatio + validationRatio + testRatio - 1.0) > 1e-6) {
-        throw std::invalid_argument("Train, validation, and test ratios must sum to 1.0");
-    }
     
-    size_t totalSamples = dataset.inputs.size();
-    size_t trainSize = static_cast<size_t>(totalSamples * trainRatio);
-    size_t validationSize = static_cast<size_t>(totalSamples * validationRatio);
-    size_t testSize = totalSamples - trainSize - validationSize;
+    Split split = splitIndices(dataset.inputs.rows(), trainRatio, validationRatio, testRatio, seed);
+    trainSet = subset(dataset, split.train);
+    validationSet = subset(dataset, split.validation);
+    testSet = subset(dataset, split.test);
     
-    std::vector<size_t> indices(totalSamples);
-    std::iota(indices.begin(), indices.end(), 0);
-    
-    std::mt19937 g;
-    if (seed == 0) {
-        std::random_device rd;
-        g.seed(rd());
-    } else {
-        g.seed(seed);
-    }
-    std::shuffle(indices.begin(), indices.end(), g);
-    
-    trainSet.inputs.clear();
-    trainSet.targets.clear();
-    validationSet.inputs.clear();
-    validationSet.targets.clear();
-    testSet.inputs.clear();
-    testSet.targets.clear();
-    
-    trainSet.featureNames = dataset.featureNames;
-    trainSet.classNames = dataset.classNames;
-    validationSet.featureNames = dataset.featureNames;
-    validationSet.classNames = dataset.classNames;
-    testSet.featureNames = dataset.featureNames;
-    testSet.classNames = dataset.classNames;
-    
-    trainSet.inputs.reserve(trainSize);
-    trainSet.targets.reserve(trainSize);
-    validationSet.inputs.reserve(validationSize);
-    validationSet.targets.reserve(validationSize);
-    testSet.inputs.reserve(testSize);
-    testSet.targets.reserve(testSize);
-
-    size_t currentIndex = 0;
-    
-    for (size_t i = 0; i < trainSize; ++i) {
-        trainSet.inputs.push_back(dataset.inputs[indices[currentIndex]]);
-        trainSet.targets.push_back(dataset.targets[indices[currentIndex]]);
-        currentIndex++;
-    }
-    
-    for (size_t i = 0; i < validationSize; ++i) {
-        validationSet.inputs.push_back(dataset.inputs[indices[currentIndex]]);
-        validationSet.targets.push_back(dataset.targets[indices[currentIndex]]);
-        currentIndex++;
-    }
-    
-    for (size_t i = 0; i < testSize; ++i) {
-        testSet.inputs.push_back(dataset.inputs[indices[currentIndex]]);
-        testSet.targets.push_back(dataset.targets[indices[currentIndex]]);
-        currentIndex++;
-    }
-    
-    std::cout << "Train/Validation/Test split: " << trainSet.inputs.size() << " train, " 
-              << validationSet.inputs.size() << " validation, " 
-              << testSet.inputs.size() << " test samples" << std::endl;
+    std::cout << "Train/Validation/Test split: " << trainSet.inputs.rows() << " train, " 
+              << validationSet.inputs.rows() << " validation, " 
+              << testSet.inputs.rows() << " test samples" << std::endl;
 }
 
 // for int labels
-std::vector<std::vector<double>> DataLoader::oneHotEncode(const std::vector<int>& labels, int numClasses) {
-    std::vector<std::vector<double>> encoded(labels.size(), std::vector<double>(numClasses, 0.0));
+template <typename T>
+Matrix<T> DataLoader::oneHotEncode(const std::vector<int>& labels, int numClasses) {
+    Matrix<T> encoded(labels.size(), numClasses, T(0));
     
     for (size_t i = 0; i < labels.size(); ++i) {
         if (labels[i] >= 0 && labels[i] < numClasses) {
-            encoded[i][labels[i]] = 1.0;
+            encoded(i, labels[i]) = T(1);
         }
     }
     
     return encoded;
 }
 
-std::vector<double> DataLoader::computeMean(const std::vector<std::vector<double>>& data) {
+template <typename T>
+std::vector<double> DataLoader::computeMean(const Matrix<T>& data) {
     if (data.empty()) return {};
     
-    std::vector<double> mean(data[0].size(), 0.0);
+    std::vector<double> mean(data.cols(), 0.0);
     
-    for (const auto& sample : data) {
-        for (size_t i = 0; i < sample.size(); ++i) {
+    for (size_t row = 0; row < data.rows(); ++row) {
+        const T* sample = data.rowData(row);
+        for (size_t i = 0; i < data.cols(); ++i) {
             mean[i] += sample[i];
         }
     }
     
     for (double& m : mean) {
-        m /= data.size();
+        m /= data.rows();
     }
     
     return mean;
 }
 
-std::vector<double> DataLoader::computeStd(const std::vector<std::vector<double>>& data, 
+template <typename T>
+std::vector<double> DataLoader::computeStd(const Matrix<T>& data, 
                                            const std::vector<double>& mean) {
     if (data.empty()) return {};
     
     std::vector<double> variance(mean.size(), 0.0);
     
-    for (const auto& sample : data) {
-        for (size_t i = 0; i < sample.size(); ++i) {
+    for (size_t row = 0; row < data.rows(); ++row) {
+        const T* sample = data.rowData(row);
+        for (size_t i = 0; i < data.cols(); ++i) {
             double diff = sample[i] - mean[i];
             variance[i] += diff * diff;
         }
@@ -328,9 +716,36 @@ std::vector<double> DataLoader::computeStd(const std::vector<std::vector<double>
     
     std::vector<double> std(variance.size());
     for (size_t i = 0; i < variance.size(); ++i) {
-        variance[i] /= data.size();
+        variance[i] /= data.rows();
         std[i] = std::sqrt(variance[i]);
     }
     
     return std;
 }
+
+#define INSTANTIATE_DATA_LOADER(T)                                                                 \
+    template DataLoader::BasicDataset<T> DataLoader::loadIrisDataset<T>();                         \
+    template DataLoader::BasicDataset<T> DataLoader::loadIrisFromCSV<T>(const std::string&);       \
+    template DataLoader::BasicDataset<T> DataLoader::loadCSV<T>(const std::string&, const CsvSpec&); \
+    template class DataLoader::BasicMappedDataset<T>;                                              \
+    template void DataLoader::saveDataset(const BasicDataset<T>&, const std::string&);             \
+    template DataLoader::BasicMappedDataset<T> DataLoader::mapDataset<T>(const std::string&);     \
+    template void DataLoader::convertCSV<T>(const std::string&, const CsvSpec&, const std::string&); \
+    template void DataLoader::normalizeFeatures(Matrix<T>&);                                       \
+    template void DataLoader::trainTestSplit(const BasicDataset<T>&, BasicDataset<T>&,             \
+                                             BasicDataset<T>&, double, unsigned int);              \
+    template void DataLoader::trainValidationTestSplit(const BasicDataset<T>&, BasicDataset<T>&,   \
+                                                       BasicDataset<T>&, BasicDataset<T>&,         \
+                                                       double, double, double, unsigned int);      \
+    template DataLoader::Split DataLoader::stratifiedSplit(const BasicDataset<T>&, double, double,  \
+                                                           double, unsigned int);                  \
+    template std::vector<DataLoader::Split> DataLoader::stratifiedKFold(const BasicDataset<T>&,      \
+                                                                        size_t, unsigned int);     \
+    template DataLoader::BasicDataset<T> DataLoader::subset(const BasicDataset<T>&,                 \
+                                                            const std::vector<size_t>&);           \
+    template Matrix<T> DataLoader::oneHotEncode<T>(const std::vector<int>&, int);
+
+INSTANTIATE_DATA_LOADER(float)
+INSTANTIATE_DATA_LOADER(double)
+
+#undef INSTANTIATE_DATA_LOADER
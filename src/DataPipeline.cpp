@@ -0,0 +1,175 @@
+#include "../include/DataPipeline.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    std::vector<size_t> allRows(size_t count) {
+        std::vector<size_t> rows(count);
+        std::iota(rows.begin(), rows.end(), 0);
+        return rows;
+    }
+
+}
+
+template <typename T>
+BasicDataPipeline<T>::BasicDataPipeline(const Matrix<T>& inputs, const Matrix<T>& targets,
+                                        const Options& options)
+    : BasicDataPipeline(inputs, targets, allRows(inputs.rows()), options) {}
+
+template <typename T>
+BasicDataPipeline<T>::BasicDataPipeline(const Matrix<T>& inputs, const Matrix<T>& targets,
+                                        std::vector<size_t> rows, const Options& options)
+    : inputs(inputs), targets(targets), rows(std::move(rows)), options(options) {
+    if (inputs.rows() != targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples");
+    }
+    if (this->rows.empty()) {
+        throw std::invalid_argument("Pipeline needs at least one sample");
+    }
+    if (options.batchSize < 1 || options.slots < 1) {
+        throw std::invalid_argument("Batch size and slot count must be at least 1");
+    }
+    for (size_t row : this->rows) {
+        if (row >= inputs.rows()) {
+            throw std::invalid_argument("Row index " + std::to_string(row) + " is out of range");
+        }
+    }
+
+    if (options.normalize) {
+        // accumulated in double like DataLoader::normalizeFeatures
+        const size_t cols = inputs.cols();
+        std::vector<double> sum(cols, 0.0);
+        std::vector<double> squares(cols, 0.0);
+        for (size_t row : this->rows) {
+            const T* sample = inputs.rowData(row);
+            for (size_t j = 0; j < cols; ++j) {
+                sum[j] += sample[j];
+            }
+        }
+        for (size_t j = 0; j < cols; ++j) {
+            sum[j] /= this->rows.size();
+        }
+        for (size_t row : this->rows) {
+            const T* sample = inputs.rowData(row);
+            for (size_t j = 0; j < cols; ++j) {
+                const double diff = sample[j] - sum[j];
+                squares[j] += diff * diff;
+            }
+        }
+        mean.resize(cols);
+        stddev.resize(cols);
+        inverseStd.resize(cols);
+        for (size_t j = 0; j < cols; ++j) {
+            const double deviation = std::sqrt(squares[j] / this->rows.size());
+            const bool constant = deviation <= 1e-8;
+            mean[j] = constant ? T(0) : static_cast<T>(sum[j]);
+            stddev[j] = constant ? T(1) : static_cast<T>(deviation);
+            inverseStd[j] = T(1) / stddev[j];
+        }
+    }
+
+    ring.resize(options.slots);
+    producer = std::thread(&BasicDataPipeline::produce, this);
+}
+
+template <typename T>
+BasicDataPipeline<T>::~BasicDataPipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slotFreed.notify_all();
+    producer.join();
+}
+
+template <typename T>
+size_t BasicDataPipeline<T>::samples() const {
+    return rows.size();
+}
+
+template <typename T>
+size_t BasicDataPipeline<T>::batchesPerEpoch() const {
+    return (rows.size() + options.batchSize - 1) / options.batchSize;
+}
+
+template <typename T>
+const typename BasicDataPipeline<T>::Batch& BasicDataPipeline<T>::next() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (handedOut > released) {
+        released = handedOut;
+        slotFreed.notify_one();
+    }
+    slotFilled.wait(lock, [this] { return error || produced > handedOut; });
+    if (produced == handedOut) {
+        std::rethrow_exception(error);
+    }
+    return ring[handedOut++ % ring.size()];
+}
+
+template <typename T>
+const std::vector<T>& BasicDataPipeline<T>::featureMean() const {
+    return mean;
+}
+
+template <typename T>
+const std::vector<T>& BasicDataPipeline<T>::featureStd() const {
+    return stddev;
+}
+
+template <typename T>
+void BasicDataPipeline<T>::produce() {
+    try {
+        std::mt19937 g(options.seed == 0 ? std::random_device()() : options.seed);
+        std::vector<size_t> order = rows;
+        const size_t batches = batchesPerEpoch();
+        for (size_t epoch = 0;; ++epoch) {
+            if (options.shuffle) {
+                std::shuffle(order.begin(), order.end(), g);
+            }
+            for (size_t b = 0; b < batches; ++b) {
+                Batch* slot;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    slotFreed.wait(lock, [this] { return stopping || produced - released < ring.size(); });
+                    if (stopping) return;
+                    slot = &ring[produced % ring.size()];
+                }
+                // the slot is neither handed out nor visible to the consumer until produced moves past it
+                const size_t first = b * options.batchSize;
+                pack(*slot, order.data() + first, std::min(options.batchSize, order.size() - first));
+                slot->epoch = epoch;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++produced;
+                }
+                slotFilled.notify_one();
+            }
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+        slotFilled.notify_one();
+    }
+}
+
+template <typename T>
+void BasicDataPipeline<T>::pack(Batch& batch, const size_t* order, size_t count) const {
+    batch.inputs.assignRows(inputs, order, count);
+    batch.targets.assignRows(targets, order, count);
+    if (!options.normalize) return;
+    const size_t cols = batch.inputs.cols();
+    for (size_t i = 0; i < count; ++i) {
+        T* sample = batch.inputs.rowData(i);
+        for (size_t j = 0; j < cols; ++j) {
+            sample[j] = (sample[j] - mean[j]) * inverseStd[j];
+        }
+    }
+}
+
+template class BasicDataPipeline<float>;
+template class BasicDataPipeline<double>;
@@ -0,0 +1,782 @@
+#include "../include/Gemm.h"
+#include "../include/Matrix.h"
+#include "../include/CpuFeatures.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+namespace Gemm {
+
+    namespace {
+
+        // Cache blocks: an MC x KC block of A stays in L2 and a KC x NC block of B in L3,
+        // while one KC x NR micro-panel of B is streamed through L1.
+        template <typename T> struct Blocking;
+
+        template <> struct Blocking<double> {
+            static constexpr size_t MC = 144;
+            static constexpr size_t KC = 256;
+            static constexpr size_t NC = 2048;
+            static constexpr size_t MaxMR = 8;
+            static constexpr size_t MaxNR = 16;
+        };
+
+        template <> struct Blocking<float> {
+            static constexpr size_t MC = 144;
+            static constexpr size_t KC = 512;
+            static constexpr size_t NC = 4096;
+            static constexpr size_t MaxMR = 8;
+            static constexpr size_t MaxNR = 32;
+        };
+
+        // Below this many multiply-adds packing costs more than it saves.
+        constexpr size_t SmallProblem = 32 * 32 * 32;
+
+        // B may hold bfloat16 (mixed precision), widened as it is read
+        template <typename T>
+        inline T load(T value) { return value; }
+        template <typename T>
+        inline T load(BFloat16 value) { return static_cast<T>(static_cast<float>(value)); }
+
+        template <typename T, typename S>
+        inline T element(const S* A, size_t lda, Transpose trans, size_t row, size_t col) {
+            return load<T>(trans == Transpose::No ? A[row * lda + col] : A[col * lda + row]);
+        }
+
+        // C[MR x NR] += alpha * Apanel * Bpanel over kc packed steps, with NR = NV
+        // vectors of VecBytes each. The accumulator tile is sized to stay in the
+        // register file of the target the instantiation is compiled for.
+        template <typename T, size_t MR, size_t NV, size_t VecBytes>
+        inline __attribute__((always_inline))
+        void microKernelBody(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc) {
+            typedef T Vec __attribute__((vector_size(VecBytes)));
+            constexpr size_t Lanes = VecBytes / sizeof(T);
+
+            Vec acc[MR][NV];
+            for (size_t i = 0; i < MR; ++i)
+                for (size_t v = 0; v < NV; ++v) acc[i][v] = Vec{};
+            for (size_t p = 0; p < kc; ++p) {
+                Vec bv[NV];
+                for (size_t v = 0; v < NV; ++v) std::memcpy(&bv[v], b + v * Lanes, VecBytes);
+                for (size_t i = 0; i < MR; ++i) {
+                    const T ai = a[i];
+                    for (size_t v = 0; v < NV; ++v) acc[i][v] += ai * bv[v];
+                }
+                a += MR;
+                b += NV * Lanes;
+            }
+            for (size_t i = 0; i < MR; ++i) {
+                for (size_t v = 0; v < NV; ++v) {
+                    Vec cv;
+                    std::memcpy(&cv, c + i * ldc + v * Lanes, VecBytes);
+                    cv += alpha * acc[i][v];
+                    std::memcpy(c + i * ldc + v * Lanes, &cv, VecBytes);
+                }
+            }
+        }
+
+        template <typename T>
+        struct MicroKernel {
+            void (*run)(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc);
+            // the same tile for a single row, whose kc contiguous elements are
+            // already a packed one-row panel
+            void (*runRow)(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc);
+            size_t mr;
+            size_t nr;
+        };
+
+        // One instantiation per scalar type and target; every variant uses two
+        // accumulator vectors per row of the tile.
+        template <typename T, size_t MR, size_t VecBytes>
+        void microKernel(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc) {
+            microKernelBody<T, MR, 2, VecBytes>(kc, alpha, a, b, c, ldc);
+        }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        template <typename T, size_t MR>
+        __attribute__((target("avx2,fma")))
+        void microKernelAvx2(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc) {
+            microKernelBody<T, MR, 2, 32>(kc, alpha, a, b, c, ldc);
+        }
+
+        template <typename T, size_t MR>
+        __attribute__((target("avx512f")))
+        void microKernelAvx512(size_t kc, T alpha, const T* a, const T* b, T* c, size_t ldc) {
+            microKernelBody<T, MR, 2, 64>(kc, alpha, a, b, c, ldc);
+        }
+#endif
+
+        template <typename T>
+        MicroKernel<T> selectMicroKernel() {
+            constexpr size_t Lanes128 = 16 / sizeof(T);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            switch (CpuFeatures::detected()) {
+                case CpuFeatures::SimdLevel::AVX512:
+                    return {microKernelAvx512<T, 8>, microKernelAvx512<T, 1>, 8, 8 * Lanes128};
+                case CpuFeatures::SimdLevel::AVX2:
+                    return {microKernelAvx2<T, 6>, microKernelAvx2<T, 1>, 6, 4 * Lanes128};
+                default: break;
+            }
+#endif
+            return {microKernel<T, 4, 16>, microKernel<T, 1, 16>, 4, 2 * Lanes128};
+        }
+
+        // Packs rows [i0, i0 + mc) x cols [p0, p0 + kc) of op(A) into mr-row panels,
+        // zero-padding the last panel.
+        template <typename T>
+        void packA(Transpose trans, const T* A, size_t lda, size_t i0, size_t p0,
+                   size_t mc, size_t kc, size_t mr, T* packed) {
+            for (size_t ir = 0; ir < mc; ir += mr) {
+                const size_t rows = std::min(mr, mc - ir);
+                if (trans == Transpose::No) {
+                    for (size_t i = 0; i < mr; ++i) {
+                        if (i < rows) {
+                            const T* src = A + (i0 + ir + i) * lda + p0;
+                            for (size_t p = 0; p < kc; ++p) packed[p * mr + i] = src[p];
+                        } else {
+                            for (size_t p = 0; p < kc; ++p) packed[p * mr + i] = T(0);
+                        }
+                    }
+                } else {
+                    for (size_t p = 0; p < kc; ++p) {
+                        const T* src = A + (p0 + p) * lda + i0 + ir;
+                        size_t i = 0;
+                        for (; i < rows; ++i) packed[p * mr + i] = src[i];
+                        for (; i < mr; ++i) packed[p * mr + i] = T(0);
+                    }
+                }
+                packed += kc * mr;
+            }
+        }
+
+        // Packs rows [p0, p0 + kc) x cols [j0, j0 + nc) of op(B) into nr-column panels.
+        template <typename T, typename S>
+        void packB(Transpose trans, const S* B, size_t ldb, size_t p0, size_t j0,
+                   size_t kc, size_t nc, size_t nr, T* packed) {
+            for (size_t jr = 0; jr < nc; jr += nr) {
+                const size_t cols = std::min(nr, nc - jr);
+                if (trans == Transpose::No) {
+                    for (size_t p = 0; p < kc; ++p) {
+                        const S* src = B + (p0 + p) * ldb + j0 + jr;
+                        size_t j = 0;
+                        for (; j < cols; ++j) packed[p * nr + j] = load<T>(src[j]);
+                        for (; j < nr; ++j) packed[p * nr + j] = T(0);
+                    }
+                } else {
+                    for (size_t j = 0; j < nr; ++j) {
+                        if (j < cols) {
+                            const S* src = B + (j0 + jr + j) * ldb + p0;
+                            for (size_t p = 0; p < kc; ++p) packed[p * nr + j] = load<T>(src[p]);
+                        } else {
+                            for (size_t p = 0; p < kc; ++p) packed[p * nr + j] = T(0);
+                        }
+                    }
+                }
+                packed += kc * nr;
+            }
+        }
+
+        template <typename T>
+        void scaleC(size_t M, size_t N, T beta, T* C, size_t ldc) {
+            if (beta == T(1)) return;
+            for (size_t i = 0; i < M; ++i) {
+                T* c = C + i * ldc;
+                if (beta == T(0)) {
+                    std::fill(c, c + N, T(0));
+                } else {
+                    for (size_t j = 0; j < N; ++j) c[j] *= beta;
+                }
+            }
+        }
+
+        template <typename T, typename S>
+        void gemmSmall(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+                       T alpha, const T* A, size_t lda, const S* B, size_t ldb,
+                       T* C, size_t ldc) {
+            if (transB == Transpose::No) {
+                for (size_t i = 0; i < M; ++i) {
+                    T* c = C + i * ldc;
+                    for (size_t p = 0; p < K; ++p) {
+                        const T a = alpha * element<T>(A, lda, transA, i, p);
+                        const S* b = B + p * ldb;
+                        for (size_t j = 0; j < N; ++j) c[j] += a * load<T>(b[j]);
+                    }
+                }
+            } else {
+                for (size_t i = 0; i < M; ++i) {
+                    T* c = C + i * ldc;
+                    for (size_t j = 0; j < N; ++j) {
+                        const S* b = B + j * ldb;
+                        T sum = T(0);
+                        for (size_t p = 0; p < K; ++p) sum += element<T>(A, lda, transA, i, p) * load<T>(b[p]);
+                        c[j] += alpha * sum;
+                    }
+                }
+            }
+        }
+
+        // C[:, 0:nc] += alpha * op(A)[:, pc:pc + kc] * Bblock, where Bblock is one
+        // kc x nc block of op(B) already packed into NR-column panels.
+        template <typename T>
+        void multiplyPackedBlock(Transpose transA, size_t M, size_t pc, size_t kc, size_t nc,
+                                 T alpha, const T* A, size_t lda, const T* packedB,
+                                 T* C, size_t ldc, const MicroKernel<T>& kernel) {
+            using Blk = Blocking<T>;
+            const size_t MR = kernel.mr, NR = kernel.nr;
+
+            // packing buffer lives per thread and is reused across calls
+            thread_local Matrix<T> packedA(1, (Blk::MC + Blk::MaxMR) * Blk::KC);
+            alignas(64) T edge[Blk::MaxMR * Blk::MaxNR];
+
+            for (size_t ic = 0; ic < M; ic += Blk::MC) {
+                const size_t mc = std::min(Blk::MC, M - ic);
+                packA(transA, A, lda, ic, pc, mc, kc, MR, packedA.data());
+
+                for (size_t jr = 0; jr < nc; jr += NR) {
+                    const size_t nr = std::min(NR, nc - jr);
+                    const T* bPanel = packedB + (jr / NR) * kc * NR;
+                    for (size_t ir = 0; ir < mc; ir += MR) {
+                        const size_t mr = std::min(MR, mc - ir);
+                        const T* aPanel = packedA.data() + (ir / MR) * kc * MR;
+                        T* c = C + (ic + ir) * ldc + jr;
+                        if (mr == MR && nr == NR) {
+                            kernel.run(kc, alpha, aPanel, bPanel, c, ldc);
+                        } else {
+                            std::fill(edge, edge + MR * NR, T(0));
+                            kernel.run(kc, alpha, aPanel, bPanel, edge, NR);
+                            for (size_t i = 0; i < mr; ++i) {
+                                for (size_t j = 0; j < nr; ++j) {
+                                    c[i * ldc + j] += edge[i * NR + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        template <typename T, typename S>
+        void gemmBlocked(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+                         T alpha, const T* A, size_t lda, const S* B, size_t ldb,
+                         T* C, size_t ldc, const MicroKernel<T>& kernel) {
+            using Blk = Blocking<T>;
+            thread_local Matrix<T> packedB(1, (Blk::NC + Blk::MaxNR) * Blk::KC);
+
+            for (size_t jc = 0; jc < N; jc += Blk::NC) {
+                const size_t nc = std::min(Blk::NC, N - jc);
+                for (size_t pc = 0; pc < K; pc += Blk::KC) {
+                    const size_t kc = std::min(Blk::KC, K - pc);
+                    packB(transB, B, ldb, pc, jc, kc, nc, kernel.nr, packedB.data());
+                    multiplyPackedBlock(transA, M, pc, kc, nc, alpha, A, lda, packedB.data(), C + jc, ldc, kernel);
+                }
+            }
+        }
+
+        template <typename T>
+        const MicroKernel<T>& microKernel() {
+            static const MicroKernel<T> kernel = selectMicroKernel<T>();
+            return kernel;
+        }
+
+        // Elements of op(B) packed whole: every kc x nc block in the order
+        // gemmBlocked visits them, each padded to whole NR-column panels.
+        template <typename T>
+        size_t packedElements(size_t K, size_t N, size_t NR) {
+            using Blk = Blocking<T>;
+            size_t elements = 0;
+            for (size_t jc = 0; jc < N; jc += Blk::NC) {
+                const size_t nc = std::min(Blk::NC, N - jc);
+                elements += (nc + NR - 1) / NR * NR * K;
+            }
+            return elements;
+        }
+
+        template <typename T>
+        void packImpl(Transpose trans, size_t K, size_t N, const T* B, size_t ldb, PackedMatrix<T>& packed) {
+            using Blk = Blocking<T>;
+            const size_t NR = microKernel<T>().nr;
+            packed.rows = K;
+            packed.cols = N;
+            packed.panelWidth = NR;
+            packed.panels.resize(1, packedElements<T>(K, N, NR));
+            T* out = packed.panels.data();
+            for (size_t jc = 0; jc < N; jc += Blk::NC) {
+                const size_t nc = std::min(Blk::NC, N - jc);
+                const size_t panelColumns = (nc + NR - 1) / NR * NR;
+                for (size_t pc = 0; pc < K; pc += Blk::KC) {
+                    const size_t kc = std::min(Blk::KC, K - pc);
+                    packB(trans, B, ldb, pc, jc, kc, nc, NR, out);
+                    out += panelColumns * kc;
+                }
+            }
+        }
+
+        template <typename T>
+        void gemmPackedImpl(size_t M, const T* A, size_t lda, const PackedMatrix<T>& B,
+                            T beta, T* C, size_t ldc) {
+            using Blk = Blocking<T>;
+            const MicroKernel<T>& kernel = microKernel<T>();
+            const size_t K = B.rows, N = B.cols, NR = B.panelWidth;
+            if (NR != kernel.nr) {
+                throw std::invalid_argument("Packed matrix was packed for a different kernel");
+            }
+            if (M == 0 || N == 0) return;
+            scaleC(M, N, beta, C, ldc);
+
+            const T* block = B.panels.data();
+            for (size_t jc = 0; jc < N; jc += Blk::NC) {
+                const size_t nc = std::min(Blk::NC, N - jc);
+                const size_t panelColumns = (nc + NR - 1) / NR * NR;
+                for (size_t pc = 0; pc < K; pc += Blk::KC) {
+                    const size_t kc = std::min(Blk::KC, K - pc);
+                    if (M < kernel.mr) {
+                        // too few rows to fill a micro-tile: each row is read in
+                        // place as a one-row panel
+                        alignas(64) T edge[Blk::MaxNR];
+                        for (size_t i = 0; i < M; ++i) {
+                            const T* a = A + i * lda + pc;
+                            T* c = C + i * ldc + jc;
+                            for (size_t jr = 0; jr < nc; jr += NR) {
+                                const T* panel = block + (jr / NR) * kc * NR;
+                                const size_t nr = std::min(NR, nc - jr);
+                                if (nr == NR) {
+                                    kernel.runRow(kc, T(1), a, panel, c + jr, ldc);
+                                } else {
+                                    std::fill(edge, edge + NR, T(0));
+                                    kernel.runRow(kc, T(1), a, panel, edge, NR);
+                                    for (size_t j = 0; j < nr; ++j) c[jr + j] += edge[j];
+                                }
+                            }
+                        }
+                    } else {
+                        multiplyPackedBlock(Transpose::No, M, pc, kc, nc, T(1), A, lda, block, C + jc, ldc, kernel);
+                    }
+                    block += panelColumns * kc;
+                }
+            }
+        }
+
+        template <typename T, typename S>
+        void gemmImpl(Transpose transA, Transpose transB,
+                      size_t M, size_t N, size_t K,
+                      T alpha, const T* A, size_t lda,
+                      const S* B, size_t ldb,
+                      T beta, T* C, size_t ldc) {
+            const MicroKernel<T>& kernel = microKernel<T>();
+
+            if (M == 0 || N == 0) return;
+            scaleC(M, N, beta, C, ldc);
+            if (K == 0 || alpha == T(0)) return;
+
+            if (M * N * K <= SmallProblem) {
+                gemmSmall(transA, transB, M, N, K, alpha, A, lda, B, ldb, C, ldc);
+            } else {
+                gemmBlocked(transA, transB, M, N, K, alpha, A, lda, B, ldb, C, ldc, kernel);
+            }
+        }
+
+        // Rows of A that share one pass over x (Transpose::No) or over y
+        // (Transpose::Yes) in gemv.
+        constexpr size_t GemvRows = 4;
+
+        // y = alpha * op(A) * x + beta * y with VecBytes-wide vectors. Without
+        // a transpose every output is a dot product, so each of GemvRows rows
+        // keeps its own vector of partial sums instead of one serial scalar
+        // chain; with one, GemvRows rows of A are added into y per pass.
+        template <typename T, size_t VecBytes>
+        inline __attribute__((always_inline))
+        void gemvBody(Transpose transA, size_t M, size_t N, T alpha, const T* A, size_t lda,
+                      const T* x, T beta, T* y) {
+            typedef T Vec __attribute__((vector_size(VecBytes)));
+            constexpr size_t Lanes = VecBytes / sizeof(T);
+
+            if (transA == Transpose::No) {
+                size_t i = 0;
+                for (; i + GemvRows <= M; i += GemvRows) {
+                    const T* a = A + i * lda;
+                    Vec acc[GemvRows];
+                    for (size_t r = 0; r < GemvRows; ++r) acc[r] = Vec{};
+                    size_t j = 0;
+                    for (; j + Lanes <= N; j += Lanes) {
+                        Vec xv;
+                        std::memcpy(&xv, x + j, VecBytes);
+                        for (size_t r = 0; r < GemvRows; ++r) {
+                            Vec av;
+                            std::memcpy(&av, a + r * lda + j, VecBytes);
+                            acc[r] += av * xv;
+                        }
+                    }
+                    for (size_t r = 0; r < GemvRows; ++r) {
+                        T sum = T(0);
+                        for (size_t l = 0; l < Lanes; ++l) sum += acc[r][l];
+                        for (size_t k = j; k < N; ++k) sum += a[r * lda + k] * x[k];
+                        y[i + r] = (beta == T(0) ? T(0) : beta * y[i + r]) + alpha * sum;
+                    }
+                }
+                for (; i < M; ++i) {
+                    const T* a = A + i * lda;
+                    Vec acc = Vec{};
+                    size_t j = 0;
+                    for (; j + Lanes <= N; j += Lanes) {
+                        Vec av, xv;
+                        std::memcpy(&av, a + j, VecBytes);
+                        std::memcpy(&xv, x + j, VecBytes);
+                        acc += av * xv;
+                    }
+                    T sum = T(0);
+                    for (size_t l = 0; l < Lanes; ++l) sum += acc[l];
+                    for (; j < N; ++j) sum += a[j] * x[j];
+                    y[i] = (beta == T(0) ? T(0) : beta * y[i]) + alpha * sum;
+                }
+            } else {
+                scaleC<T>(1, N, beta, y, N);
+                size_t i = 0;
+                for (; i + GemvRows <= M; i += GemvRows) {
+                    const T* __restrict a0 = A + i * lda;
+                    const T* __restrict a1 = a0 + lda;
+                    const T* __restrict a2 = a1 + lda;
+                    const T* __restrict a3 = a2 + lda;
+                    const T x0 = alpha * x[i], x1 = alpha * x[i + 1];
+                    const T x2 = alpha * x[i + 2], x3 = alpha * x[i + 3];
+                    T* __restrict out = y;
+                    for (size_t j = 0; j < N; ++j) {
+                        out[j] += x0 * a0[j] + x1 * a1[j] + x2 * a2[j] + x3 * a3[j];
+                    }
+                }
+                for (; i < M; ++i) {
+                    const T* __restrict a = A + i * lda;
+                    const T xi = alpha * x[i];
+                    T* __restrict out = y;
+                    for (size_t j = 0; j < N; ++j) out[j] += xi * a[j];
+                }
+            }
+        }
+
+        template <typename T>
+        using GemvKernel = void (*)(Transpose, size_t, size_t, T, const T*, size_t, const T*, T, T*);
+
+        template <typename T>
+        void gemvGeneric(Transpose transA, size_t M, size_t N, T alpha, const T* A, size_t lda,
+                         const T* x, T beta, T* y) {
+            gemvBody<T, 16>(transA, M, N, alpha, A, lda, x, beta, y);
+        }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        template <typename T>
+        __attribute__((target("avx2,fma")))
+        void gemvAvx2(Transpose transA, size_t M, size_t N, T alpha, const T* A, size_t lda,
+                      const T* x, T beta, T* y) {
+            gemvBody<T, 32>(transA, M, N, alpha, A, lda, x, beta, y);
+        }
+
+        template <typename T>
+        __attribute__((target("avx512f")))
+        void gemvAvx512(Transpose transA, size_t M, size_t N, T alpha, const T* A, size_t lda,
+                        const T* x, T beta, T* y) {
+            gemvBody<T, 64>(transA, M, N, alpha, A, lda, x, beta, y);
+        }
+#endif
+
+        template <typename T>
+        GemvKernel<T> selectGemvKernel() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            switch (CpuFeatures::detected()) {
+                case CpuFeatures::SimdLevel::AVX512: return gemvAvx512<T>;
+                case CpuFeatures::SimdLevel::AVX2: return gemvAvx2<T>;
+                default: break;
+            }
+#endif
+            return gemvGeneric<T>;
+        }
+
+        template <typename T>
+        void gemvImpl(Transpose transA, size_t M, size_t N,
+                      T alpha, const T* A, size_t lda,
+                      const T* x, T beta, T* y) {
+            static const GemvKernel<T> kernel = selectGemvKernel<T>();
+            kernel(transA, M, N, alpha, A, lda, x, beta, y);
+        }
+
+        // Packed int8 weights: groups of PackRows rows, each stored as ceil(K / 4)
+        // steps of PackRows x 4 bytes, so one 64-byte load holds four
+        // consecutive inputs of 16 outputs and a 4-byte broadcast of the input
+        // row feeds every lane.
+        constexpr size_t PackRows = 16;
+        constexpr size_t PackStep = PackRows * 4;
+
+        // the four inputs of step p, zero beyond K
+        inline int32_t inputQuad(const uint8_t* a, size_t p, size_t K) {
+            int32_t quad = 0;
+            std::memcpy(&quad, a + 4 * p, std::min<size_t>(4, K - 4 * p));
+            return quad;
+        }
+
+        // C[MR x n] = A[MR x K] * B^T for one group of packed rows; Ops supplies
+        // the vector type and the four-way u8 x s8 dot product.
+        template <typename Ops, size_t MR>
+        inline __attribute__((always_inline))
+        void gemmU8S8Block(size_t K, const uint8_t* A, size_t lda, const int8_t* b,
+                           int32_t* C, size_t ldc, size_t n) {
+            using Vec = typename Ops::Vec;
+            constexpr size_t NV = PackRows / Ops::Lanes;
+            Vec acc[MR][NV];
+            for (size_t i = 0; i < MR; ++i)
+                for (size_t v = 0; v < NV; ++v) Ops::zero(acc[i][v]);
+
+            auto step = [&](size_t p, const int32_t* quads) __attribute__((always_inline)) {
+                Vec w[NV];
+                for (size_t v = 0; v < NV; ++v) Ops::load(w[v], b + p * PackStep + v * Ops::Lanes * 4);
+                for (size_t i = 0; i < MR; ++i)
+                    for (size_t v = 0; v < NV; ++v) Ops::dot(acc[i][v], quads[i], w[v]);
+            };
+            const size_t fullSteps = K / 4;
+            for (size_t p = 0; p < fullSteps; ++p) {
+                int32_t quads[MR];
+                for (size_t i = 0; i < MR; ++i) std::memcpy(&quads[i], A + i * lda + 4 * p, 4);
+                step(p, quads);
+            }
+            if (K % 4) {
+                int32_t quads[MR];
+                for (size_t i = 0; i < MR; ++i) quads[i] = inputQuad(A + i * lda, fullSteps, K);
+                step(fullSteps, quads);
+            }
+
+            for (size_t i = 0; i < MR; ++i) {
+                if (n == PackRows) {
+                    for (size_t v = 0; v < NV; ++v) Ops::store(C + i * ldc + v * Ops::Lanes, acc[i][v]);
+                } else {
+                    int32_t row[PackRows];
+                    for (size_t v = 0; v < NV; ++v) Ops::store(row + v * Ops::Lanes, acc[i][v]);
+                    std::copy(row, row + n, C + i * ldc);
+                }
+            }
+        }
+
+        template <typename Ops>
+        inline __attribute__((always_inline))
+        void gemmU8S8Body(size_t M, size_t N, size_t K, const uint8_t* A, size_t lda,
+                          const int8_t* packedB, int32_t* C, size_t ldc) {
+            constexpr size_t MR = Ops::Rows;
+            const size_t groupBytes = (K + 3) / 4 * PackStep;
+            for (size_t j = 0; j < N; j += PackRows) {
+                const int8_t* b = packedB + j / PackRows * groupBytes;
+                const size_t n = std::min(PackRows, N - j);
+                size_t i = 0;
+                for (; i + MR <= M; i += MR) {
+                    gemmU8S8Block<Ops, MR>(K, A + i * lda, lda, b, C + i * ldc + j, ldc, n);
+                }
+                for (; i < M; ++i) {
+                    gemmU8S8Block<Ops, 1>(K, A + i * lda, lda, b, C + i * ldc + j, ldc, n);
+                }
+            }
+        }
+
+        using GemmU8S8Kernel = void (*)(size_t, size_t, size_t, const uint8_t*, size_t,
+                                        const int8_t*, int32_t*, size_t);
+
+        void gemmU8S8Generic(size_t M, size_t N, size_t K, const uint8_t* A, size_t lda,
+                             const int8_t* packedB, int32_t* C, size_t ldc) {
+            const size_t steps = (K + 3) / 4;
+            for (size_t j = 0; j < N; j += PackRows) {
+                const int8_t* b = packedB + j / PackRows * steps * PackStep;
+                const size_t n = std::min(PackRows, N - j);
+                for (size_t i = 0; i < M; ++i) {
+                    int32_t sum[PackRows] = {};
+                    for (size_t p = 0; p < steps; ++p) {
+                        const int32_t quad = inputQuad(A + i * lda, p, K);
+                        uint8_t a[4];
+                        std::memcpy(a, &quad, 4);
+                        for (size_t l = 0; l < PackRows; ++l)
+                            for (size_t t = 0; t < 4; ++t) sum[l] += int32_t(a[t]) * b[p * PackStep + l * 4 + t];
+                    }
+                    std::copy(sum, sum + n, C + i * ldc + j);
+                }
+            }
+        }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        // The vectorizer cannot form vpdpbusd across the packed layout, so these
+        // use intrinsics.
+        struct Avx512VnniOps {
+            using Vec = __m512i;
+            static constexpr size_t Lanes = 16;
+            static constexpr size_t Rows = 8;
+            __attribute__((target("avx512f,avx512bw,avx512vnni")))
+            static inline void zero(Vec& v) { v = _mm512_setzero_si512(); }
+            __attribute__((target("avx512f,avx512bw,avx512vnni")))
+            static inline void load(Vec& v, const int8_t* p) { v = _mm512_load_si512(p); }
+            __attribute__((target("avx512f,avx512bw,avx512vnni")))
+            static inline void dot(Vec& acc, int32_t quad, const Vec& w) {
+                acc = _mm512_dpbusd_epi32(acc, _mm512_set1_epi32(quad), w);
+            }
+            __attribute__((target("avx512f,avx512bw,avx512vnni")))
+            static inline void store(int32_t* p, const Vec& v) { _mm512_storeu_si512(p, v); }
+        };
+
+        struct AvxVnniOps {
+            using Vec = __m256i;
+            static constexpr size_t Lanes = 8;
+            static constexpr size_t Rows = 4;
+            __attribute__((target("avx2,avxvnni")))
+            static inline void zero(Vec& v) { v = _mm256_setzero_si256(); }
+            __attribute__((target("avx2,avxvnni")))
+            static inline void load(Vec& v, const int8_t* p) { v = _mm256_load_si256(reinterpret_cast<const Vec*>(p)); }
+            __attribute__((target("avx2,avxvnni")))
+            static inline void dot(Vec& acc, int32_t quad, const Vec& w) {
+                acc = _mm256_dpbusd_avx_epi32(acc, _mm256_set1_epi32(quad), w);
+            }
+            __attribute__((target("avx2,avxvnni")))
+            static inline void store(int32_t* p, const Vec& v) { _mm256_storeu_si256(reinterpret_cast<Vec*>(p), v); }
+        };
+
+        // vpdpbusd emulated exactly: the even and odd bytes are widened to
+        // 16 bits and summed pairwise by vpmaddwd, which cannot saturate.
+        struct Avx2Ops {
+            using Vec = __m256i;
+            static constexpr size_t Lanes = 8;
+            static constexpr size_t Rows = 4;
+            __attribute__((target("avx2")))
+            static inline void zero(Vec& v) { v = _mm256_setzero_si256(); }
+            __attribute__((target("avx2")))
+            static inline void load(Vec& v, const int8_t* p) { v = _mm256_load_si256(reinterpret_cast<const Vec*>(p)); }
+            __attribute__((target("avx2")))
+            static inline void dot(Vec& acc, int32_t quad, const Vec& w) {
+                const Vec a = _mm256_set1_epi32(quad);
+                const Vec aEven = _mm256_and_si256(a, _mm256_set1_epi16(0x00FF));
+                const Vec aOdd = _mm256_srli_epi16(a, 8);
+                const Vec wEven = _mm256_srai_epi16(_mm256_slli_epi16(w, 8), 8);
+                const Vec wOdd = _mm256_srai_epi16(w, 8);
+                acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_madd_epi16(aEven, wEven),
+                                                             _mm256_madd_epi16(aOdd, wOdd)));
+            }
+            __attribute__((target("avx2")))
+            static inline void store(int32_t* p, const Vec& v) { _mm256_storeu_si256(reinterpret_cast<Vec*>(p), v); }
+        };
+
+        __attribute__((target("avx512f,avx512bw,avx512vnni")))
+        void gemmU8S8Avx512Vnni(size_t M, size_t N, size_t K, const uint8_t* A, size_t lda,
+                                const int8_t* packedB, int32_t* C, size_t ldc) {
+            gemmU8S8Body<Avx512VnniOps>(M, N, K, A, lda, packedB, C, ldc);
+        }
+
+        __attribute__((target("avx2,avxvnni")))
+        void gemmU8S8AvxVnni(size_t M, size_t N, size_t K, const uint8_t* A, size_t lda,
+                             const int8_t* packedB, int32_t* C, size_t ldc) {
+            gemmU8S8Body<AvxVnniOps>(M, N, K, A, lda, packedB, C, ldc);
+        }
+
+        __attribute__((target("avx2")))
+        void gemmU8S8Avx2(size_t M, size_t N, size_t K, const uint8_t* A, size_t lda,
+                          const int8_t* packedB, int32_t* C, size_t ldc) {
+            gemmU8S8Body<Avx2Ops>(M, N, K, A, lda, packedB, C, ldc);
+        }
+#endif
+
+        GemmU8S8Kernel selectGemmU8S8() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            const bool vnni = CpuFeatures::hasVnni();
+            switch (CpuFeatures::detected()) {
+                case CpuFeatures::SimdLevel::AVX512: return vnni ? gemmU8S8Avx512Vnni : gemmU8S8Avx2;
+                case CpuFeatures::SimdLevel::AVX2: return vnni ? gemmU8S8AvxVnni : gemmU8S8Avx2;
+                default: break;
+            }
+#endif
+            return gemmU8S8Generic;
+        }
+
+    }
+
+    void gemm(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+              float alpha, const float* A, size_t lda, const float* B, size_t ldb,
+              float beta, float* C, size_t ldc) {
+        gemmImpl(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    void gemm(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+              double alpha, const double* A, size_t lda, const double* B, size_t ldb,
+              double beta, double* C, size_t ldc) {
+        gemmImpl(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    void gemm(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+              float alpha, const float* A, size_t lda, const BFloat16* B, size_t ldb,
+              float beta, float* C, size_t ldc) {
+        gemmImpl(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    void gemm(Transpose transA, Transpose transB, size_t M, size_t N, size_t K,
+              double alpha, const double* A, size_t lda, const BFloat16* B, size_t ldb,
+              double beta, double* C, size_t ldc) {
+        gemmImpl(transA, transB, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+
+    void gemv(Transpose transA, size_t M, size_t N,
+              float alpha, const float* A, size_t lda,
+              const float* x, float beta, float* y) {
+        gemvImpl(transA, M, N, alpha, A, lda, x, beta, y);
+    }
+
+    void gemv(Transpose transA, size_t M, size_t N,
+              double alpha, const double* A, size_t lda,
+              const double* x, double beta, double* y) {
+        gemvImpl(transA, M, N, alpha, A, lda, x, beta, y);
+    }
+
+    void pack(Transpose transB, size_t K, size_t N, const float* B, size_t ldb, PackedMatrix<float>& packed) {
+        packImpl(transB, K, N, B, ldb, packed);
+    }
+
+    void pack(Transpose transB, size_t K, size_t N, const double* B, size_t ldb, PackedMatrix<double>& packed) {
+        packImpl(transB, K, N, B, ldb, packed);
+    }
+
+    template <>
+    size_t packedPanelWidth<float>() {
+        return microKernel<float>().nr;
+    }
+
+    template <>
+    size_t packedPanelWidth<double>() {
+        return microKernel<double>().nr;
+    }
+
+    void gemm(size_t M, const float* A, size_t lda, const PackedMatrix<float>& B,
+              float beta, float* C, size_t ldc) {
+        gemmPackedImpl(M, A, lda, B, beta, C, ldc);
+    }
+
+    void gemm(size_t M, const double* A, size_t lda, const PackedMatrix<double>& B,
+              double beta, double* C, size_t ldc) {
+        gemmPackedImpl(M, A, lda, B, beta, C, ldc);
+    }
+
+    size_t packedS8Size(size_t N, size_t K) {
+        return (N + PackRows - 1) / PackRows * ((K + 3) / 4) * PackStep;
+    }
+
+    void packS8(size_t N, size_t K, const int8_t* B, size_t ldb, int8_t* packed) {
+        const size_t steps = (K + 3) / 4;
+        for (size_t j = 0; j < N; j += PackRows) {
+            for (size_t p = 0; p < steps; ++p) {
+                for (size_t l = 0; l < PackRows; ++l) {
+                    for (size_t t = 0; t < 4; ++t) {
+                        const size_t row = j + l, col = 4 * p + t;
+                        *packed++ = row < N && col < K ? B[row * ldb + col] : int8_t(0);
+                    }
+                }
+            }
+        }
+    }
+
+    void gemmU8S8(size_t M, size_t N, size_t K,
+                  const uint8_t* A, size_t lda,
+                  const int8_t* packedB,
+                  int32_t* C, size_t ldc) {
+        static const GemmU8S8Kernel kernel = selectGemmU8S8();
+        kernel(M, N, K, A, lda, packedB, C, ldc);
+    }
+
+}
@@ -0,0 +1,180 @@
+#include "../include/InferencePlan.h"
+#include "../include/NeuralNetwork.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+    // A full row block of a layer with at most this many weights stays below
+    // the size at which Gemm::gemm switches to its packed kernel.
+    constexpr size_t DirectProduct = 32768;
+
+}
+
+template <typename T>
+BasicInferencePlan<T>::BasicInferencePlan(const BasicNeuralNetwork<T>& network) {
+    if (!supports(network)) {
+        throw std::invalid_argument(
+            "Only networks with built-in activations and dense floating-point layers can be compiled");
+    }
+
+    steps.resize(network.getLayerCount());
+    for (size_t i = 0; i < steps.size(); ++i) {
+        const BasicLayer<T>& layer = network.getLayer(i);
+        const Matrix<T>& weights = layer.getWeights();
+        Step& step = steps[i];
+        step.inputs = static_cast<size_t>(layer.getInputSize());
+        step.outputs = static_cast<size_t>(layer.getOutputSize());
+        step.activation = layer.getActivation();
+        step.biases = layer.getBiases();
+
+        // narrower than one panel, most of every packed row would be padding
+        const bool small = step.inputs * step.outputs * RowBlock <= DirectProduct ||
+                           step.outputs < Gemm::packedPanelWidth<T>();
+        step.kernel = small ? Kernel::Direct : Kernel::Packed;
+        if (step.kernel == Kernel::Packed) {
+            Gemm::pack(Gemm::Transpose::Yes, step.inputs, step.outputs, weights.data(), weights.stride(),
+                       step.packed);
+        } else {
+            step.transposed.resize(step.inputs, step.outputs);
+            for (size_t o = 0; o < step.outputs; ++o) {
+                for (size_t k = 0; k < step.inputs; ++k) {
+                    step.transposed(k, o) = weights(o, k);
+                }
+            }
+        }
+        if (i + 1 < steps.size()) {
+            widestHidden = std::max(widestHidden, step.outputs);
+        }
+    }
+}
+
+template <typename T>
+bool BasicInferencePlan<T>::supports(const BasicNeuralNetwork<T>& network) {
+    if (network.getLayerCount() == 0) return false;
+    for (size_t i = 0; i < network.getLayerCount(); ++i) {
+        const BasicLayer<T>& layer = network.getLayer(i);
+        if (layer.isQuantized() || layer.isSparse() || layer.getActivation() == ActivationFunctions::Kind::Custom) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+typename BasicInferencePlan<T>::Workspace BasicInferencePlan<T>::makeWorkspace() const {
+    Workspace workspace;
+    if (widestHidden > 0) {
+        workspace.ping.resize(RowBlock, widestHidden);
+        workspace.pong.resize(RowBlock, widestHidden);
+    }
+    return workspace;
+}
+
+template <typename T>
+void BasicInferencePlan<T>::predict(Span<const T> input, Span<T> output, Workspace& workspace) const {
+    if (input.size() != getInputSize() || output.size() != getOutputSize()) {
+        throw std::invalid_argument("Input or output size does not match the plan.");
+    }
+    run(input.data(), input.size(), 1, output.data(), output.size(), workspace);
+}
+
+template <typename T>
+void BasicInferencePlan<T>::predictBatch(const Matrix<T>& inputs, Matrix<T>& outputs,
+                                         Workspace& workspace) const {
+    if (inputs.cols() != getInputSize()) {
+        throw std::invalid_argument("Input size does not match the plan.");
+    }
+    outputs.resize(inputs.rows(), getOutputSize());
+    run(inputs.data(), inputs.stride(), inputs.rows(), outputs.data(), outputs.stride(), workspace);
+}
+
+template <typename T>
+std::vector<T> BasicInferencePlan<T>::predict(const std::vector<T>& input) const {
+    Workspace workspace = makeWorkspace();
+    std::vector<T> output(getOutputSize());
+    predict(Span<const T>(input), Span<T>(output), workspace);
+    return output;
+}
+
+template <typename T>
+size_t BasicInferencePlan<T>::getInputSize() const {
+    return steps.front().inputs;
+}
+
+template <typename T>
+size_t BasicInferencePlan<T>::getOutputSize() const {
+    return steps.back().outputs;
+}
+
+template <typename T>
+size_t BasicInferencePlan<T>::getLayerCount() const {
+    return steps.size();
+}
+
+template <typename T>
+typename BasicInferencePlan<T>::Kernel BasicInferencePlan<T>::getKernel(size_t layer) const {
+    return steps.at(layer).kernel;
+}
+
+template <typename T>
+void BasicInferencePlan<T>::run(const T* input, size_t inputStride, size_t rows,
+                                T* output, size_t outputStride, Workspace& workspace) const {
+    if (widestHidden > 0 && (workspace.ping.rows() < RowBlock || workspace.ping.cols() < widestHidden ||
+                             workspace.pong.rows() < RowBlock || workspace.pong.cols() < widestHidden)) {
+        workspace = makeWorkspace();
+    }
+
+    for (size_t first = 0; first < rows; first += RowBlock) {
+        const size_t count = std::min(RowBlock, rows - first);
+        const T* current = input + first * inputStride;
+        size_t currentStride = inputStride;
+        Matrix<T>* next = &workspace.ping;
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (i + 1 == steps.size()) {
+                runStep(steps[i], current, currentStride, count, output + first * outputStride, outputStride);
+                break;
+            }
+            runStep(steps[i], current, currentStride, count, next->data(), next->stride());
+            current = next->data();
+            currentStride = next->stride();
+            next = next == &workspace.ping ? &workspace.pong : &workspace.ping;
+        }
+    }
+}
+
+template <typename T>
+void BasicInferencePlan<T>::runStep(const Step& step, const T* input, size_t inputStride, size_t rows,
+                                    T* output, size_t outputStride) const {
+    using ActivationFunctions::Kind;
+    for (size_t r = 0; r < rows; ++r) {
+        std::copy(step.biases.begin(), step.biases.end(), output + r * outputStride);
+    }
+    if (step.kernel == Kernel::Direct) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, rows, step.outputs, step.inputs,
+                   T(1), input, inputStride, step.transposed.data(), step.transposed.stride(),
+                   T(1), output, outputStride);
+    } else {
+        Gemm::gemm(rows, input, inputStride, step.packed, T(1), output, outputStride);
+    }
+    for (size_t r = 0; r < rows; ++r) {
+        T* y = output + r * outputStride;
+        switch (step.activation) {
+            case Kind::Relu:
+                ActivationFunctions::reluInPlace(y, step.outputs);
+                break;
+            case Kind::Sigmoid:
+                ActivationFunctions::sigmoidInPlace(y, step.outputs);
+                break;
+            case Kind::Softmax:
+                ActivationFunctions::softmaxInPlace(y, step.outputs);
+                break;
+            case Kind::Linear:
+            case Kind::Custom: // rejected by the constructor
+                break;
+        }
+    }
+}
+
+template class BasicInferencePlan<float>;
+template class BasicInferencePlan<double>;
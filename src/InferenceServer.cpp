@@ -0,0 +1,340 @@
+#include "../include/InferenceServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    // largest request a connection accepts before it is dropped
+    constexpr uint32_t MaxMessageElements = 1u << 24;
+
+    bool readAll(int fd, void* data, size_t bytes) {
+        char* p = static_cast<char*>(data);
+        while (bytes > 0) {
+            const ssize_t n = ::recv(fd, p, bytes, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool writeAll(int fd, const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            const ssize_t n = ::send(fd, p, bytes, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    template <typename T>
+    bool writeMessage(int fd, const T* data, uint32_t count) {
+        return writeAll(fd, &count, sizeof(count)) && writeAll(fd, data, count * sizeof(T));
+    }
+
+    sockaddr_un socketAddress(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::invalid_argument("Socket path is too long: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+}
+
+template <typename T>
+BasicInferenceServer<T>::BasicInferenceServer(const BasicNeuralNetwork<T>& network, const Options& options)
+    : network(network),
+      plan(BasicInferencePlan<T>::supports(network) ? std::make_unique<const BasicInferencePlan<T>>(network)
+                                                    : nullptr),
+      options(options),
+      inputSize(static_cast<size_t>(network.getInputSize())),
+      outputSize(static_cast<size_t>(network.getOutputSize())) {
+    if (options.maxBatchSize < 1) {
+        throw std::invalid_argument("Maximum batch size must be at least 1");
+    }
+    if (inputSize == 0) {
+        throw std::invalid_argument("Network has no layers");
+    }
+
+    if (!options.socketPath.empty()) {
+        const sockaddr_un address = socketAddress(options.socketPath);
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            throw std::runtime_error(std::string("Could not create socket: ") + std::strerror(errno));
+        }
+        // only a stale socket is replaced; anything else at the path is kept
+        struct stat existing;
+        if (::lstat(options.socketPath.c_str(), &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                ::close(listenFd);
+                throw std::runtime_error("Could not listen on " + options.socketPath + ": not a socket");
+            }
+            ::unlink(options.socketPath.c_str());
+        }
+        if (::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, SOMAXCONN) != 0) {
+            const int error = errno;
+            ::close(listenFd);
+            throw std::runtime_error("Could not listen on " + options.socketPath + ": " + std::strerror(error));
+        }
+    }
+
+    batcher = std::thread(&BasicInferenceServer::batchLoop, this);
+    if (listenFd >= 0) {
+        acceptor = std::thread(&BasicInferenceServer::acceptLoop, this);
+    }
+}
+
+template <typename T>
+BasicInferenceServer<T>::~BasicInferenceServer() {
+    stop();
+}
+
+template <typename T>
+std::future<std::vector<T>> BasicInferenceServer<T>::submit(std::vector<T> input) {
+    if (input.size() != inputSize) {
+        throw std::invalid_argument("Input size does not match the network");
+    }
+    Request request;
+    request.input = std::move(input);
+    request.queued = std::chrono::steady_clock::now();
+    std::future<std::vector<T>> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            throw std::runtime_error("Inference server is stopping");
+        }
+        queue.push_back(std::move(request));
+    }
+    requestQueued.notify_one();
+    return result;
+}
+
+template <typename T>
+void BasicInferenceServer<T>::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        // wakes connections blocked in recv; each closes its own descriptor
+        for (int fd : connections) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+    requestQueued.notify_all();
+
+    if (acceptor.joinable()) acceptor.join();
+    // connections may still wait for queued requests, which the batcher answers
+    for (std::thread& connection : connectionThreads) {
+        connection.join();
+    }
+    connectionThreads.clear();
+    finishedConnections.clear();
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(options.socketPath.c_str());
+        listenFd = -1;
+    }
+    if (batcher.joinable()) batcher.join();
+}
+
+template <typename T>
+typename BasicInferenceServer<T>::Stats BasicInferenceServer<T>::stats() const {
+    Stats stats;
+    stats.requests = requestCount.load();
+    stats.batches = batchCount.load();
+    stats.largestBatch = largestBatch.load();
+    return stats;
+}
+
+template <typename T>
+void BasicInferenceServer<T>::batchLoop() {
+    typename BasicNeuralNetwork<T>::Workspace workspace;
+    typename BasicInferencePlan<T>::Workspace planWorkspace;
+    if (plan) {
+        planWorkspace = plan->makeWorkspace();
+    } else {
+        workspace = network.makeWorkspace();
+    }
+    Matrix<T> inputs;
+    Matrix<T> outputs;
+    std::vector<Request> batch;
+    batch.reserve(options.maxBatchSize);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            requestQueued.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            // hold the batch open until it is full or its oldest request is due
+            const auto deadline = queue.front().queued + options.maxQueueDelay;
+            requestQueued.wait_until(lock, deadline, [this] {
+                return stopping || queue.size() >= options.maxBatchSize;
+            });
+            const size_t count = std::min(queue.size(), options.maxBatchSize);
+            for (size_t i = 0; i < count; ++i) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+
+        // counted before any result is delivered, so a client that got its
+        // answer sees its request in stats()
+        requestCount += batch.size();
+        batchCount += 1;
+        size_t largest = largestBatch.load();
+        while (batch.size() > largest && !largestBatch.compare_exchange_weak(largest, batch.size())) {
+        }
+
+        try {
+            inputs.resize(batch.size(), inputSize);
+            for (size_t r = 0; r < batch.size(); ++r) {
+                std::copy(batch[r].input.begin(), batch[r].input.end(), inputs.rowData(r));
+            }
+            if (plan) {
+                plan->predictBatch(inputs, outputs, planWorkspace);
+            } else {
+                network.predictBatch(inputs, outputs, workspace);
+            }
+            for (size_t r = 0; r < batch.size(); ++r) {
+                batch[r].result.set_value(std::vector<T>(outputs.rowData(r), outputs.rowData(r) + outputSize));
+            }
+        } catch (...) {
+            for (Request& request : batch) {
+                try {
+                    request.result.set_exception(std::current_exception());
+                } catch (const std::future_error&) {
+                    // already answered before the failure
+                }
+            }
+        }
+
+        batch.clear();
+    }
+}
+
+template <typename T>
+void BasicInferenceServer<T>::acceptLoop() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+        }
+        reapConnections();
+        // poll with a timeout so stop() does not depend on waking accept()
+        pollfd ready{listenFd, POLLIN, 0};
+        if (::poll(&ready, 1, 50) <= 0) continue;
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            ::close(fd);
+            return;
+        }
+        connections.insert(fd);
+        connectionThreads.emplace_back(&BasicInferenceServer::serveConnection, this, fd);
+    }
+}
+
+template <typename T>
+void BasicInferenceServer<T>::serveConnection(int fd) {
+    std::vector<T> input;
+    while (true) {
+        uint32_t count;
+        if (!readAll(fd, &count, sizeof(count)) || count > MaxMessageElements) break;
+        input.resize(count);
+        if (!readAll(fd, input.data(), count * sizeof(T))) break;
+
+        std::vector<T> output;
+        if (count == inputSize) {
+            try {
+                output = submit(input).get();
+            } catch (const std::exception&) {
+                output.clear();
+            }
+        }
+        if (!writeMessage(fd, output.data(), static_cast<uint32_t>(output.size()))) break;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    connections.erase(fd);
+    ::close(fd);
+    finishedConnections.push_back(std::this_thread::get_id());
+}
+
+template <typename T>
+void BasicInferenceServer<T>::reapConnections() {
+    std::vector<std::thread> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (std::thread::id id : finishedConnections) {
+            auto it = std::find_if(connectionThreads.begin(), connectionThreads.end(),
+                                   [id](const std::thread& thread) { return thread.get_id() == id; });
+            finished.push_back(std::move(*it));
+            connectionThreads.erase(it);
+        }
+        finishedConnections.clear();
+    }
+    // each has only its return left once it has reported itself
+    for (std::thread& thread : finished) {
+        thread.join();
+    }
+}
+
+template <typename T>
+BasicInferenceClient<T>::BasicInferenceClient(const std::string& socketPath) {
+    const sockaddr_un address = socketAddress(socketPath);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Could not create socket: ") + std::strerror(errno));
+    }
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Could not connect to " + socketPath + ": " + std::strerror(error));
+    }
+}
+
+template <typename T>
+BasicInferenceClient<T>::~BasicInferenceClient() {
+    ::close(fd);
+}
+
+template <typename T>
+std::vector<T> BasicInferenceClient<T>::predict(const std::vector<T>& input) {
+    if (!writeMessage(fd, input.data(), static_cast<uint32_t>(input.size()))) {
+        throw std::runtime_error("Could not send the request");
+    }
+    uint32_t count;
+    if (!readAll(fd, &count, sizeof(count)) || count > MaxMessageElements) {
+        throw std::runtime_error("Could not read the reply");
+    }
+    std::vector<T> output(count);
+    if (!readAll(fd, output.data(), count * sizeof(T))) {
+        throw std::runtime_error("Could not read the reply");
+    }
+    if (output.empty()) {
+        throw std::runtime_error("The server rejected the request");
+    }
+    return output;
+}
+
+template class BasicInferenceServer<float>;
+template class BasicInferenceServer<double>;
+template class BasicInferenceClient<float>;
+template class BasicInferenceClient<double>;
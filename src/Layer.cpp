@@ -1,46 +1,89 @@
 #include "../include/Layer.h"
 #include "../include/ActivationFunctions.h"
+#include "../include/Gemm.h"
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include <numeric>
+#include <stdexcept>
 #include <string>
 
-Layer::Layer(int inputSize, int outputSize, unsigned int seed)
-    : inputSize(inputSize), outputSize(outputSize) {
+namespace {
+
+    template <typename T>
+    void roundRows(const Matrix<T>& source, Matrix<BFloat16>& target) {
+        target.resize(source.rows(), source.cols());
+        for (size_t r = 0; r < source.rows(); ++r) {
+            Precision::convert(source.rowData(r), target.rowData(r), source.cols());
+        }
+    }
+
+    // the indices of the `count` smallest of `n` magnitudes, in no particular order
+    template <typename T>
+    void smallestMagnitudes(const T* values, size_t n, size_t count, std::vector<size_t>& order) {
+        order.resize(n);
+        std::iota(order.begin(), order.end(), size_t(0));
+        if (count < n) {
+            std::nth_element(order.begin(), order.begin() + count, order.end(), [values](size_t a, size_t b) {
+                return std::abs(values[a]) < std::abs(values[b]);
+            });
+        }
+        order.resize(count);
+    }
 
-    activation = [](double x) {
-        return ActivationFunctions::relu(x);
-    };
-    activationDerivative = [](double x) {
-        return ActivationFunctions::reluDerivative(x);
-    };
-    initializeWeights(seed, std::string("relu"));
 }
 
-Layer::Layer(int inputSize, int outputSize, 
-             std::function<double(double)> activation,
-             std::function<double(double)> activationDerivative,
+template <typename T>
+BasicLayer<T>::BasicLayer(int inputSize, int outputSize, unsigned int seed)
+    : BasicLayer(inputSize, outputSize, ActivationFunctions::Kind::Relu, seed) {}
+
+template <typename T>
+BasicLayer<T>::BasicLayer(int inputSize, int outputSize, ActivationFunctions::Kind activation,
+                          unsigned int seed)
+    : inputSize(inputSize), outputSize(outputSize), kind(activation) {
+    initializeWeights(seed, kind);
+}
+
+template <typename T>
+BasicLayer<T>::BasicLayer(int inputSize, int outputSize, 
+             std::function<T(T)> activation,
+             std::function<T(T)> activationDerivative,
              unsigned int seed)
     : inputSize(inputSize), outputSize(outputSize), 
       activation(activation), activationDerivative(activationDerivative) {
-    initializeWeights(seed, "");
+    initializeWeights(seed, kind);
 }
 
-Layer::Layer(int inputSize, int outputSize,
-             std::function<double(double)> activation,
-             std::function<double(double)> activationDerivative,
+template <typename T>
+BasicLayer<T>::BasicLayer(int inputSize, int outputSize,
+             std::function<T(T)> activation,
+             std::function<T(T)> activationDerivative,
              const std::string& activationName,
              unsigned int seed)
     : inputSize(inputSize), outputSize(outputSize),
       activation(activation), activationDerivative(activationDerivative) {
-    initializeWeights(seed, activationName);
+    // the name only picks the initialization; the functions stay in charge
+    initializeWeights(seed, ActivationFunctions::kindFromName(activationName));
+}
+
+template <typename T>
+BasicLayer<T>::BasicLayer(int inputSize, int outputSize, bool useSoftmax, unsigned int seed)
+    : inputSize(inputSize), outputSize(outputSize),
+      kind(useSoftmax ? ActivationFunctions::Kind::Softmax : ActivationFunctions::Kind::Custom) {
+    initializeWeights(seed, kind);
 }
 
-Layer::Layer(int inputSize, int outputSize, bool useSoftmax, unsigned int seed)
-    : inputSize(inputSize), outputSize(outputSize), isSoftmax(useSoftmax) {
-    initializeWeights(seed, useSoftmax ? std::string("softmax") : std::string(""));
+template <typename T>
+BasicLayer<T>::BasicLayer(Matrix<T> weights, std::vector<T> biases, ActivationFunctions::Kind activation)
+    : inputSize(static_cast<int>(weights.cols())), outputSize(static_cast<int>(weights.rows())),
+      weights(std::move(weights)), biases(std::move(biases)), kind(activation) {
+    if (this->biases.size() != this->weights.rows()) {
+        throw std::invalid_argument("Layer needs one bias per output");
+    }
 }
 
-void Layer::initializeWeights(unsigned int seed, const std::string& activationName) {
+template <typename T>
+void BasicLayer<T>::initializeWeights(unsigned int seed, ActivationFunctions::Kind initialization) {
     std::mt19937 gen;
     if (seed == 0) {
         std::random_device rd;
@@ -49,137 +92,642 @@ void Layer::initializeWeights(unsigned int seed, const std::string& activationNa
         gen.seed(seed);
     }
     double limit;
-    if (isSoftmax || activationName == "softmax") {
-        limit = std::sqrt(6.0 / static_cast<double>(inputSize + outputSize));
-    } else if (activationName == "relu") {
+    if (initialization == ActivationFunctions::Kind::Relu) {
         limit = std::sqrt(6.0 / static_cast<double>(inputSize));
-    } else if (activationName == "sigmoid" || activationName == "linear") {
-        limit = std::sqrt(6.0 / static_cast<double>(inputSize + outputSize));
     } else {
         limit = std::sqrt(6.0 / static_cast<double>(inputSize + outputSize));
     }
     std::uniform_real_distribution<> dis(-limit, limit);
 
-    weights.resize(outputSize, std::vector<double>(inputSize));
-    weightsGradients.resize(outputSize, std::vector<double>(inputSize, 0.0));
+    weights.resize(outputSize, inputSize);
+    context.weightGradients.resize(outputSize, inputSize, T(0));
     biases.resize(outputSize);
-    biasGradients.resize(outputSize, 0.0);
+    context.biasGradients.resize(outputSize, T(0));
 
     for (int i = 0; i < outputSize; ++i) {
+        T* w = weights.rowData(i);
         for (int j = 0; j < inputSize; ++j) {
-            weights[i][j] = dis(gen);
+            w[j] = static_cast<T>(dis(gen));
         }
-        biases[i] = 0.0;
+        biases[i] = T(0);
     }
 }
 
-std::vector<double> Layer::forward(const std::vector<double>& inputs) {
-    this->inputs = inputs;
-    outputs.resize(outputSize);
-    std::vector<double> logits(outputSize, 0.0);
-    for (int i = 0; i < outputSize; ++i) {
-        double sum = biases[i];
-        for (int j = 0; j < inputSize; ++j) {
-            sum += weights[i][j] * inputs[j];
-        }
-        logits[i] = sum;
+template <typename T>
+std::vector<T> BasicLayer<T>::forward(Span<const T> inputs) {
+    if (quantization) {
+        outputs.resize(outputSize);
+        forwardQuantized(inputs.data(), 0, 1, outputs.data(), 0);
+        return outputs;
     }
-    if (isSoftmax) {
-        outputs = ActivationFunctions::softmax(logits);
+    this->inputs.assign(inputs.begin(), inputs.end());
+    if (!halfWeights.empty()) {
+        // the weight gradients read the inputs in bfloat16, as in backwardBatch
+        context.halfInputs.resize(1, inputSize);
+        Precision::convert(inputs.data(), context.halfInputs.data(), inputSize);
+    }
+    outputs = biases;
+    if (isSparse()) {
+        Sparse::multiply(1, this->inputs.data(), inputSize, sparseWeights, outputs.data(), outputSize);
+    } else if (!halfWeights.empty()) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::Yes, 1, outputSize, inputSize,
+                   T(1), this->inputs.data(), inputSize, halfWeights.data(), halfWeights.stride(),
+                   T(1), outputs.data(), outputSize);
     } else {
-        for (int i = 0; i < outputSize; ++i) {
-            outputs[i] = activation(logits[i]);
-        }
+        Gemm::gemv(Gemm::Transpose::No, outputSize, inputSize,
+                   T(1), weights.data(), weights.stride(),
+                   this->inputs.data(), T(1), outputs.data());
     }
+    activate(outputs.data(), outputSize);
     return outputs;
 }
 
-std::vector<double> Layer::backward(const std::vector<double>& gradients) {
-    std::vector<double> inputGradients(inputSize, 0.0);
-    if (isSoftmax) {
-        const std::vector<double>& delta = gradients;
+template <typename T>
+void BasicLayer<T>::forward(Span<const T> inputs, Span<T> outputs) const {
+    if (quantization) {
+        forwardQuantized(inputs.data(), 0, 1, outputs.data(), 0);
+        return;
+    }
+    std::copy(biases.begin(), biases.end(), outputs.begin());
+    if (isSparse()) {
+        Sparse::multiply(1, inputs.data(), inputSize, sparseWeights, outputs.data(), outputSize);
+    } else if (!halfWeights.empty()) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::Yes, 1, outputSize, inputSize,
+                   T(1), inputs.data(), inputSize, halfWeights.data(), halfWeights.stride(),
+                   T(1), outputs.data(), outputSize);
+    } else {
+        Gemm::gemv(Gemm::Transpose::No, outputSize, inputSize,
+                   T(1), weights.data(), weights.stride(),
+                   inputs.data(), T(1), outputs.data());
+    }
+    activate(outputs.data(), outputSize);
+}
+
+template <typename T>
+const std::vector<T>& BasicLayer<T>::backward(const std::vector<T>& gradients) {
+    checkTrainable();
+    delta.resize(outputSize);
+    activationBackward(gradients.data(), outputs.data(), delta.data(), outputSize);
+
+    inputGradients.resize(inputSize);
+    context.biasGradients.assign(delta.begin(), delta.end());
+    if (isSparse()) {
+        context.weightGradients.resize(1, sparseWeights.nonZeros());
+        Sparse::multiplyTransposed(1, delta.data(), outputSize, sparseWeights, inputGradients.data(), inputSize);
+        Sparse::gradients(1, T(1), delta.data(), outputSize, inputs.data(), inputSize, sparseWeights,
+                          context.weightGradients.data());
+        return inputGradients;
+    }
+    context.weightGradients.resize(outputSize, inputSize);
+    // input gradients: W^T * delta, from the bfloat16 weights the forward
+    // pass used when mixed precision is on, as in backwardBatch
+    if (!halfWeights.empty()) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, 1, inputSize, outputSize,
+                   T(1), delta.data(), outputSize, halfWeights.data(), halfWeights.stride(),
+                   T(0), inputGradients.data(), inputSize);
+    } else {
+        Gemm::gemv(Gemm::Transpose::Yes, outputSize, inputSize,
+                   T(1), weights.data(), weights.stride(),
+                   delta.data(), T(0), inputGradients.data());
+    }
+    sampleWeightGradients(delta.data(), context.weightGradients);
+    return inputGradients;
+}
+
+template <typename T>
+const Matrix<T>& BasicLayer<T>::forwardBatch(const Matrix<T>& inputs) {
+    return forwardBatch(inputs, context);
+}
+
+template <typename T>
+const Matrix<T>& BasicLayer<T>::backwardBatch(const Matrix<T>& gradients) {
+    return backwardBatch(gradients, context, T(1) / static_cast<T>(gradients.rows()));
+}
+
+template <typename T>
+const Matrix<T>& BasicLayer<T>::forwardBatch(const Matrix<T>& inputs, Context& context) const {
+    if (!halfWeights.empty()) {
+        roundRows(inputs, context.halfInputs);
+    } else {
+        context.inputs = inputs;
+    }
+    forwardBatch(inputs, context.outputs);
+    return context.outputs;
+}
+
+template <typename T>
+void BasicLayer<T>::forwardBatch(const Matrix<T>& inputs, Matrix<T>& batchOutputs) const {
+    const size_t batchSize = inputs.rows();
+    batchOutputs.resize(batchSize, outputSize);
+    if (quantization) {
+        forwardQuantized(inputs.data(), inputs.stride(), batchSize, batchOutputs.data(), batchOutputs.stride());
+        return;
+    }
+    for (size_t b = 0; b < batchSize; ++b) {
+        std::copy(biases.begin(), biases.end(), batchOutputs.rowData(b));
+    }
+    // logits: X * W^T + b
+    if (isSparse()) {
+        Sparse::multiply(batchSize, inputs.data(), inputs.stride(), sparseWeights,
+                         batchOutputs.data(), batchOutputs.stride());
+    } else if (!halfWeights.empty()) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::Yes, batchSize, outputSize, inputSize,
+                   T(1), inputs.data(), inputs.stride(), halfWeights.data(), halfWeights.stride(),
+                   T(1), batchOutputs.data(), batchOutputs.stride());
+    } else {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::Yes, batchSize, outputSize, inputSize,
+                   T(1), inputs.data(), inputs.stride(), weights.data(), weights.stride(),
+                   T(1), batchOutputs.data(), batchOutputs.stride());
+    }
+    for (size_t b = 0; b < batchSize; ++b) {
+        activate(batchOutputs.rowData(b), outputSize);
+    }
+}
+
+template <typename T>
+const Matrix<T>& BasicLayer<T>::backwardBatch(const Matrix<T>& gradients, Context& context, T scale,
+                                              bool propagate) const {
+    checkTrainable();
+    const size_t batchSize = gradients.rows();
+    Matrix<T>& batchDeltas = context.deltas;
+    Matrix<T>& batchInputGradients = context.inputGradients;
+    std::vector<T>& biasGradients = context.biasGradients;
+
+    batchDeltas.resize(batchSize, outputSize);
+    biasGradients.assign(outputSize, T(0));
+    for (size_t b = 0; b < batchSize; ++b) {
+        T* d = batchDeltas.rowData(b);
+        activationBackward(gradients.rowData(b), context.outputs.rowData(b), d, outputSize);
         for (int i = 0; i < outputSize; ++i) {
-            for (int j = 0; j < inputSize; ++j) {
-                inputGradients[j] += weights[i][j] * delta[i];
-                weightsGradients[i][j] = delta[i] * inputs[j];
-            }
-            biasGradients[i] = delta[i];
+            biasGradients[i] += d[i];
+        }
+    }
+    for (T& gb : biasGradients) {
+        gb *= scale;
+    }
+
+    if (isSparse()) {
+        if (propagate) {
+            batchInputGradients.resize(batchSize, inputSize);
+            Sparse::multiplyTransposed(batchSize, batchDeltas.data(), batchDeltas.stride(), sparseWeights,
+                                       batchInputGradients.data(), batchInputGradients.stride());
+        } else {
+            batchInputGradients.resize(0, 0);
+        }
+        context.weightGradients.resize(1, sparseWeights.nonZeros());
+        Sparse::gradients(batchSize, scale, batchDeltas.data(), batchDeltas.stride(),
+                          context.inputs.data(), context.inputs.stride(), sparseWeights,
+                          context.weightGradients.data());
+        return batchInputGradients;
+    }
+
+    context.weightGradients.resize(outputSize, inputSize);
+    const bool mixed = !halfWeights.empty();
+    // input gradients: D * W
+    if (propagate) {
+        batchInputGradients.resize(batchSize, inputSize);
+        if (mixed) {
+            Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, batchSize, inputSize, outputSize,
+                       T(1), batchDeltas.data(), batchDeltas.stride(), halfWeights.data(), halfWeights.stride(),
+                       T(0), batchInputGradients.data(), batchInputGradients.stride());
+        } else {
+            Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, batchSize, inputSize, outputSize,
+                       T(1), batchDeltas.data(), batchDeltas.stride(), weights.data(), weights.stride(),
+                       T(0), batchInputGradients.data(), batchInputGradients.stride());
         }
     } else {
-        for (int i = 0; i < outputSize; ++i) {
-            double activationGrad = activationDerivative(outputs[i]);
-            double delta = gradients[i] * activationGrad;
+        batchInputGradients.resize(0, 0);
+    }
+    // weight gradients: scale * D^T * X
+    if (mixed) {
+        Gemm::gemm(Gemm::Transpose::Yes, Gemm::Transpose::No, outputSize, inputSize, batchSize,
+                   scale, batchDeltas.data(), batchDeltas.stride(),
+                   context.halfInputs.data(), context.halfInputs.stride(),
+                   T(0), context.weightGradients.data(), context.weightGradients.stride());
+    } else {
+        Gemm::gemm(Gemm::Transpose::Yes, Gemm::Transpose::No, outputSize, inputSize, batchSize,
+                   scale, batchDeltas.data(), batchDeltas.stride(), context.inputs.data(), context.inputs.stride(),
+                   T(0), context.weightGradients.data(), context.weightGradients.stride());
+    }
+    return batchInputGradients;
+}
+
+template <typename T>
+Matrix<T> BasicLayer<T>::computeWeightGradients(const std::vector<T>& gradients) {
+    checkTrainable();
+    std::vector<T> delta(outputSize);
+    activationBackward(gradients.data(), outputs.data(), delta.data(), outputSize);
+    if (isSparse()) {
+        Matrix<T> weightGradients(1, sparseWeights.nonZeros(), T(0));
+        Sparse::gradients(1, T(1), delta.data(), outputSize, inputs.data(), inputSize, sparseWeights,
+                          weightGradients.data());
+        return weightGradients;
+    }
+    Matrix<T> weightGradients(outputSize, inputSize, T(0));
+    sampleWeightGradients(delta.data(), weightGradients);
+    return weightGradients;
+}
 
-            for (int j = 0; j < inputSize; ++j) {
-                inputGradients[j] += weights[i][j] * delta;
+template <typename T>
+void BasicLayer<T>::sampleWeightGradients(const T* delta, Matrix<T>& weightGradients) const {
+    // delta * x^T
+    if (!halfWeights.empty()) {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, outputSize, inputSize, 1,
+                   T(1), delta, 1, context.halfInputs.data(), context.halfInputs.stride(),
+                   T(0), weightGradients.data(), weightGradients.stride());
+    } else {
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::No, outputSize, inputSize, 1,
+                   T(1), delta, 1, inputs.data(), inputSize,
+                   T(0), weightGradients.data(), weightGradients.stride());
+    }
+}
+
+template <typename T>
+std::vector<T> BasicLayer<T>::computeBiasGradients(const std::vector<T>& gradients) {
+    checkTrainable();
+    std::vector<T> biasGradients(outputSize, T(0));
+    activationBackward(gradients.data(), outputs.data(), biasGradients.data(), outputSize);
+    return biasGradients;
+}
+
+template <typename T>
+void BasicLayer<T>::activate(T* y, size_t n) const {
+    using ActivationFunctions::Kind;
+    switch (kind) {
+        case Kind::Linear:
+            break;
+        case Kind::Relu:
+            ActivationFunctions::reluInPlace(y, n);
+            break;
+        case Kind::Sigmoid:
+            ActivationFunctions::sigmoidInPlace(y, n);
+            break;
+        case Kind::Softmax:
+            ActivationFunctions::softmaxInPlace(y, n);
+            break;
+        case Kind::Custom:
+            for (size_t i = 0; i < n; ++i) {
+                y[i] = activation(y[i]);
             }
+            break;
+    }
+}
 
-            for (int j = 0; j < inputSize; ++j) {
-                weightsGradients[i][j] = delta * inputs[j];
+template <typename T>
+void BasicLayer<T>::activationBackward(const T* g, const T* y, T* d, size_t n) const {
+    using ActivationFunctions::Kind;
+    switch (kind) {
+        case Kind::Linear:
+        case Kind::Softmax: // paired with cross-entropy, whose derivative already is dL/dz
+            std::copy(g, g + n, d);
+            break;
+        case Kind::Relu:
+            ActivationFunctions::reluBackward(g, y, d, n);
+            break;
+        case Kind::Sigmoid:
+            ActivationFunctions::sigmoidBackward(g, y, d, n);
+            break;
+        case Kind::Custom:
+            for (size_t i = 0; i < n; ++i) {
+                d[i] = g[i] * activationDerivative(y[i]);
             }
+            break;
+    }
+}
+
+template <typename T>
+void BasicLayer<T>::quantize(const Matrix<T>& calibration) {
+    if (quantization) {
+        throw std::logic_error("Layer is already quantized");
+    }
+    if (isSparse()) {
+        throw std::logic_error("Sparse layers cannot be quantized");
+    }
+    if (calibration.cols() != static_cast<size_t>(inputSize)) {
+        throw std::invalid_argument("Calibration inputs do not match the layer");
+    }
+    if (calibration.rows() == 0) {
+        throw std::invalid_argument("Calibration needs at least one row");
+    }
+    // 255 * 127 per term: 2^16 terms keep the int32 sums exact
+    if (Matrix<int8_t>::paddedStride(inputSize) >= (size_t(1) << 16)) {
+        throw std::invalid_argument("Layer is too wide to quantize");
+    }
 
-            biasGradients[i] = delta;
+    auto q = std::make_shared<Quantization>();
+    T low = T(0), high = T(0);
+    for (size_t r = 0; r < calibration.rows(); ++r) {
+        const T* x = calibration.rowData(r);
+        for (int i = 0; i < inputSize; ++i) {
+            low = std::min(low, x[i]);
+            high = std::max(high, x[i]);
         }
     }
-    return inputGradients;
+    q->zeroPoint = low < T(0) ? 128 : 0;
+    const T step = q->zeroPoint ? std::max(-low, high) / T(127) : high / T(255);
+    q->inputScale = step > T(0) ? step : T(1);
+
+    Matrix<int8_t> quantizedWeights(outputSize, inputSize);
+    q->scales.resize(outputSize);
+    q->offsets.resize(outputSize);
+    for (int o = 0; o < outputSize; ++o) {
+        const T* w = weights.rowData(o);
+        T largest = T(0);
+        for (int i = 0; i < inputSize; ++i) {
+            largest = std::max(largest, std::abs(w[i]));
+        }
+        const T scale = largest > T(0) ? largest / T(127) : T(1);
+        int8_t* qw = quantizedWeights.rowData(o);
+        int32_t sum = 0;
+        for (int i = 0; i < inputSize; ++i) {
+            qw[i] = static_cast<int8_t>(std::lround(w[i] / scale));
+            sum += qw[i];
+        }
+        q->scales[o] = q->inputScale * scale;
+        q->offsets[o] = q->zeroPoint * sum;
+    }
+    q->weights.resize(1, Gemm::packedS8Size(outputSize, inputSize));
+    Gemm::packS8(outputSize, inputSize, quantizedWeights.data(), quantizedWeights.stride(), q->weights.data());
+
+    quantization = std::move(q);
+    weights = Matrix<T>();
+    halfWeights = Matrix<BFloat16>();
+    pruningMask = Matrix<T>();
+    context = Context();
+    inputs = std::vector<T>();
+    outputs = std::vector<T>();
+    delta = std::vector<T>();
+    inputGradients = std::vector<T>();
 }
 
-std::vector<std::vector<double>> Layer::computeWeightGradients(const std::vector<double>& gradients) {
-    std::vector<std::vector<double>> weightGradients(outputSize, std::vector<double>(inputSize, 0.0));
-    if (isSoftmax) {
-        for (int i = 0; i < outputSize; ++i) {
-            double delta = gradients[i];
-            for (int j = 0; j < inputSize; ++j) {
-                weightGradients[i][j] = delta * inputs[j];
+template <typename T>
+bool BasicLayer<T>::isQuantized() const {
+    return quantization != nullptr;
+}
+
+template <typename T>
+void BasicLayer<T>::setMixedPrecision(bool enabled) {
+    checkTrainable();
+    if (enabled && isSparse()) {
+        throw std::logic_error("Sparse layers do not support mixed precision");
+    }
+    if (enabled) {
+        roundRows(weights, halfWeights);
+    } else {
+        halfWeights = Matrix<BFloat16>();
+        context.halfInputs = Matrix<BFloat16>();
+    }
+}
+
+template <typename T>
+bool BasicLayer<T>::isMixedPrecision() const {
+    return !halfWeights.empty();
+}
+
+template <typename T>
+void BasicLayer<T>::refreshMixedPrecision() {
+    if (!halfWeights.empty()) {
+        roundRows(weights, halfWeights);
+    }
+}
+
+template <typename T>
+void BasicLayer<T>::prune(double sparsity) {
+    checkTrainable();
+    if (!(sparsity >= 0.0 && sparsity <= 1.0)) {
+        throw std::invalid_argument("Sparsity must be between 0 and 1");
+    }
+    const size_t total = static_cast<size_t>(inputSize) * outputSize;
+    const size_t target = static_cast<size_t>(sparsity * static_cast<double>(total));
+    std::vector<size_t> order;
+
+    if (isSparse()) {
+        std::vector<T>& values = sparseWeights.values;
+        const size_t zeros = total - values.size();
+        if (target <= zeros) return;
+        smallestMagnitudes(values.data(), values.size(), target - zeros, order);
+        std::vector<bool> pruned(values.size(), false);
+        for (size_t k : order) pruned[k] = true;
+        // compact the surviving nonzeros in place, row by row
+        size_t kept = 0;
+        for (size_t r = 0; r < sparseWeights.rows; ++r) {
+            const size_t begin = sparseWeights.rowStart[r];
+            const size_t end = sparseWeights.rowStart[r + 1];
+            sparseWeights.rowStart[r] = static_cast<uint32_t>(kept);
+            for (size_t k = begin; k < end; ++k) {
+                if (pruned[k]) continue;
+                sparseWeights.columns[kept] = sparseWeights.columns[k];
+                values[kept] = values[k];
+                ++kept;
             }
         }
+        sparseWeights.rowStart[sparseWeights.rows] = static_cast<uint32_t>(kept);
+        sparseWeights.columns.resize(kept);
+        values.resize(kept);
+        return;
+    }
+
+    if (target == 0) return;
+    // pruned weights are already zero, so they are picked again first
+    std::vector<T> magnitudes(total);
+    for (int o = 0; o < outputSize; ++o) {
+        std::copy(weights.rowData(o), weights.rowData(o) + inputSize, magnitudes.data() + o * inputSize);
+    }
+    smallestMagnitudes(magnitudes.data(), total, target, order);
+    if (pruningMask.empty()) {
+        pruningMask.resize(outputSize, inputSize, T(1));
+    }
+    for (size_t k : order) {
+        const size_t o = k / inputSize;
+        const size_t i = k % inputSize;
+        weights(o, i) = T(0);
+        pruningMask(o, i) = T(0);
+    }
+    refreshMixedPrecision();
+}
+
+template <typename T>
+void BasicLayer<T>::applyPruningMask() {
+    if (pruningMask.empty()) return;
+    // same shape, so the padded layouts line up
+    T* w = weights.data();
+    const T* m = pruningMask.data();
+    const size_t n = weights.capacity();
+    for (size_t k = 0; k < n; ++k) {
+        w[k] *= m[k];
+    }
+}
+
+template <typename T>
+void BasicLayer<T>::maskGradients(Matrix<T>& weightGradients) const {
+    if (pruningMask.empty()) return;
+    T* g = weightGradients.data();
+    const T* m = pruningMask.data();
+    const size_t n = pruningMask.capacity();
+    for (size_t k = 0; k < n; ++k) {
+        g[k] *= m[k];
+    }
+}
+
+template <typename T>
+void BasicLayer<T>::sparsify() {
+    checkTrainable();
+    if (isSparse()) return;
+    if (!halfWeights.empty()) {
+        throw std::logic_error("Mixed-precision layers cannot be sparsified");
+    }
+    sparseWeights = Sparse::fromDense(weights);
+    weights = Matrix<T>();
+    pruningMask = Matrix<T>();
+    context.weightGradients = Matrix<T>();
+}
+
+template <typename T>
+bool BasicLayer<T>::isSparse() const {
+    return !sparseWeights.rowStart.empty();
+}
+
+template <typename T>
+double BasicLayer<T>::getSparsity() const {
+    const size_t total = static_cast<size_t>(inputSize) * outputSize;
+    if (total == 0 || quantization) return 0.0;
+    size_t zeros = 0;
+    if (isSparse()) {
+        zeros = total - sparseWeights.nonZeros();
     } else {
-        for (int i = 0; i < outputSize; ++i) {
-            double activationGrad = activationDerivative(outputs[i]);
-            double delta = gradients[i] * activationGrad;
-            for (int j = 0; j < inputSize; ++j) {
-                weightGradients[i][j] = delta * inputs[j];
-            }
+        for (int o = 0; o < outputSize; ++o) {
+            const T* w = weights.rowData(o);
+            zeros += static_cast<size_t>(std::count(w, w + inputSize, T(0)));
         }
     }
-    return weightGradients;
+    return static_cast<double>(zeros) / static_cast<double>(total);
 }
 
-std::vector<double> Layer::computeBiasGradients(const std::vector<double>& gradients) {
-    std::vector<double> biasGradients(outputSize, 0.0);
-    if (isSoftmax) {
-        for (int i = 0; i < outputSize; ++i) {
-            biasGradients[i] = gradients[i];
+template <typename T>
+Span<T> BasicLayer<T>::getWeightParameters() {
+    if (isSparse()) {
+        return Span<T>(sparseWeights.values.data(), sparseWeights.values.size());
+    }
+    return Span<T>(weights.data(), weights.capacity());
+}
+
+template <typename T>
+void BasicLayer<T>::forwardQuantized(const T* inputs, size_t inputStride, size_t rows,
+                                     T* outputs, size_t outputStride) const {
+    const Quantization& q = *quantization;
+    // per-thread scratch with dense rows, so concurrent inference needs no
+    // locking; it only grows, to the largest batch of any layer, so layers of
+    // different shapes share it without refilling it
+    thread_local Matrix<uint8_t> quantizedInputs;
+    thread_local Matrix<int32_t> sums;
+    if (quantizedInputs.cols() < rows * inputSize) quantizedInputs.resize(1, rows * inputSize);
+    if (sums.cols() < rows * outputSize) sums.resize(1, rows * outputSize);
+
+    const T inverseScale = T(1) / q.inputScale;
+    const T zeroPoint = T(q.zeroPoint);
+    // a local copy: stores through uint8_t* could alias the member
+    const size_t width = inputSize;
+    for (size_t r = 0; r < rows; ++r) {
+        const T* x = inputs + r * inputStride;
+        uint8_t* qx = quantizedInputs.data() + r * width;
+        for (size_t i = 0; i < width; ++i) {
+            // rounds to nearest by truncating; the selects are written so they
+            // vectorize as min and max
+            T v = x[i] * inverseScale + zeroPoint + T(0.5);
+            v = v > T(0) ? v : T(0);
+            v = v < T(255.5) ? v : T(255);
+            qx[i] = static_cast<uint8_t>(v);
         }
-    } else {
-        for (int i = 0; i < outputSize; ++i) {
-            double activationGrad = activationDerivative(outputs[i]);
-            biasGradients[i] = gradients[i] * activationGrad;
+    }
+    Gemm::gemmU8S8(rows, outputSize, inputSize, quantizedInputs.data(), inputSize,
+                   q.weights.data(), sums.data(), outputSize);
+
+    // dequantize, add the bias and apply a relu in the same pass
+    const bool relu = kind == ActivationFunctions::Kind::Relu;
+    for (size_t r = 0; r < rows; ++r) {
+        const int32_t* sum = sums.data() + r * outputSize;
+        T* y = outputs + r * outputStride;
+        for (int o = 0; o < outputSize; ++o) {
+            const T v = q.scales[o] * static_cast<T>(sum[o] - q.offsets[o]) + biases[o];
+            y[o] = relu && v < T(0) ? T(0) : v;
+        }
+        if (!relu) {
+            activate(y, outputSize);
         }
     }
-    return biasGradients;
 }
 
-int Layer::getInputSize() const {
+template <typename T>
+void BasicLayer<T>::checkTrainable() const {
+    if (quantization) {
+        throw std::logic_error("Quantized layers are inference-only");
+    }
+}
+
+template <typename T>
+int BasicLayer<T>::getInputSize() const {
     return inputSize;
 }
 
-int Layer::getOutputSize() const {
+template <typename T>
+int BasicLayer<T>::getOutputSize() const {
     return outputSize;
 }
 
-std::vector<std::vector<double>>& Layer::getWeights() {
+template <typename T>
+ActivationFunctions::Kind BasicLayer<T>::getActivation() const {
+    return kind;
+}
+
+template <typename T>
+size_t BasicLayer<T>::getParameterBytes() const {
+    const size_t weightCount = static_cast<size_t>(inputSize) * outputSize;
+    if (quantization) {
+        return quantization->weights.cols() * sizeof(int8_t) + biases.size() * sizeof(T) +
+               quantization->scales.size() * sizeof(T) + quantization->offsets.size() * sizeof(int32_t);
+    }
+    if (isSparse()) {
+        return sparseWeights.nonZeros() * (sizeof(T) + sizeof(uint32_t)) +
+               sparseWeights.rowStart.size() * sizeof(uint32_t) + biases.size() * sizeof(T);
+    }
+    return weightCount * sizeof(T) + biases.size() * sizeof(T) +
+           (halfWeights.empty() ? 0 : weightCount * sizeof(BFloat16));
+}
+
+template <typename T>
+Matrix<T>& BasicLayer<T>::getWeights() {
     return weights;
 }
 
-std::vector<double>& Layer::getBiases() {
+template <typename T>
+const Matrix<T>& BasicLayer<T>::getWeights() const {
+    return weights;
+}
+
+template <typename T>
+std::vector<T>& BasicLayer<T>::getBiases() {
     return biases;
 }
 
-const std::vector<std::vector<double>>& Layer::getWeightGradients() const {
-    return weightsGradients;
+template <typename T>
+const std::vector<T>& BasicLayer<T>::getBiases() const {
+    return biases;
 }
 
-const std::vector<double>& Layer::getBiasGradients() const {
-    return biasGradients;
-}
\ No newline at end of file
+template <typename T>
+const Sparse::CsrMatrix<T>& BasicLayer<T>::getSparseWeights() const {
+    return sparseWeights;
+}
+
+template <typename T>
+const Matrix<T>& BasicLayer<T>::getWeightGradients() const {
+    return context.weightGradients;
+}
+
+template <typename T>
+const std::vector<T>& BasicLayer<T>::getBiasGradients() const {
+    return context.biasGradients;
+}
+
+template class BasicLayer<float>;
+template class BasicLayer<double>;
@@ -3,37 +3,112 @@
 
 namespace LossFunction {
 
-    double meanSquaredError(const std::vector<double>& predicted, const std::vector<double>& actual) {
-        double sum = 0.0;
+    template <typename T>
+    T meanSquaredError(const std::vector<T>& predicted, const std::vector<T>& actual) {
+        T sum = T(0);
         for (size_t i = 0; i < predicted.size(); ++i) {
-            double diff = predicted[i] - actual[i];
+            T diff = predicted[i] - actual[i];
             sum += diff * diff;
         }
         return sum / predicted.size();
     }
 
-    std::vector<double> meanSquaredErrorDerivative(const std::vector<double>& predicted, const std::vector<double>& actual) {
-        std::vector<double> derivative(predicted.size());
+    template <typename T>
+    std::vector<T> meanSquaredErrorDerivative(const std::vector<T>& predicted, const std::vector<T>& actual) {
+        std::vector<T> derivative(predicted.size());
         for (size_t i = 0; i < predicted.size(); ++i) {
             derivative[i] = 2 * (predicted[i] - actual[i]) / predicted.size();
         }
         return derivative;
     }
 
-    double crossEntropy(const std::vector<double>& predicted, const std::vector<double>& actual) {
-        double sum = 0.0;
+    template <typename T>
+    T crossEntropy(const std::vector<T>& predicted, const std::vector<T>& actual) {
+        T sum = T(0);
         for (size_t i = 0; i < predicted.size(); ++i) {
-            sum += actual[i] * std::log(predicted[i] + 1e-15); // avoid log(0)
+            sum += actual[i] * std::log(predicted[i] + T(1e-15)); // avoid log(0)
         }
         return -sum;
     }
 
-    std::vector<double> crossEntropyDerivative(const std::vector<double>& predicted, const std::vector<double>& actual) {
-        std::vector<double> derivative(predicted.size());
+    template <typename T>
+    std::vector<T> crossEntropyDerivative(const std::vector<T>& predicted, const std::vector<T>& actual) {
+        std::vector<T> derivative(predicted.size());
         for (size_t i = 0; i < predicted.size(); ++i) {
             derivative[i] = predicted[i] - actual[i];
         }
         return derivative;
     }
 
+    template <typename T>
+    T meanSquaredError(const Matrix<T>& predicted, const Matrix<T>& actual) {
+        T total = T(0);
+        for (size_t r = 0; r < predicted.rows(); ++r) {
+            const T* p = predicted.rowData(r);
+            const T* a = actual.rowData(r);
+            T sum = T(0);
+            for (size_t i = 0; i < predicted.cols(); ++i) {
+                T diff = p[i] - a[i];
+                sum += diff * diff;
+            }
+            total += sum / predicted.cols();
+        }
+        return total;
+    }
+
+    template <typename T>
+    void meanSquaredErrorDerivative(const Matrix<T>& predicted, const Matrix<T>& actual, Matrix<T>& derivative) {
+        derivative.resize(predicted.rows(), predicted.cols());
+        const T scale = T(2) / predicted.cols();
+        for (size_t r = 0; r < predicted.rows(); ++r) {
+            const T* p = predicted.rowData(r);
+            const T* a = actual.rowData(r);
+            T* d = derivative.rowData(r);
+            for (size_t i = 0; i < predicted.cols(); ++i) {
+                d[i] = scale * (p[i] - a[i]);
+            }
+        }
+    }
+
+    template <typename T>
+    T crossEntropy(const Matrix<T>& predicted, const Matrix<T>& actual) {
+        T sum = T(0);
+        for (size_t r = 0; r < predicted.rows(); ++r) {
+            const T* p = predicted.rowData(r);
+            const T* a = actual.rowData(r);
+            for (size_t i = 0; i < predicted.cols(); ++i) {
+                sum += a[i] * std::log(p[i] + T(1e-15)); // avoid log(0)
+            }
+        }
+        return -sum;
+    }
+
+    template <typename T>
+    void crossEntropyDerivative(const Matrix<T>& predicted, const Matrix<T>& actual, Matrix<T>& derivative) {
+        derivative.resize(predicted.rows(), predicted.cols());
+        for (size_t r = 0; r < predicted.rows(); ++r) {
+            const T* p = predicted.rowData(r);
+            const T* a = actual.rowData(r);
+            T* d = derivative.rowData(r);
+            for (size_t i = 0; i < predicted.cols(); ++i) {
+                d[i] = p[i] - a[i];
+            }
+        }
+    }
+
+#define INSTANTIATE_LOSS_FUNCTIONS(T)                                                                      \
+    template T meanSquaredError(const std::vector<T>&, const std::vector<T>&);                             \
+    template std::vector<T> meanSquaredErrorDerivative(const std::vector<T>&, const std::vector<T>&);      \
+    template T crossEntropy(const std::vector<T>&, const std::vector<T>&);                                 \
+    template std::vector<T> crossEntropyDerivative(const std::vector<T>&, const std::vector<T>&);          \
+    template T meanSquaredError(const Matrix<T>&, const Matrix<T>&);                                       \
+    template void meanSquaredErrorDerivative(const Matrix<T>&, const Matrix<T>&, Matrix<T>&);              \
+    template T crossEntropy(const Matrix<T>&, const Matrix<T>&);                                           \
+    template void crossEntropyDerivative(const Matrix<T>&, const Matrix<T>&, Matrix<T>&);
+
+    INSTANTIATE_LOSS_FUNCTIONS(float)
+    INSTANTIATE_LOSS_FUNCTIONS(double)
+
+#undef INSTANTIATE_LOSS_FUNCTIONS
+
 }
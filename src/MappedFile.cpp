@@ -0,0 +1,50 @@
+#include "../include/MappedFile.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + filename + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Could not stat " + filename + ": " + std::strerror(error));
+    }
+    const size_t length = static_cast<size_t>(info.st_size);
+    void* address = nullptr;
+    if (length > 0) {
+        address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Could not map " + filename + ": " + std::strerror(error));
+        }
+    }
+    ::close(fd);
+    return std::shared_ptr<MappedFile>(new MappedFile(address, length));
+}
+
+MappedFile::MappedFile(void* address, size_t length)
+    : address(address), length(length) {}
+
+MappedFile::~MappedFile() {
+    if (address) {
+        ::munmap(address, length);
+    }
+}
+
+char* MappedFile::data() const {
+    return static_cast<char*>(address);
+}
+
+size_t MappedFile::size() const {
+    return length;
+}
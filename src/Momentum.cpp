@@ -1,32 +1,21 @@
 #include "../include/Momentum.h"
 
-Momentum::Momentum(double momentum)
-    : momentum(momentum) {}
+template <typename T>
+BasicMomentum<T>::BasicMomentum(T momentum)
+    : BasicOptimizer<T>(1), momentum(momentum) {}
 
-void Momentum::updateWeights(std::vector<std::vector<double>>& weights,
-                             const std::vector<std::vector<double>>& weightGradients,
-                             double learningRate) {
-    if (weightVelocities.empty()) {
-        weightVelocities.resize(weights.size(), std::vector<double>(weights[0].size(), 0.0));
-    }
-
-    for (size_t i = 0; i < weights.size(); ++i) {
-        for (size_t j = 0; j < weights[i].size(); ++j) {
-            weightVelocities[i][j] = momentum * weightVelocities[i][j] - learningRate * weightGradients[i][j];
-            weights[i][j] += weightVelocities[i][j];
+template <typename T>
+void BasicMomentum<T>::apply(const std::vector<ParameterGroup>& groups, T learningRate) {
+    for (size_t k = 0; k < groups.size(); ++k) {
+        T* __restrict w = groups[k].values;
+        T* __restrict v = this->state(0, k);
+        const T* __restrict g = groups[k].gradients;
+        for (size_t i = 0; i < groups[k].size; ++i) {
+            v[i] = momentum * v[i] - learningRate * g[i];
+            w[i] += v[i];
         }
     }
 }
 
-void Momentum::updateBiases(std::vector<double>& biases,
-                             const std::vector<double>& biasGradients,
-                             double learningRate) {
-    if (biasVelocities.empty()) {
-        biasVelocities.resize(biases.size(), 0.0);
-    }
-
-    for (size_t i = 0; i < biases.size(); ++i) {
-        biasVelocities[i] = momentum * biasVelocities[i] - learningRate * biasGradients[i];
-        biases[i] += biasVelocities[i];
-    }
-}
+template class BasicMomentum<float>;
+template class BasicMomentum<double>;
@@ -3,19 +3,125 @@
 #include "SGD.h"
 #include "Momentum.h"
 #include "Adam.h"
+#include "MappedFile.h"
 #include <iostream>
+#include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <atomic>
+#include <numeric>
 
-NeuralNetwork::NeuralNetwork() {
+namespace {
+
+    // Model file layout (host byte order):
+    //   ModelHeader | LayerRecord[layerCount] | per layer, 64-byte aligned:
+    //   weights (rows * padded stride) and biases | optional OptimizerRecord,
+    //   its group sizes and, 64-byte aligned, the state matrix.
+    constexpr char ModelMagic[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+    constexpr uint32_t ModelVersion = 1;
+    constexpr size_t ModelAlignment = 64;
+
+    // index 0 means "not set"; the indices are stored in model files
+    const char* const LossNames[] = {"", "crossEntropy", "meanSquaredError"};
+    const char* const OptimizerNames[] = {"", "SGD", "Momentum", "Adam"};
+
+    struct ModelHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t scalarBytes;
+        uint32_t layerCount;
+        uint32_t loss;
+        uint32_t optimizer;
+        uint32_t reserved;
+        uint64_t optimizerStateOffset; // 0 when the state was not saved
+        uint64_t fileSize;
+    };
+
+    struct LayerRecord {
+        uint32_t inputSize;
+        uint32_t outputSize;
+        uint32_t activation;
+        uint32_t stride;
+        uint64_t weightsOffset;
+        uint64_t biasesOffset;
+    };
+
+    struct OptimizerRecord {
+        uint64_t groupCount;
+        uint64_t slots;
+        uint64_t columns;
+        int64_t steps;
+        uint64_t stateOffset;
+    };
+
+    template <size_t N>
+    uint32_t nameIndex(const char* const (&names)[N], const std::string& name) {
+        for (size_t i = 0; i < N; ++i) {
+            if (name == names[i]) return static_cast<uint32_t>(i);
+        }
+        return 0;
+    }
+
+    uint64_t alignUp(uint64_t offset) {
+        return (offset + ModelAlignment - 1) / ModelAlignment * ModelAlignment;
+    }
+
+    class ModelWriter {
+    public:
+        explicit ModelWriter(const std::string& filename)
+            : filename(filename), out(filename, std::ios::binary | std::ios::trunc) {
+            if (!out) {
+                throw std::runtime_error("Could not open " + filename + " for writing");
+            }
+        }
+
+        uint64_t position() const { return written; }
+
+        void write(const void* data, size_t bytes) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            written += bytes;
+        }
+
+        void align() {
+            static const char zeros[ModelAlignment] = {};
+            write(zeros, alignUp(written) - written);
+        }
+
+        void overwrite(uint64_t offset, const void* data, size_t bytes) {
+            out.seekp(static_cast<std::streamoff>(offset));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+            out.seekp(static_cast<std::streamoff>(written));
+        }
+
+        void finish() {
+            out.flush();
+            if (!out) {
+                throw std::runtime_error("Failed to write model to " + filename);
+            }
+        }
+
+    private:
+        std::string filename;
+        std::ofstream out;
+        uint64_t written = 0;
+    };
+
+}
+
+template <typename T>
+BasicNeuralNetwork<T>::BasicNeuralNetwork() {
 }
 
-NeuralNetwork::NeuralNetwork(const std::vector<int>& layerSizes,
-                             const std::string& activationFunction,
-                             const std::string& lossFunction,
-                             const std::string& optimizer,
-                             unsigned int seed)
-    : NeuralNetwork(
+template <typename T>
+BasicNeuralNetwork<T>::BasicNeuralNetwork(const std::vector<int>& layerSizes,
+                                          const std::string& activationFunction,
+                                          const std::string& lossFunction,
+                                          const std::string& optimizer,
+                                          unsigned int seed)
+    : BasicNeuralNetwork(
         layerSizes,
         activationFunction == "softmax" ? std::string("relu") : activationFunction,
         activationFunction == "softmax" ? std::string("softmax") : activationFunction,
@@ -23,56 +129,23 @@ NeuralNetwork::NeuralNetwork(const std::vector<int>& layerSizes,
         optimizer,
         seed) {}
 
-NeuralNetwork::NeuralNetwork(const std::vector<int>& layerSizes,
-                             const std::string& hiddenAct,
-                             const std::string& outputAct,
-                             const std::string& lossFunction,
-                             const std::string& optimizer,
-                             unsigned int seed) {
-
-    auto makeHidden = [&](int in, int out, unsigned int seed) {
-        if (hiddenAct == "relu") {
-            return std::make_unique<Layer>(in, out,
-                [](double x) { return ActivationFunctions::relu(x); },
-                [](double x) { return ActivationFunctions::reluDerivative(x); },
-                std::string("relu"),
-                seed);
-        } else if (hiddenAct == "sigmoid") {
-            return std::make_unique<Layer>(in, out,
-                [](double x) { return ActivationFunctions::sigmoid(x); },
-                [](double y) { return ActivationFunctions::sigmoidDerivative(y); },
-                std::string("sigmoid"),
-                seed);
-        } else {
-            throw std::invalid_argument("Unsupported hidden activation: " + hiddenAct);
-        }
-    };
+template <typename T>
+BasicNeuralNetwork<T>::BasicNeuralNetwork(const std::vector<int>& layerSizes,
+                                          const std::string& hiddenAct,
+                                          const std::string& outputAct,
+                                          const std::string& lossFunction,
+                                          const std::string& optimizer,
+                                          unsigned int seed) {
 
-    auto makeOutput = [&](int in, int out, unsigned int seed) {
-        if (outputAct == "softmax") {
-            return std::make_unique<Layer>(in, out, true, seed);
-        } else if (outputAct == "relu") {
-            return std::make_unique<Layer>(in, out,
-                [](double x) { return ActivationFunctions::relu(x); },
-                [](double x) { return ActivationFunctions::reluDerivative(x); },
-                std::string("relu"),
-                seed);
-        } else if (outputAct == "sigmoid") {
-            return std::make_unique<Layer>(in, out,
-                [](double x) { return ActivationFunctions::sigmoid(x); },
-                [](double y) { return ActivationFunctions::sigmoidDerivative(y); },
-                std::string("sigmoid"),
-                seed);
-        } else if (outputAct == "linear") {
-            return std::make_unique<Layer>(in, out,
-                [](double x) { return x; },
-                [](double /*y*/) { return 1.0; },
-                std::string("linear"),
-                seed);
-        } else {
-            throw std::invalid_argument("Unsupported output activation: " + outputAct);
-        }
-    };
+    using ActivationFunctions::Kind;
+    const Kind hiddenKind = ActivationFunctions::kindFromName(hiddenAct);
+    const Kind outputKind = ActivationFunctions::kindFromName(outputAct);
+    if (hiddenKind != Kind::Relu && hiddenKind != Kind::Sigmoid) {
+        throw std::invalid_argument("Unsupported hidden activation: " + hiddenAct);
+    }
+    if (outputKind == Kind::Custom) {
+        throw std::invalid_argument("Unsupported output activation: " + outputAct);
+    }
 
     if (outputAct == "softmax" && lossFunction != std::string("crossEntropy")) {
         std::cerr << "Warning: using softmax output with non-crossEntropy loss.\n";
@@ -81,130 +154,930 @@ NeuralNetwork::NeuralNetwork(const std::vector<int>& layerSizes,
     for (size_t i = 1; i < layerSizes.size(); ++i) {
         unsigned int layerSeed = (seed == 0) ? 0 : seed + static_cast<unsigned int>(i);
         bool isLast = (i == layerSizes.size() - 1);
-        if (isLast) {
-            layers.push_back(makeOutput(layerSizes[i - 1], layerSizes[i], layerSeed));
-        } else {
-            layers.push_back(makeHidden(layerSizes[i - 1], layerSizes[i], layerSeed));
+        layers.push_back(std::make_unique<BasicLayer<T>>(layerSizes[i - 1], layerSizes[i],
+                                                         isLast ? outputKind : hiddenKind, layerSeed));
+    }
+
+    setLossFunction(lossFunction);
+    setOptimizer(optimizer);
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setLossFunction(const std::string& name) {
+    using Vec = std::vector<T>;
+    using Mat = Matrix<T>;
+    if (name == "crossEntropy") {
+        this->lossFunction = static_cast<T (*)(const Vec&, const Vec&)>(LossFunction::crossEntropy);
+        this->lossDerivative = static_cast<Vec (*)(const Vec&, const Vec&)>(LossFunction::crossEntropyDerivative);
+        this->batchLossFunction = static_cast<T (*)(const Mat&, const Mat&)>(LossFunction::crossEntropy);
+        this->batchLossDerivative = static_cast<void (*)(const Mat&, const Mat&, Mat&)>(LossFunction::crossEntropyDerivative);
+    } else if (name == "meanSquaredError") {
+        this->lossFunction = static_cast<T (*)(const Vec&, const Vec&)>(LossFunction::meanSquaredError);
+        this->lossDerivative = static_cast<Vec (*)(const Vec&, const Vec&)>(LossFunction::meanSquaredErrorDerivative);
+        this->batchLossFunction = static_cast<T (*)(const Mat&, const Mat&)>(LossFunction::meanSquaredError);
+        this->batchLossDerivative = static_cast<void (*)(const Mat&, const Mat&, Mat&)>(LossFunction::meanSquaredErrorDerivative);
+    } else {
+        return;
+    }
+    lossName = name;
+}
+
+namespace {
+
+    template <typename T>
+    std::unique_ptr<BasicOptimizer<T>> makeOptimizer(const std::string& name) {
+        if (name == "SGD") {
+            return std::make_unique<BasicSGD<T>>();
+        } else if (name == "Momentum") {
+            return std::make_unique<BasicMomentum<T>>(T(0.9));
+        } else if (name == "Adam") {
+            return std::make_unique<BasicAdam<T>>(T(0.9), T(0.999), T(1e-8));
+        }
+        throw std::invalid_argument("Unsupported optimizer: " + name);
+    }
+
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setOptimizer(const std::string& name) {
+    this->optimizer = makeOptimizer<T>(name);
+    optimizerName = name;
+}
+
+namespace {
+
+    void checkRows(const std::vector<size_t>& rows, size_t samples) {
+        for (size_t row : rows) {
+            if (row >= samples) {
+                throw std::invalid_argument("Row index " + std::to_string(row) + " is out of range.");
+            }
         }
     }
 
-    if (lossFunction == "crossEntropy") {
-        this->lossFunction = LossFunction::crossEntropy;
-        this->lossDerivative = LossFunction::crossEntropyDerivative;
-    } else if (lossFunction == "meanSquaredError") {
-        this->lossFunction = LossFunction::meanSquaredError;
-        this->lossDerivative = LossFunction::meanSquaredErrorDerivative;
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::train(const Matrix<T>& inputs,
+                                  const Matrix<T>& targets,
+                                  int epochs, T learningRate,
+                                  int batchSize) {
+    if (inputs.rows() != targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples.");
     }
+    trainRows(inputs, targets, nullptr, inputs.rows(), epochs, learningRate, batchSize);
+}
 
-    if (optimizer == "SGD") {
-        this->optimizer = std::make_unique<SGD>();
-    } else if (optimizer == "Momentum") {
-        this->optimizer = std::make_unique<Momentum>(0.9);
-    } else if (optimizer == "Adam") {
-        this->optimizer = std::make_unique<Adam>(0.9, 0.999, 1e-8);
-    } else {
-        throw std::invalid_argument("Unsupported optimizer: " + optimizer);
+template <typename T>
+void BasicNeuralNetwork<T>::train(const Matrix<T>& inputs,
+                                  const Matrix<T>& targets,
+                                  const std::vector<size_t>& rows,
+                                  int epochs, T learningRate,
+                                  int batchSize) {
+    if (inputs.rows() != targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples.");
     }
+    checkRows(rows, inputs.rows());
+    trainRows(inputs, targets, rows.data(), rows.size(), epochs, learningRate, batchSize);
 }
 
-void NeuralNetwork::train(const std::vector<std::vector<double>>& inputs,
-                          const std::vector<std::vector<double>>& targets,
-                          int epochs, double learningRate) {
-    
+template <typename T>
+void BasicNeuralNetwork<T>::train(BasicDataPipeline<T>& pipeline, int epochs, T learningRate) {
+    checkTrainable();
+    const size_t batches = pipeline.batchesPerEpoch();
     for (int epoch = 0; epoch < epochs; ++epoch) {
-        double totalLoss = 0.0;
+        beginEpoch();
+        T totalLoss = T(0);
+        for (size_t b = 0; b < batches; ++b) {
+            const typename BasicDataPipeline<T>::Batch* batch;
+            {
+                Telemetry::ScopedTimer timer(metricsSink ? &metrics.times[Telemetry::Phase::Data] : nullptr);
+                batch = &pipeline.next();
+            }
+            totalLoss += trainBatch(batch->inputs, batch->targets, nullptr, 0, batch->inputs.rows(), learningRate);
+        }
+        pruneEpoch(epoch);
+        endEpoch(epoch, totalLoss, pipeline.samples(), batches);
+    }
+    if (metricsSink) metricsSink->flush();
+}
 
-        for (size_t i = 0; i < inputs.size(); ++i) {
-            std::vector<double> output = inputs[i];
-            for (auto& layer : layers) {
-                output = layer->forward(output);
+template <typename T>
+void BasicNeuralNetwork<T>::trainRows(const Matrix<T>& inputs, const Matrix<T>& targets,
+                                      const size_t* rows, size_t samples,
+                                      int epochs, T learningRate, int batchSize) {
+    if (batchSize < 1) {
+        throw std::invalid_argument("Batch size must be at least 1.");
+    }
+    checkTrainable();
+    if (asynchronous && mixedPrecision) {
+        throw std::logic_error("Asynchronous training does not support mixed precision.");
+    }
+
+    const size_t batches = (samples + batchSize - 1) / batchSize;
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        beginEpoch();
+        T totalLoss = T(0);
+
+        if (asynchronous) {
+            totalLoss = trainAsynchronous(inputs, targets, rows, samples, learningRate, batchSize);
+        } else {
+            for (size_t start = 0; start < samples; start += batchSize) {
+                const size_t count = std::min(static_cast<size_t>(batchSize), samples - start);
+                totalLoss += trainBatch(inputs, targets, rows, start, count, learningRate);
             }
+        }
+        pruneEpoch(epoch);
+
+        endEpoch(epoch, totalLoss, samples, batches);
+    }
+    if (metricsSink) metricsSink->flush();
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::checkTrainable() const {
+    for (const auto& layer : layers) {
+        if (layer->isQuantized()) {
+            throw std::logic_error("Quantized networks are inference-only.");
+        }
+    }
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::pruneEpoch(int epoch) {
+    const PruningSchedule& schedule = pruningSchedule;
+    if (schedule.sparsity <= 0.0 || epoch < schedule.startEpoch || epoch > schedule.endEpoch) return;
+    const double progress = static_cast<double>(epoch - schedule.startEpoch + 1) /
+                            static_cast<double>(schedule.endEpoch - schedule.startEpoch + 1);
+    const double remaining = 1.0 - progress;
+    prune(schedule.sparsity * (1.0 - remaining * remaining * remaining));
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::beginEpoch() {
+    if (!metricsSink) return;
+    metrics.times.resize(layers.size());
+    metrics.times.clear();
+    for (Worker& worker : workers) {
+        worker.times.clear();
+    }
+    allocationsAtEpochStart = matrixAllocationCount().load(std::memory_order_relaxed);
+    epochStart = std::chrono::steady_clock::now();
+}
 
-            totalLoss += lossFunction(output, targets[i]);
-            std::vector<double> gradients = lossDerivative(output, targets[i]);
+template <typename T>
+void BasicNeuralNetwork<T>::endEpoch(int epoch, T totalLoss, size_t samples, size_t batches) {
+    if (!metricsSink) return;
+    using Telemetry::Phase;
+    metrics.epoch = epoch;
+    metrics.loss = static_cast<double>(totalLoss) / samples;
+    metrics.samples = samples;
+    metrics.batches = batches;
+    metrics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - epochStart).count();
+    metrics.samplesPerSecond = metrics.seconds > 0 ? samples / metrics.seconds : 0.0;
+    metrics.allocations = matrixAllocationCount().load(std::memory_order_relaxed) - allocationsAtEpochStart;
 
-            for (auto it = layers.rbegin(); it != layers.rend(); ++it) {
-                auto weightGradients = (*it)->computeWeightGradients(gradients);
-                optimizer->updateWeights((*it)->getWeights(), weightGradients, learningRate);
+    for (const Worker& worker : workers) {
+        metrics.times.add(worker.times);
+    }
+    double flopsPerSample = 0.0;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const double multiplyAdds = 2.0 * layers[i]->getInputSize() * layers[i]->getOutputSize();
+        // backward: weight gradients, plus input gradients past the first layer
+        flopsPerSample += multiplyAdds * (i == 0 ? 2.0 : 3.0);
+        metrics.times[Phase::Forward] += metrics.times.layerForward[i];
+        metrics.times[Phase::Backward] += metrics.times.layerBackward[i];
+    }
+    metrics.flops = flopsPerSample * samples;
+    metrics.flopsPerSecond = metrics.seconds > 0 ? metrics.flops / metrics.seconds : 0.0;
+    metricsSink->epoch(metrics);
+}
 
-                auto biasGradients = (*it)->computeBiasGradients(gradients);
-                optimizer->updateBiases((*it)->getBiases(), biasGradients, learningRate);
+template <typename T>
+T BasicNeuralNetwork<T>::trainBatch(const Matrix<T>& inputs, const Matrix<T>& targets,
+                                    const size_t* rows, size_t start, size_t count, T learningRate) {
+    const size_t threads = pool ? pool->size() : 1;
+    const size_t shards = std::min(threads, count);
+    if (workers.size() < shards) {
+        workers.resize(shards);
+    }
 
-                gradients = (*it)->backward(gradients);
+    // every shard scales by the full batch size, so the shard gradients sum to the batch average
+    const T scale = T(1) / static_cast<T>(count);
+    auto runShard = [&](size_t shard) {
+        const size_t first = start + count * shard / shards;
+        const size_t last = start + count * (shard + 1) / shards;
+        trainShard(workers[shard], inputs, targets, rows, first, last - first, scale);
+    };
+    if (shards == 1) {
+        runShard(0);
+    } else {
+        pool->parallelFor(shards, runShard);
+        Telemetry::ScopedTimer timer(metricsSink ? &metrics.times[Telemetry::Phase::Reduce] : nullptr);
+        reduceGradients(shards);
+    }
+    T loss = T(0);
+    for (size_t shard = 0; shard < shards; ++shard) {
+        loss += workers[shard].loss;
+    }
+
+    // one optimizer step per batch, once every layer has its gradients
+    Telemetry::ScopedTimer timer(metricsSink ? &metrics.times[Telemetry::Phase::Optimizer] : nullptr);
+    const auto& contexts = workers[0].contexts;
+    parameterGroups.clear();
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Span<T> weights = layers[i]->getWeightParameters();
+        std::vector<T>& biases = layers[i]->getBiases();
+        parameterGroups.push_back({weights.data(), contexts[i].weightGradients.data(), weights.size()});
+        parameterGroups.push_back({biases.data(), contexts[i].biasGradients.data(), biases.size()});
+    }
+    optimizer->step(parameterGroups, learningRate);
+    for (auto& layer : layers) {
+        layer->applyPruningMask();
+        layer->refreshMixedPrecision();
+    }
+    return loss;
+}
+
+template <typename T>
+T BasicNeuralNetwork<T>::trainAsynchronous(const Matrix<T>& inputs, const Matrix<T>& targets,
+                                           const size_t* rows, size_t samples, T learningRate,
+                                           size_t batchSize) {
+    asynchronousOrder.resize(samples);
+    if (rows) {
+        std::copy(rows, rows + samples, asynchronousOrder.begin());
+    } else {
+        std::iota(asynchronousOrder.begin(), asynchronousOrder.end(), size_t(0));
+    }
+    std::shuffle(asynchronousOrder.begin(), asynchronousOrder.end(), shuffleGenerator);
+
+    const size_t threads = pool ? pool->size() : 1;
+    if (workers.size() < threads) {
+        workers.resize(threads);
+    }
+    std::atomic<size_t> next(0);
+    auto runThread = [&](size_t thread) {
+        Worker& worker = workers[thread];
+        if (!worker.optimizer) {
+            worker.optimizer = makeOptimizer<T>(optimizerName);
+        }
+        T loss = T(0);
+        for (;;) {
+            const size_t first = next.fetch_add(batchSize, std::memory_order_relaxed);
+            if (first >= samples) break;
+            const size_t count = std::min(batchSize, samples - first);
+            trainShard(worker, inputs, targets, asynchronousOrder.data(), first, count,
+                       T(1) / static_cast<T>(count));
+            loss += worker.loss;
+
+            // written while other threads read and write the same weights
+            Telemetry::ScopedTimer timer(metricsSink ? &worker.times[Telemetry::Phase::Optimizer] : nullptr);
+            worker.parameterGroups.clear();
+            for (size_t i = 0; i < layers.size(); ++i) {
+                // masking the gradients instead of the weights keeps pruned
+                // weights at zero without writing every weight once more
+                layers[i]->maskGradients(worker.contexts[i].weightGradients);
+                Span<T> weights = layers[i]->getWeightParameters();
+                std::vector<T>& biases = layers[i]->getBiases();
+                worker.parameterGroups.push_back({weights.data(), worker.contexts[i].weightGradients.data(),
+                                                  weights.size()});
+                worker.parameterGroups.push_back({biases.data(), worker.contexts[i].biasGradients.data(),
+                                                  biases.size()});
             }
+            worker.optimizer->step(worker.parameterGroups, learningRate);
+        }
+        worker.loss = loss;
+    };
+    if (threads == 1) {
+        runThread(0);
+    } else {
+        pool->parallelFor(threads, runThread);
+    }
+    // Momentum and Adam state left over from before a weight was pruned can
+    // still move it; the threads are done, so the mask is safe to apply.
+    for (auto& layer : layers) {
+        layer->applyPruningMask();
+    }
+
+    T loss = T(0);
+    for (size_t thread = 0; thread < threads; ++thread) {
+        loss += workers[thread].loss;
+    }
+    return loss;
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::trainShard(Worker& worker, const Matrix<T>& inputs, const Matrix<T>& targets,
+                                       const size_t* rows, size_t first, size_t count, T scale) {
+    worker.contexts.resize(layers.size());
+    Telemetry::PhaseTimes* times = metricsSink ? &worker.times : nullptr;
+    if (times) times->resize(layers.size());
+
+    const Matrix<T>* shardInputs = &worker.inputs;
+    const Matrix<T>* shardTargets = &worker.targets;
+    {
+        Telemetry::ScopedTimer timer(times ? &(*times)[Telemetry::Phase::Data] : nullptr);
+        if (rows) {
+            worker.inputs.assignRows(inputs, rows + first, count);
+            worker.targets.assignRows(targets, rows + first, count);
+        } else if (first == 0 && count == inputs.rows()) {
+            // a whole packed batch (from a pipeline, say) is used where it is
+            shardInputs = &inputs;
+            shardTargets = &targets;
+        } else {
+            worker.inputs.assignRows(inputs, first, count);
+            worker.targets.assignRows(targets, first, count);
         }
+    }
+
+    const Matrix<T>* output = shardInputs;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        Telemetry::ScopedTimer timer(times ? &times->layerForward[i] : nullptr);
+        output = &layers[i]->forwardBatch(*output, worker.contexts[i]);
+    }
+
+    {
+        Telemetry::ScopedTimer timer(times ? &(*times)[Telemetry::Phase::Loss] : nullptr);
+        worker.loss = batchLossFunction(*output, *shardTargets);
+        batchLossDerivative(*output, *shardTargets, worker.gradients);
+    }
+
+    const Matrix<T>* upstream = &worker.gradients;
+    for (size_t i = layers.size(); i-- > 0;) {
+        Telemetry::ScopedTimer timer(times ? &times->layerBackward[i] : nullptr);
+        upstream = &layers[i]->backwardBatch(*upstream, worker.contexts[i], scale, i > 0);
+    }
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::reduceGradients(size_t shards) {
+    // pairwise tree: after the pass with distance `step`, shard i (a multiple of
+    // 2 * step) holds the sum of shards [i, i + 2 * step)
+    for (size_t step = 1; step < shards; step *= 2) {
+        const size_t pairs = (shards - step + 2 * step - 1) / (2 * step);
+        pool->parallelFor(pairs, [&](size_t pair) {
+            Worker& destination = workers[2 * step * pair];
+            const Worker& source = workers[2 * step * pair + step];
+            for (size_t i = 0; i < layers.size(); ++i) {
+                auto& into = destination.contexts[i];
+                const auto& from = source.contexts[i];
+                T* w = into.weightGradients.data();
+                const T* g = from.weightGradients.data();
+                const size_t n = into.weightGradients.capacity();
+                for (size_t k = 0; k < n; ++k) {
+                    w[k] += g[k];
+                }
+                for (size_t k = 0; k < into.biasGradients.size(); ++k) {
+                    into.biasGradients[k] += from.biasGradients[k];
+                }
+            }
+        });
+    }
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setThreadCount(size_t threads) {
+    if (threads == 1) {
+        pool.reset();
+    } else {
+        pool = std::make_unique<ThreadPool>(threads);
+    }
+}
 
-        if (epoch % 100 == 0) {
-            std::cout << "Epoch " << epoch << ", Loss: " << totalLoss / inputs.size() << std::endl;
+template <typename T>
+void BasicNeuralNetwork<T>::setAsynchronous(bool enabled, unsigned int seed) {
+    if (enabled) {
+        if (!optimizer) {
+            throw std::logic_error("Asynchronous training needs an optimizer.");
+        }
+        shuffleGenerator.seed(seed == 0 ? std::random_device()() : seed);
+        for (Worker& worker : workers) {
+            worker.optimizer.reset();
         }
     }
+    asynchronous = enabled;
+}
+
+template <typename T>
+bool BasicNeuralNetwork<T>::isAsynchronous() const {
+    return asynchronous;
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setMetricsSink(std::shared_ptr<Telemetry::Sink> sink) {
+    metricsSink = std::move(sink);
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setMixedPrecision(bool enabled) {
+    for (auto& layer : layers) {
+        layer->setMixedPrecision(enabled);
+    }
+    mixedPrecision = enabled;
+}
+
+template <typename T>
+bool BasicNeuralNetwork<T>::isMixedPrecision() const {
+    return mixedPrecision;
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::prune(double sparsity) {
+    for (auto& layer : layers) {
+        layer->prune(sparsity);
+    }
 }
 
-std::vector<double> NeuralNetwork::predict(const std::vector<double>& input) {
-    std::vector<double> output = input;
+template <typename T>
+void BasicNeuralNetwork<T>::sparsify() {
     for (auto& layer : layers) {
-        output = layer->forward(output);
+        layer->sparsify();
+    }
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::setPruningSchedule(const PruningSchedule& schedule) {
+    if (!(schedule.sparsity >= 0.0 && schedule.sparsity <= 1.0)) {
+        throw std::invalid_argument("Sparsity must be between 0 and 1.");
+    }
+    if (schedule.startEpoch < 0 || schedule.endEpoch < schedule.startEpoch) {
+        throw std::invalid_argument("Pruning must end no earlier than it starts.");
+    }
+    pruningSchedule = schedule;
+}
+
+template <typename T>
+typename BasicNeuralNetwork<T>::Workspace BasicNeuralNetwork<T>::makeWorkspace() const {
+    size_t widest = 0;
+    for (size_t i = 0; i + 1 < layers.size(); ++i) {
+        widest = std::max(widest, static_cast<size_t>(layers[i]->getOutputSize()));
+    }
+    Workspace workspace;
+    workspace.ping.resize(widest);
+    workspace.pong.resize(widest);
+    return workspace;
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::predict(Span<const T> input, Span<T> output, Workspace& workspace) const {
+    if (layers.empty()) {
+        throw std::logic_error("Network has no layers.");
+    }
+    if (input.size() != static_cast<size_t>(layers.front()->getInputSize()) ||
+        output.size() != static_cast<size_t>(layers.back()->getOutputSize())) {
+        throw std::invalid_argument("Input or output size does not match the network.");
+    }
+
+    Span<const T> current = input;
+    std::vector<T>* next = &workspace.ping;
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const BasicLayer<T>& layer = *layers[i];
+        if (i + 1 == layers.size()) {
+            layer.forward(current, output);
+            break;
+        }
+        const size_t width = layer.getOutputSize();
+        if (next->size() < width) {
+            next->resize(width);
+        }
+        Span<T> activations(next->data(), width);
+        layer.forward(current, activations);
+        current = activations;
+        next = next == &workspace.ping ? &workspace.pong : &workspace.ping;
+    }
+}
+
+template <typename T>
+void BasicNeuralNetwork<T>::predictBatch(const Matrix<T>& inputs, Matrix<T>& outputs, Workspace& workspace) const {
+    if (layers.empty()) {
+        throw std::logic_error("Network has no layers.");
+    }
+    if (inputs.cols() != static_cast<size_t>(layers.front()->getInputSize())) {
+        throw std::invalid_argument("Input size does not match the network.");
+    }
+
+    const Matrix<T>* current = &inputs;
+    Matrix<T>* next = &workspace.batchPing;
+    for (size_t i = 0; i + 1 < layers.size(); ++i) {
+        layers[i]->forwardBatch(*current, *next);
+        current = next;
+        next = next == &workspace.batchPing ? &workspace.batchPong : &workspace.batchPing;
+    }
+    layers.back()->forwardBatch(*current, outputs);
+}
+
+template <typename T>
+int BasicNeuralNetwork<T>::getInputSize() const {
+    return layers.empty() ? 0 : layers.front()->getInputSize();
+}
+
+template <typename T>
+int BasicNeuralNetwork<T>::getOutputSize() const {
+    return layers.empty() ? 0 : layers.back()->getOutputSize();
+}
+
+template <typename T>
+size_t BasicNeuralNetwork<T>::getLayerCount() const {
+    return layers.size();
+}
+
+template <typename T>
+const BasicLayer<T>& BasicNeuralNetwork<T>::getLayer(size_t index) const {
+    return *layers.at(index);
+}
+
+template <typename T>
+BasicInferencePlan<T> BasicNeuralNetwork<T>::compile() const {
+    return BasicInferencePlan<T>(*this);
+}
+
+template <typename T>
+size_t BasicNeuralNetwork<T>::getParameterBytes() const {
+    size_t bytes = 0;
+    for (const auto& layer : layers) {
+        bytes += layer->getParameterBytes();
     }
+    return bytes;
+}
+
+template <typename T>
+double BasicNeuralNetwork<T>::getSparsity() const {
+    double zeros = 0.0, total = 0.0;
+    for (const auto& layer : layers) {
+        const double count = static_cast<double>(layer->getInputSize()) * layer->getOutputSize();
+        zeros += layer->getSparsity() * count;
+        total += count;
+    }
+    return total > 0.0 ? zeros / total : 0.0;
+}
+
+template <typename T>
+BasicNeuralNetwork<T> BasicNeuralNetwork<T>::quantized(const Matrix<T>& calibration) const {
+    std::vector<size_t> rows(calibration.rows());
+    std::iota(rows.begin(), rows.end(), size_t(0));
+    return quantized(calibration, rows);
+}
+
+template <typename T>
+BasicNeuralNetwork<T> BasicNeuralNetwork<T>::quantized(const Matrix<T>& calibration,
+                                                      const std::vector<size_t>& rows) const {
+    if (layers.empty()) {
+        throw std::logic_error("Network has no layers.");
+    }
+    if (calibration.cols() != static_cast<size_t>(getInputSize())) {
+        throw std::invalid_argument("Calibration inputs do not match the network.");
+    }
+    checkRows(rows, calibration.rows());
+
+    BasicNeuralNetwork copy;
+    copy.setLossFunction(lossName);
+    copy.metricsSink = metricsSink;
+    if (pool) copy.pool = std::make_unique<ThreadPool>(pool->size());
+
+    // every layer is calibrated on what the floating-point layers before it
+    // produce, not on the already quantized ones
+    Matrix<T> current, next;
+    current.assignRows(calibration, rows.data(), rows.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        auto layer = std::make_unique<BasicLayer<T>>(*layers[i]);
+        layer->quantize(current);
+        copy.layers.push_back(std::move(layer));
+        if (i + 1 < layers.size()) {
+            layers[i]->forwardBatch(current, next);
+            std::swap(current, next);
+        }
+    }
+    return copy;
+}
+
+template <typename T>
+std::vector<T> BasicNeuralNetwork<T>::predict(const std::vector<T>& input) const {
+    return predict(Span<const T>(input));
+}
+
+template <typename T>
+std::vector<T> BasicNeuralNetwork<T>::predict(Span<const T> input) const {
+    Workspace workspace = makeWorkspace();
+    std::vector<T> output(layers.empty() ? 0 : layers.back()->getOutputSize());
+    predict(input, output, workspace);
     return output;
 }
 
-void NeuralNetwork::addLayer(std::unique_ptr<Layer> layer) {
+template <typename T>
+void BasicNeuralNetwork<T>::addLayer(std::unique_ptr<BasicLayer<T>> layer) {
+    if (mixedPrecision) {
+        layer->setMixedPrecision(true);
+    }
     layers.push_back(std::move(layer));
 }
 
-double NeuralNetwork::evaluate(const std::vector<std::vector<double>>& inputs,
-                                const std::vector<std::vector<double>>& targets,
-                                double tolerance) {
-    if (inputs.size() != targets.size()) {
+template <typename T>
+void BasicNeuralNetwork<T>::save(const std::string& filename, bool includeOptimizerState) const {
+    ModelHeader header = {};
+    std::memcpy(header.magic, ModelMagic, sizeof(ModelMagic));
+    header.version = ModelVersion;
+    header.scalarBytes = sizeof(T);
+    header.layerCount = static_cast<uint32_t>(layers.size());
+    header.loss = nameIndex(LossNames, lossName);
+    header.optimizer = nameIndex(OptimizerNames, optimizerName);
+
+    std::vector<LayerRecord> records(layers.size());
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i]->getActivation() == ActivationFunctions::Kind::Custom) {
+            throw std::invalid_argument("Layers with custom activation functions cannot be saved");
+        }
+        if (layers[i]->isQuantized()) {
+            throw std::invalid_argument("Quantized layers cannot be saved");
+        }
+        if (layers[i]->isSparse()) {
+            throw std::invalid_argument("Sparse layers cannot be saved");
+        }
+    }
+
+    ModelWriter writer(filename);
+    writer.write(&header, sizeof(header));
+    writer.write(records.data(), records.size() * sizeof(LayerRecord));
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const Matrix<T>& weights = layers[i]->getWeights();
+        const std::vector<T>& biases = layers[i]->getBiases();
+        LayerRecord& record = records[i];
+        record.inputSize = static_cast<uint32_t>(layers[i]->getInputSize());
+        record.outputSize = static_cast<uint32_t>(layers[i]->getOutputSize());
+        record.activation = static_cast<uint32_t>(layers[i]->getActivation());
+        record.stride = static_cast<uint32_t>(weights.stride());
+
+        writer.align();
+        record.weightsOffset = writer.position();
+        writer.write(weights.data(), weights.capacity() * sizeof(T));
+        writer.align();
+        record.biasesOffset = writer.position();
+        writer.write(biases.data(), biases.size() * sizeof(T));
+    }
+
+    if (includeOptimizerState && optimizer) {
+        const std::vector<size_t>& sizes = optimizer->groupSizes();
+        const Matrix<T>& state = optimizer->stateData();
+        writer.align();
+        header.optimizerStateOffset = writer.position();
+
+        OptimizerRecord record = {};
+        record.groupCount = sizes.size();
+        record.slots = state.rows();
+        record.columns = state.cols();
+        record.steps = optimizer->stepCount();
+        record.stateOffset = alignUp(header.optimizerStateOffset + sizeof(record) + sizes.size() * sizeof(uint64_t));
+        writer.write(&record, sizeof(record));
+        for (size_t size : sizes) {
+            const uint64_t size64 = size;
+            writer.write(&size64, sizeof(size64));
+        }
+        writer.align();
+        writer.write(state.data(), state.capacity() * sizeof(T));
+    }
+
+    header.fileSize = writer.position();
+    writer.overwrite(0, &header, sizeof(header));
+    writer.overwrite(sizeof(header), records.data(), records.size() * sizeof(LayerRecord));
+    writer.finish();
+}
+
+template <typename T>
+BasicNeuralNetwork<T> BasicNeuralNetwork<T>::load(const std::string& filename) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(filename);
+    auto invalid = [&](const std::string& reason) {
+        return std::runtime_error("Invalid model file " + filename + ": " + reason);
+    };
+    auto inFile = [&](uint64_t offset, uint64_t bytes) {
+        return offset <= file->size() && bytes <= file->size() - offset;
+    };
+
+    ModelHeader header;
+    if (!inFile(0, sizeof(header))) throw invalid("truncated header");
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, ModelMagic, sizeof(ModelMagic)) != 0) throw invalid("bad magic");
+    if (header.version != ModelVersion) throw invalid("unsupported version " + std::to_string(header.version));
+    if (header.scalarBytes != sizeof(T)) throw invalid("saved with a different scalar type");
+    if (header.fileSize != file->size()) throw invalid("truncated file");
+    if (header.loss >= std::size(LossNames) || header.optimizer >= std::size(OptimizerNames)) {
+        throw invalid("unknown loss or optimizer");
+    }
+    if (!inFile(sizeof(header), uint64_t(header.layerCount) * sizeof(LayerRecord))) throw invalid("truncated layer table");
+
+    BasicNeuralNetwork<T> network;
+    network.setLossFunction(LossNames[header.loss]);
+    if (header.optimizer != 0) {
+        network.setOptimizer(OptimizerNames[header.optimizer]);
+    }
+
+    for (uint32_t i = 0; i < header.layerCount; ++i) {
+        LayerRecord record;
+        std::memcpy(&record, file->data() + sizeof(header) + i * sizeof(LayerRecord), sizeof(record));
+        const size_t rows = record.outputSize;
+        const size_t cols = record.inputSize;
+        if (record.activation >= static_cast<uint32_t>(ActivationFunctions::Kind::Custom)) throw invalid("unknown activation");
+        if (record.stride != Matrix<T>::paddedStride(cols)) throw invalid("unexpected row stride");
+        if (record.weightsOffset % ModelAlignment != 0 ||
+            !inFile(record.weightsOffset, uint64_t(rows) * record.stride * sizeof(T)) ||
+            !inFile(record.biasesOffset, uint64_t(rows) * sizeof(T))) {
+            throw invalid("layer " + std::to_string(i) + " out of bounds");
+        }
+        if (i > 0 && cols != static_cast<size_t>(network.layers.back()->getOutputSize())) {
+            throw invalid("layer sizes do not chain");
+        }
+
+        T* weightData = reinterpret_cast<T*>(file->data() + record.weightsOffset);
+        Matrix<T> weights = Matrix<T>::adopt(weightData, rows, cols, file);
+        std::vector<T> biases(rows);
+        std::memcpy(biases.data(), file->data() + record.biasesOffset, rows * sizeof(T));
+        network.layers.push_back(std::make_unique<BasicLayer<T>>(
+            std::move(weights), std::move(biases), static_cast<ActivationFunctions::Kind>(record.activation)));
+    }
+
+    if (header.optimizerStateOffset != 0 && network.optimizer) {
+        OptimizerRecord record;
+        if (!inFile(header.optimizerStateOffset, sizeof(record))) throw invalid("truncated optimizer state");
+        std::memcpy(&record, file->data() + header.optimizerStateOffset, sizeof(record));
+        const uint64_t sizesOffset = header.optimizerStateOffset + sizeof(record);
+        if (record.groupCount > file->size() / sizeof(uint64_t) ||
+            !inFile(sizesOffset, record.groupCount * sizeof(uint64_t))) {
+            throw invalid("truncated optimizer state");
+        }
+        std::vector<size_t> sizes(record.groupCount);
+        for (size_t k = 0; k < sizes.size(); ++k) {
+            uint64_t size64;
+            std::memcpy(&size64, file->data() + sizesOffset + k * sizeof(uint64_t), sizeof(size64));
+            sizes[k] = size64;
+        }
+        const uint64_t stride = Matrix<T>::paddedStride(record.columns);
+        if (record.stateOffset % ModelAlignment != 0 ||
+            !inFile(record.stateOffset, record.slots * stride * sizeof(T))) {
+            throw invalid("truncated optimizer state");
+        }
+        Matrix<T> state = Matrix<T>::adopt(reinterpret_cast<T*>(file->data() + record.stateOffset),
+                                           record.slots, record.columns, file);
+        try {
+            network.optimizer->restoreState(sizes, state, static_cast<int>(record.steps));
+        } catch (const std::invalid_argument&) {
+            throw invalid("optimizer state does not match the layers");
+        }
+    }
+    return network;
+}
+
+template <typename T>
+double BasicNeuralNetwork<T>::evaluate(const Matrix<T>& inputs,
+                                       const Matrix<T>& targets,
+                                       T tolerance) {
+    return evaluateDetailed(inputs, targets, tolerance).accuracy;
+}
+
+template <typename T>
+double BasicNeuralNetwork<T>::evaluate(const Matrix<T>& inputs,
+                                       const Matrix<T>& targets,
+                                       const std::vector<size_t>& rows,
+                                       T tolerance) {
+    return evaluateDetailed(inputs, targets, rows, tolerance).accuracy;
+}
+
+template <typename T>
+typename BasicNeuralNetwork<T>::Evaluation BasicNeuralNetwork<T>::evaluateDetailed(const Matrix<T>& inputs,
+                                                                                   const Matrix<T>& targets,
+                                                                                   T tolerance) {
+    if (inputs.rows() != targets.rows()) {
         throw std::invalid_argument("Inputs and targets must have the same number of samples.");
     }
-    int correctCount = 0;
-    for (size_t i = 0; i < inputs.size(); ++i) {
-        std::vector<double> output = predict(inputs[i]);
-        
-        bool isOneHot = false;
-        if (!targets[i].empty()) {
-            int oneCount = 0;
-            bool hasNonBinary = false;
-            for (double val : targets[i]) {
-                if (std::abs(val - 1.0) < 1e-9) oneCount++;
-                else if (std::abs(val) > 1e-9) hasNonBinary = true;
-            }
-            isOneHot = (oneCount == 1 && !hasNonBinary && targets[i].size() > 1);
-        }
-        
-        if (isOneHot) {
-            int predictedClass = std::max_element(output.begin(), output.end()) - output.begin();
-            int actualClass = std::max_element(targets[i].begin(), targets[i].end()) - targets[i].begin();
-            if (predictedClass == actualClass) {
-                correctCount++;
-            }
-        } else if (targets[i].size() == 1) {
-            double predicted = output[0];
-            double actual = targets[i][0];
-            
-            if (std::abs(actual) < 1e-9 || std::abs(actual - 1.0) < 1e-9) {
-                if ((predicted >= 0.5 && std::abs(actual - 1.0) < 1e-9) || 
-                    (predicted < 0.5 && std::abs(actual) < 1e-9)) {
-                    correctCount++;
-                }
+    return evaluateRows(inputs, targets, nullptr, inputs.rows(), tolerance);
+}
+
+template <typename T>
+typename BasicNeuralNetwork<T>::Evaluation BasicNeuralNetwork<T>::evaluateDetailed(const Matrix<T>& inputs,
+                                                                                   const Matrix<T>& targets,
+                                                                                   const std::vector<size_t>& rows,
+                                                                                   T tolerance) {
+    if (inputs.rows() != targets.rows()) {
+        throw std::invalid_argument("Inputs and targets must have the same number of samples.");
+    }
+    checkRows(rows, inputs.rows());
+    return evaluateRows(inputs, targets, rows.data(), rows.size(), tolerance);
+}
+
+template <typename T>
+typename BasicNeuralNetwork<T>::Evaluation BasicNeuralNetwork<T>::evaluateRows(const Matrix<T>& inputs,
+                                                                               const Matrix<T>& targets,
+                                                                               const size_t* rows,
+                                                                               size_t samples, T tolerance) {
+    using Task = typename Evaluation::Task;
+    if (layers.empty()) {
+        throw std::logic_error("Network has no layers.");
+    }
+    const size_t outputs = layers.back()->getOutputSize();
+    if (targets.cols() != outputs) {
+        throw std::invalid_argument("Target size does not match the network.");
+    }
+    auto rowAt = [rows](size_t i) { return rows ? rows[i] : i; };
+    auto isZero = [](T v) { return std::abs(v) < 1e-9; };
+    auto isOne = [](T v) { return std::abs(v - T(1)) < 1e-9; };
+
+    // decide the task once instead of inspecting every target row per sample
+    Evaluation result;
+    result.samples = samples;
+    bool oneHot = outputs > 1;
+    bool binary = outputs == 1;
+    for (size_t i = 0; i < samples && (oneHot || binary); ++i) {
+        const T* target = targets.rowData(rowAt(i));
+        size_t ones = 0;
+        for (size_t j = 0; j < outputs; ++j) {
+            if (isOne(target[j])) ones++;
+            else if (!isZero(target[j])) oneHot = binary = false;
+        }
+        oneHot = oneHot && ones == 1;
+    }
+    result.task = oneHot ? Task::Classification : (binary ? Task::Binary : Task::Regression);
+    const size_t classes = oneHot ? outputs : (binary ? 2 : 0);
+    if (samples == 0) return result;
+
+    // blocks of rows are dealt round-robin to shards; every shard sums its
+    // blocks in order and the shards are added in order
+    struct Shard {
+        Workspace workspace;
+        Matrix<T> inputs;
+        Matrix<T> targets;
+        Matrix<T> outputs;
+        size_t correct = 0;
+        double loss = 0.0;
+        Matrix<size_t> confusion;
+    };
+    const size_t blockRows = 256;
+    const size_t blocks = (samples + blockRows - 1) / blockRows;
+    const size_t shardCount = std::min(pool ? pool->size() : 1, blocks);
+    std::vector<Shard> shards(shardCount);
+
+    auto runShard = [&](size_t s) {
+        Shard& shard = shards[s];
+        shard.workspace = makeWorkspace();
+        shard.confusion.resize(classes, classes, 0);
+        for (size_t block = s; block < blocks; block += shardCount) {
+            const size_t first = block * blockRows;
+            const size_t count = std::min(blockRows, samples - first);
+            if (rows) {
+                shard.inputs.assignRows(inputs, rows + first, count);
+                shard.targets.assignRows(targets, rows + first, count);
             } else {
-                if (std::abs(predicted - actual) <= tolerance) {
-                    correctCount++;
-                }
+                shard.inputs.assignRows(inputs, first, count);
+                shard.targets.assignRows(targets, first, count);
             }
-        } else {
-            bool allWithinTolerance = true;
-            for (size_t j = 0; j < output.size() && j < targets[i].size(); ++j) {
-                if (std::abs(output[j] - targets[i][j]) > tolerance) {
-                    allWithinTolerance = false;
-                    break;
+            predictBatch(shard.inputs, shard.outputs, shard.workspace);
+            if (batchLossFunction) {
+                shard.loss += static_cast<double>(batchLossFunction(shard.outputs, shard.targets));
+            }
+
+            for (size_t r = 0; r < count; ++r) {
+                const T* output = shard.outputs.rowData(r);
+                const T* target = shard.targets.rowData(r);
+                if (result.task == Task::Classification) {
+                    const size_t predicted = std::max_element(output, output + outputs) - output;
+                    const size_t actual = std::max_element(target, target + outputs) - target;
+                    shard.confusion(actual, predicted)++;
+                    shard.correct += predicted == actual;
+                } else if (result.task == Task::Binary) {
+                    const size_t predicted = output[0] >= T(0.5) ? 1 : 0;
+                    const size_t actual = isOne(target[0]) ? 1 : 0;
+                    shard.confusion(actual, predicted)++;
+                    shard.correct += predicted == actual;
+                } else {
+                    bool allWithinTolerance = true;
+                    for (size_t j = 0; j < outputs; ++j) {
+                        if (std::abs(output[j] - target[j]) > tolerance) {
+                            allWithinTolerance = false;
+                            break;
+                        }
+                    }
+                    shard.correct += allWithinTolerance;
                 }
             }
-            if (allWithinTolerance) {
-                correctCount++;
+        }
+    };
+    if (shardCount == 1) {
+        runShard(0);
+    } else {
+        pool->parallelFor(shardCount, runShard);
+    }
+
+    size_t correct = 0;
+    result.confusion.resize(classes, classes, 0);
+    for (const Shard& shard : shards) {
+        correct += shard.correct;
+        result.loss += shard.loss;
+        for (size_t a = 0; a < classes; ++a) {
+            for (size_t p = 0; p < classes; ++p) {
+                result.confusion(a, p) += shard.confusion(a, p);
             }
         }
     }
-    return static_cast<double>(correctCount) / inputs.size();
+    result.accuracy = static_cast<double>(correct) / samples;
+    result.loss /= samples;
+    return result;
 }
+
+template class BasicNeuralNetwork<float>;
+template class BasicNeuralNetwork<double>;
@@ -0,0 +1,69 @@
+#include "../include/Optimizer.h"
+
+template <typename T>
+BasicOptimizer<T>::BasicOptimizer(size_t stateSlots)
+    : stateSlots(stateSlots) {}
+
+template <typename T>
+void BasicOptimizer<T>::step(const std::vector<ParameterGroup>& groups, T learningRate) {
+    bool sameLayout = groups.size() == sizes.size();
+    for (size_t i = 0; sameLayout && i < groups.size(); ++i) {
+        sameLayout = groups[i].size == sizes[i];
+    }
+    if (!sameLayout) {
+        std::vector<size_t> groupSizes(groups.size());
+        for (size_t i = 0; i < groups.size(); ++i) {
+            groupSizes[i] = groups[i].size;
+        }
+        layout(groupSizes);
+    }
+    ++steps;
+    apply(groups, learningRate);
+}
+
+template <typename T>
+int BasicOptimizer<T>::stepCount() const {
+    return steps;
+}
+
+template <typename T>
+const std::vector<size_t>& BasicOptimizer<T>::groupSizes() const {
+    return sizes;
+}
+
+template <typename T>
+const Matrix<T>& BasicOptimizer<T>::stateData() const {
+    return stateBuffer;
+}
+
+template <typename T>
+void BasicOptimizer<T>::restoreState(const std::vector<size_t>& groupSizes, const Matrix<T>& state, int stepCount) {
+    layout(groupSizes);
+    if (state.rows() != stateBuffer.rows() || state.cols() != stateBuffer.cols()) {
+        throw std::invalid_argument("Optimizer state does not match its parameter groups");
+    }
+    stateBuffer = state;
+    steps = stepCount;
+}
+
+template <typename T>
+T* BasicOptimizer<T>::state(size_t slot, size_t group) {
+    return stateBuffer.rowData(slot) + offsets[group];
+}
+
+template <typename T>
+void BasicOptimizer<T>::layout(const std::vector<size_t>& groupSizes) {
+    sizes = groupSizes;
+    offsets.resize(sizes.size());
+    size_t total = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        offsets[i] = total;
+        total += Matrix<T>::paddedStride(sizes[i]);
+    }
+    stateBuffer.resize(stateSlots, total);
+    stateBuffer.setZero();
+    steps = 0;
+}
+
+template class BasicOptimizer<float>;
+template class BasicOptimizer<double>;
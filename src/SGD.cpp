@@ -1,19 +1,19 @@
 #include "../include/SGD.h"
 
-void SGD::updateWeights(std::vector<std::vector<double>>& weights,
-                        const std::vector<std::vector<double>>& weightGradients,
-                        double learningRate) {
-    for (size_t i = 0; i < weights.size(); ++i) {
-        for (size_t j = 0; j < weights[i].size(); ++j) {
-            weights[i][j] -= learningRate * weightGradients[i][j];
+template <typename T>
+BasicSGD<T>::BasicSGD()
+    : BasicOptimizer<T>(0) {}
+
+template <typename T>
+void BasicSGD<T>::apply(const std::vector<ParameterGroup>& groups, T learningRate) {
+    for (const ParameterGroup& group : groups) {
+        T* __restrict w = group.values;
+        const T* __restrict g = group.gradients;
+        for (size_t i = 0; i < group.size; ++i) {
+            w[i] -= learningRate * g[i];
         }
     }
 }
 
-void SGD::updateBiases(std::vector<double>& biases,
-                       const std::vector<double>& biasGradients,
-                       double learningRate) {
-    for (size_t i = 0; i < biases.size(); ++i) {
-        biases[i] -= learningRate * biasGradients[i];
-    }
-}
\ No newline at end of file
+template class BasicSGD<float>;
+template class BasicSGD<double>;
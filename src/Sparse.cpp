@@ -0,0 +1,326 @@
+#include "../include/Sparse.h"
+#include "../include/CpuFeatures.h"
+#include <algorithm>
+#include <stdexcept>
+
+// The kernels are compiled once per instruction set, like the activation
+// kernels, so the gathers in `gradients` vectorize where the CPU has them; the
+// widest variant the CPU supports is picked on first use.
+
+namespace Sparse {
+
+    namespace {
+
+        // rows of X that share one pass over W in multiply
+        constexpr size_t RowBlock = 4;
+        // From this batch size on the kernels transpose their operands so the
+        // innermost loops run contiguously across the batch, one vector per
+        // few samples, instead of gathering one element per nonzero.
+        constexpr size_t TransposeRows = 16;
+        // partial sums of the transposed dot products, enough for a few vectors
+        constexpr size_t DotLanes = 16;
+
+        // grows only, like the scratch of the quantized forward pass; slot 0
+        // and 1 are two operands of one call
+        template <typename T>
+        T* scratch(size_t slot, size_t n) {
+            thread_local Matrix<T> buffers[2];
+            Matrix<T>& buffer = buffers[slot];
+            if (buffer.cols() < n) buffer.resize(1, n);
+            return buffer.data();
+        }
+
+        // samples per block of the transposes: a row-at-a-time transpose
+        // strides by the batch size on every element, which for batches of
+        // 64 doubles keeps hitting the same few cache sets
+        constexpr size_t TransposeBlock = 16;
+
+        // XT(c, i) = X(i, c) for an M x cols X; XT has row stride M
+        template <typename T>
+        inline __attribute__((always_inline)) void transpose(size_t M, size_t cols, const T* X, size_t ldx, T* XT) {
+            for (size_t i0 = 0; i0 < M; i0 += TransposeBlock) {
+                const size_t i1 = std::min(M, i0 + TransposeBlock);
+                for (size_t c = 0; c < cols; ++c) {
+                    for (size_t i = i0; i < i1; ++i) XT[c * M + i] = X[i * ldx + c];
+                }
+            }
+        }
+
+        // Y(i, r) += YT(r, i), or = when `accumulate` is false
+        template <typename T>
+        inline __attribute__((always_inline)) void transposeBack(size_t M, size_t rows, const T* YT, T* Y,
+                                                                 size_t ldy, bool accumulate) {
+            for (size_t i0 = 0; i0 < M; i0 += TransposeBlock) {
+                const size_t i1 = std::min(M, i0 + TransposeBlock);
+                for (size_t r = 0; r < rows; ++r) {
+                    const T* y = YT + r * M;
+                    if (accumulate) {
+                        for (size_t i = i0; i < i1; ++i) Y[i * ldy + r] += y[i];
+                    } else {
+                        for (size_t i = i0; i < i1; ++i) Y[i * ldy + r] = y[i];
+                    }
+                }
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) T rowDot(const uint32_t* columns, const T* values,
+                                                       size_t begin, size_t end, const T* x) {
+            // four partial sums keep the multiply-adds of one row independent
+            T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+            size_t k = begin;
+            for (; k + 4 <= end; k += 4) {
+                s0 += values[k] * x[columns[k]];
+                s1 += values[k + 1] * x[columns[k + 1]];
+                s2 += values[k + 2] * x[columns[k + 2]];
+                s3 += values[k + 3] * x[columns[k + 3]];
+            }
+            for (; k < end; ++k) s0 += values[k] * x[columns[k]];
+            return (s0 + s1) + (s2 + s3);
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void multiplyBody(size_t M, const T* X, size_t ldx,
+                                                                const CsrMatrix<T>& W, T* Y, size_t ldy) {
+            const uint32_t* start = W.rowStart.data();
+            const uint32_t* columns = W.columns.data();
+            const T* values = W.values.data();
+            const size_t rows = W.rows;
+            if (M >= TransposeRows) {
+                // Y^T = W * X^T, one axpy across the batch per nonzero
+                T* XT = scratch<T>(0, W.cols * M);
+                T* YT = scratch<T>(1, rows * M);
+                transpose(M, W.cols, X, ldx, XT);
+                for (size_t r = 0; r < rows; ++r) {
+                    T* __restrict y = YT + r * M;
+                    std::fill(y, y + M, T(0));
+                    for (size_t k = start[r]; k < start[r + 1]; ++k) {
+                        const T v = values[k];
+                        const T* __restrict x = XT + columns[k] * M;
+                        for (size_t i = 0; i < M; ++i) y[i] += v * x[i];
+                    }
+                }
+                transposeBack(M, rows, YT, Y, ldy, true);
+                return;
+            }
+            size_t i = 0;
+            for (; i + RowBlock <= M; i += RowBlock) {
+                const T* x0 = X + i * ldx;
+                const T* x1 = x0 + ldx;
+                const T* x2 = x1 + ldx;
+                const T* x3 = x2 + ldx;
+                T* y = Y + i * ldy;
+                for (size_t r = 0; r < rows; ++r) {
+                    T s0 = T(0), s1 = T(0), s2 = T(0), s3 = T(0);
+                    for (size_t k = start[r]; k < start[r + 1]; ++k) {
+                        const uint32_t c = columns[k];
+                        const T v = values[k];
+                        s0 += v * x0[c];
+                        s1 += v * x1[c];
+                        s2 += v * x2[c];
+                        s3 += v * x3[c];
+                    }
+                    y[r] += s0;
+                    y[ldy + r] += s1;
+                    y[2 * ldy + r] += s2;
+                    y[3 * ldy + r] += s3;
+                }
+            }
+            for (; i < M; ++i) {
+                const T* x = X + i * ldx;
+                T* y = Y + i * ldy;
+                for (size_t r = 0; r < rows; ++r) {
+                    y[r] += rowDot(columns, values, start[r], start[r + 1], x);
+                }
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void multiplyTransposedBody(size_t M, const T* D, size_t ldd,
+                                                                          const CsrMatrix<T>& W, T* G, size_t ldg) {
+            const uint32_t* start = W.rowStart.data();
+            const uint32_t* columns = W.columns.data();
+            const T* values = W.values.data();
+            const size_t rows = W.rows;
+            const size_t cols = W.cols;
+            if (M >= TransposeRows) {
+                // G^T = W^T * D^T, one axpy across the batch per nonzero
+                T* DT = scratch<T>(0, rows * M);
+                T* GT = scratch<T>(1, cols * M);
+                transpose(M, rows, D, ldd, DT);
+                std::fill(GT, GT + cols * M, T(0));
+                for (size_t r = 0; r < rows; ++r) {
+                    const T* __restrict d = DT + r * M;
+                    for (size_t k = start[r]; k < start[r + 1]; ++k) {
+                        const T v = values[k];
+                        T* __restrict g = GT + columns[k] * M;
+                        for (size_t i = 0; i < M; ++i) g[i] += v * d[i];
+                    }
+                }
+                transposeBack(M, cols, GT, G, ldg, false);
+                return;
+            }
+            for (size_t i = 0; i < M; ++i) {
+                const T* d = D + i * ldd;
+                T* g = G + i * ldg;
+                std::fill(g, g + cols, T(0));
+                for (size_t r = 0; r < rows; ++r) {
+                    const T dr = d[r];
+                    if (dr == T(0)) continue;
+                    for (size_t k = start[r]; k < start[r + 1]; ++k) g[columns[k]] += dr * values[k];
+                }
+            }
+        }
+
+        template <typename T>
+        inline __attribute__((always_inline)) void gradientsBody(size_t M, T scale, const T* D, size_t ldd,
+                                                                 const T* X, size_t ldx, const CsrMatrix<T>& W,
+                                                                 T* out) {
+            const uint32_t* start = W.rowStart.data();
+            const uint32_t* columns = W.columns.data();
+            const size_t rows = W.rows;
+            const size_t nonZeros = W.values.size();
+            if (M >= TransposeRows) {
+                // one dot product across the batch per nonzero
+                T* DT = scratch<T>(0, rows * M);
+                T* XT = scratch<T>(1, W.cols * M);
+                transpose(M, rows, D, ldd, DT);
+                transpose(M, W.cols, X, ldx, XT);
+                for (size_t r = 0; r < rows; ++r) {
+                    const T* d = DT + r * M;
+                    for (size_t k = start[r]; k < start[r + 1]; ++k) {
+                        const T* x = XT + columns[k] * M;
+                        T lanes[DotLanes] = {};
+                        size_t i = 0;
+                        for (; i + DotLanes <= M; i += DotLanes) {
+                            for (size_t l = 0; l < DotLanes; ++l) lanes[l] += d[i + l] * x[i + l];
+                        }
+                        for (; i < M; ++i) lanes[0] += d[i] * x[i];
+                        T sum = T(0);
+                        for (size_t l = 0; l < DotLanes; ++l) sum += lanes[l];
+                        out[k] = scale * sum;
+                    }
+                }
+                return;
+            }
+            std::fill(out, out + nonZeros, T(0));
+            for (size_t i = 0; i < M; ++i) {
+                const T* d = D + i * ldd;
+                const T* x = X + i * ldx;
+                for (size_t r = 0; r < rows; ++r) {
+                    const T dr = d[r];
+                    if (dr == T(0)) continue;
+                    const size_t end = start[r + 1];
+                    for (size_t k = start[r]; k < end; ++k) out[k] += dr * x[columns[k]];
+                }
+            }
+            for (size_t k = 0; k < nonZeros; ++k) out[k] *= scale;
+        }
+
+        template <typename T>
+        struct KernelTable {
+            void (*multiply)(size_t, const T*, size_t, const CsrMatrix<T>&, T*, size_t);
+            void (*multiplyTransposed)(size_t, const T*, size_t, const CsrMatrix<T>&, T*, size_t);
+            void (*gradients)(size_t, T, const T*, size_t, const T*, size_t, const CsrMatrix<T>&, T*);
+        };
+
+#define SPARSE_KERNELS(suffix, attributes)                                                               \
+        template <typename T>                                                                            \
+        attributes void multiply##suffix(size_t M, const T* X, size_t ldx, const CsrMatrix<T>& W,        \
+                                         T* Y, size_t ldy) {                                             \
+            multiplyBody(M, X, ldx, W, Y, ldy);                                                          \
+        }                                                                                                \
+        template <typename T>                                                                            \
+        attributes void multiplyTransposed##suffix(size_t M, const T* D, size_t ldd,                     \
+                                                   const CsrMatrix<T>& W, T* G, size_t ldg) {            \
+            multiplyTransposedBody(M, D, ldd, W, G, ldg);                                                \
+        }                                                                                                \
+        template <typename T>                                                                            \
+        attributes void gradients##suffix(size_t M, T scale, const T* D, size_t ldd, const T* X,         \
+                                          size_t ldx, const CsrMatrix<T>& W, T* out) {                   \
+            gradientsBody(M, scale, D, ldd, X, ldx, W, out);                                             \
+        }                                                                                                \
+        template <typename T>                                                                            \
+        const KernelTable<T> kernels##suffix = {multiply##suffix<T>, multiplyTransposed##suffix<T>,      \
+                                                gradients##suffix<T>};
+
+        SPARSE_KERNELS(Generic, )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        SPARSE_KERNELS(Avx2, __attribute__((target("avx2,fma"))))
+        SPARSE_KERNELS(Avx512, __attribute__((target("avx512f,avx512dq"))))
+#endif
+
+#undef SPARSE_KERNELS
+
+        template <typename T>
+        const KernelTable<T>& kernels() {
+            static const KernelTable<T>& table = []() -> const KernelTable<T>& {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+                switch (CpuFeatures::detected()) {
+                    case CpuFeatures::SimdLevel::AVX512: return kernelsAvx512<T>;
+                    case CpuFeatures::SimdLevel::AVX2: return kernelsAvx2<T>;
+                    default: break;
+                }
+#endif
+                return kernelsGeneric<T>;
+            }();
+            return table;
+        }
+
+    }
+
+    template <typename T>
+    CsrMatrix<T> fromDense(const Matrix<T>& dense) {
+        if (dense.rows() * dense.cols() > UINT32_MAX) {
+            throw std::invalid_argument("Matrix is too large for 32-bit sparse indices");
+        }
+        CsrMatrix<T> sparse;
+        sparse.rows = dense.rows();
+        sparse.cols = dense.cols();
+        sparse.rowStart.reserve(dense.rows() + 1);
+        sparse.rowStart.push_back(0);
+        for (size_t r = 0; r < dense.rows(); ++r) {
+            const T* row = dense.rowData(r);
+            for (size_t c = 0; c < dense.cols(); ++c) {
+                if (row[c] != T(0)) {
+                    sparse.columns.push_back(static_cast<uint32_t>(c));
+                    sparse.values.push_back(row[c]);
+                }
+            }
+            sparse.rowStart.push_back(static_cast<uint32_t>(sparse.values.size()));
+        }
+        return sparse;
+    }
+
+    template CsrMatrix<float> fromDense(const Matrix<float>&);
+    template CsrMatrix<double> fromDense(const Matrix<double>&);
+
+    void multiply(size_t M, const float* X, size_t ldx, const CsrMatrix<float>& W, float* Y, size_t ldy) {
+        kernels<float>().multiply(M, X, ldx, W, Y, ldy);
+    }
+
+    void multiply(size_t M, const double* X, size_t ldx, const CsrMatrix<double>& W, double* Y, size_t ldy) {
+        kernels<double>().multiply(M, X, ldx, W, Y, ldy);
+    }
+
+    void multiplyTransposed(size_t M, const float* D, size_t ldd, const CsrMatrix<float>& W,
+                            float* G, size_t ldg) {
+        kernels<float>().multiplyTransposed(M, D, ldd, W, G, ldg);
+    }
+
+    void multiplyTransposed(size_t M, const double* D, size_t ldd, const CsrMatrix<double>& W,
+                            double* G, size_t ldg) {
+        kernels<double>().multiplyTransposed(M, D, ldd, W, G, ldg);
+    }
+
+    void gradients(size_t M, float scale, const float* D, size_t ldd, const float* X, size_t ldx,
+                   const CsrMatrix<float>& W, float* gradients) {
+        kernels<float>().gradients(M, scale, D, ldd, X, ldx, W, gradients);
+    }
+
+    void gradients(size_t M, double scale, const double* D, size_t ldd, const double* X, size_t ldx,
+                   const CsrMatrix<double>& W, double* gradients) {
+        kernels<double>().gradients(M, scale, D, ldd, X, ldx, W, gradients);
+    }
+
+}
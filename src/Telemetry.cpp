@@ -0,0 +1,134 @@
+#include "../include/Telemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace Telemetry {
+
+    namespace {
+
+        const char* const PhaseNames[PhaseCount] = {"data", "forward", "loss", "backward", "reduce", "optimizer"};
+
+        std::ofstream openForWriting(const std::string& filename) {
+            std::ofstream out(filename, std::ios::trunc);
+            if (!out) {
+                throw std::runtime_error("Could not open " + filename + " for writing");
+            }
+            return out;
+        }
+
+        // JSON has no literals for NaN and infinity
+        struct JsonNumber {
+            double value;
+        };
+
+        std::ostream& operator<<(std::ostream& out, JsonNumber number) {
+            if (!std::isfinite(number.value)) return out << "null";
+            return out << number.value;
+        }
+
+    }
+
+    const char* phaseName(Phase phase) {
+        return PhaseNames[static_cast<size_t>(phase)];
+    }
+
+    void PhaseTimes::resize(size_t layers) {
+        layerForward.resize(layers, 0.0);
+        layerBackward.resize(layers, 0.0);
+    }
+
+    void PhaseTimes::clear() {
+        seconds.fill(0.0);
+        std::fill(layerForward.begin(), layerForward.end(), 0.0);
+        std::fill(layerBackward.begin(), layerBackward.end(), 0.0);
+    }
+
+    void PhaseTimes::add(const PhaseTimes& other) {
+        for (size_t p = 0; p < PhaseCount; ++p) {
+            seconds[p] += other.seconds[p];
+        }
+        resize(std::max(layerForward.size(), other.layerForward.size()));
+        for (size_t i = 0; i < other.layerForward.size(); ++i) {
+            layerForward[i] += other.layerForward[i];
+            layerBackward[i] += other.layerBackward[i];
+        }
+    }
+
+    ConsoleSink::ConsoleSink(int interval) : interval(std::max(1, interval)) {}
+
+    void ConsoleSink::epoch(const EpochMetrics& metrics) {
+        if (metrics.epoch % interval == 0) {
+            std::cout << "Epoch " << metrics.epoch << ", Loss: " << metrics.loss << '\n';
+        }
+    }
+
+    void ConsoleSink::flush() {
+        std::cout.flush();
+    }
+
+    CallbackSink::CallbackSink(std::function<void(const EpochMetrics&)> callback)
+        : callback(std::move(callback)) {}
+
+    void CallbackSink::epoch(const EpochMetrics& metrics) {
+        callback(metrics);
+    }
+
+    CsvSink::CsvSink(const std::string& filename) : out(openForWriting(filename)) {}
+
+    void CsvSink::epoch(const EpochMetrics& metrics) {
+        const size_t layers = metrics.times.layerForward.size();
+        if (!headerWritten) {
+            out << "epoch,loss,samples,batches,seconds,samples_per_second,flops,flops_per_second,allocations";
+            for (size_t p = 0; p < PhaseCount; ++p) {
+                out << "," << PhaseNames[p] << "_seconds";
+            }
+            for (size_t i = 0; i < layers; ++i) {
+                out << ",layer" << i << "_forward_seconds,layer" << i << "_backward_seconds";
+            }
+            out << '\n';
+            headerWritten = true;
+        }
+        out << metrics.epoch << ',' << metrics.loss << ',' << metrics.samples << ',' << metrics.batches << ','
+            << metrics.seconds << ',' << metrics.samplesPerSecond << ',' << metrics.flops << ','
+            << metrics.flopsPerSecond << ',' << metrics.allocations;
+        for (double seconds : metrics.times.seconds) {
+            out << ',' << seconds;
+        }
+        for (size_t i = 0; i < layers; ++i) {
+            out << ',' << metrics.times.layerForward[i] << ',' << metrics.times.layerBackward[i];
+        }
+        out << '\n';
+    }
+
+    void CsvSink::flush() {
+        out.flush();
+    }
+
+    JsonSink::JsonSink(const std::string& filename) : out(openForWriting(filename)) {}
+
+    void JsonSink::epoch(const EpochMetrics& metrics) {
+        out << "{\"epoch\": " << metrics.epoch << ", \"loss\": " << JsonNumber{metrics.loss}
+            << ", \"samples\": " << metrics.samples << ", \"batches\": " << metrics.batches
+            << ", \"seconds\": " << JsonNumber{metrics.seconds}
+            << ", \"samples_per_second\": " << JsonNumber{metrics.samplesPerSecond}
+            << ", \"flops\": " << JsonNumber{metrics.flops}
+            << ", \"flops_per_second\": " << JsonNumber{metrics.flopsPerSecond}
+            << ", \"allocations\": " << metrics.allocations << ", \"phases\": {";
+        for (size_t p = 0; p < PhaseCount; ++p) {
+            out << (p ? ", " : "") << '"' << PhaseNames[p] << "\": " << JsonNumber{metrics.times.seconds[p]};
+        }
+        out << "}, \"layers\": [";
+        for (size_t i = 0; i < metrics.times.layerForward.size(); ++i) {
+            out << (i ? ", " : "") << "{\"forward\": " << JsonNumber{metrics.times.layerForward[i]}
+                << ", \"backward\": " << JsonNumber{metrics.times.layerBackward[i]} << '}';
+        }
+        out << "]}\n";
+    }
+
+    void JsonSink::flush() {
+        out.flush();
+    }
+
+}
@@ -0,0 +1,85 @@
+#include "../include/ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    this->task = &task;
+    nextIndex = 0;
+    taskCount = count;
+    pending = count;
+    error = nullptr;
+    workAvailable.notify_all();
+
+    runTasks(lock);
+    workDone.wait(lock, [this] { return pending == 0; });
+
+    this->task = nullptr;
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workAvailable.wait(lock, [this] { return stopping || nextIndex < taskCount; });
+        if (stopping) return;
+        runTasks(lock);
+    }
+}
+
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& lock) {
+    while (nextIndex < taskCount) {
+        const size_t index = nextIndex++;
+        const std::function<void(size_t)>& current = *task;
+        lock.unlock();
+        std::exception_ptr thrown;
+        try {
+            current(index);
+        } catch (...) {
+            thrown = std::current_exception();
+        }
+        lock.lock();
+        if (thrown && !error) {
+            error = thrown;
+        }
+        if (--pending == 0) {
+            workDone.notify_all();
+        }
+    }
+}
@@ -6,9 +6,46 @@
 #include "../include/Layer.h"
 #include "../include/NeuralNetwork.h"
 #include "../include/DataLoader.h"
+#include "../include/DataPipeline.h"
+#include "../include/Gemm.h"
+#include "../include/CpuFeatures.h"
+#include "../include/ThreadPool.h"
+#include "../include/Adam.h"
+#include "../include/Telemetry.h"
+#include "../include/InferenceServer.h"
+#include "../include/InferencePlan.h"
+#include "../include/StaticNetwork.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <random>
 
 #define SEED 1234
 
+// Three noisy, linearly separable classes in rotation: feature j of a row is
+// near 1 when j % 3 is the row's label and near -0.5 otherwise.
+template <typename T>
+DataLoader::BasicDataset<T> syntheticClasses(size_t rows, size_t features, std::mt19937& gen) {
+    std::normal_distribution<T> noise(T(0), T(0.4));
+    DataLoader::BasicDataset<T> dataset;
+    dataset.inputs.resize(rows, features);
+    std::vector<int> labels(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        labels[i] = static_cast<int>(i % 3);
+        for (size_t j = 0; j < features; ++j) {
+            dataset.inputs(i, j) = (j % 3 == static_cast<size_t>(labels[i]) ? T(1) : T(-0.5)) + noise(gen);
+        }
+    }
+    dataset.targets = DataLoader::oneHotEncode<T>(labels, 3);
+    return dataset;
+}
+
 void testActivationFunctions() {
     std::cout << "Testing sigmoid function..." << std::endl;
     double input = 0.0;
@@ -40,6 +77,56 @@ void testActivationFunctions() {
     std::cout << "All activation function tests passed!\n" << std::endl;
 }
 
+void testActivationKernels() {
+    std::cout << "Testing vectorized activation kernels ("
+              << CpuFeatures::name(CpuFeatures::detected()) << ")..." << std::endl;
+    std::vector<double> x(37);
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = -9.0 + 0.5 * static_cast<double>(i);
+    }
+
+    std::vector<double> sig = x, rel = x, sigGrad, relGrad = x;
+    ActivationFunctions::sigmoidInPlace(sig.data(), sig.size());
+    ActivationFunctions::reluInPlace(rel.data(), rel.size());
+    sigGrad = sig;
+    ActivationFunctions::sigmoidDerivativeInPlace(sigGrad.data(), sigGrad.size());
+    ActivationFunctions::reluDerivativeInPlace(relGrad.data(), relGrad.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        assert(std::abs(sig[i] - ActivationFunctions::sigmoid(x[i])) < 1e-14);
+        assert(rel[i] == ActivationFunctions::relu(x[i]));
+        assert(std::abs(sigGrad[i] - ActivationFunctions::sigmoidDerivativeFromInput(x[i])) < 1e-14);
+        assert(relGrad[i] == ActivationFunctions::reluDerivative(x[i]));
+    }
+
+    // large logits must not overflow thanks to max subtraction
+    std::vector<double> logits = {1000.0, 999.0, 998.0};
+    std::vector<double> probs = ActivationFunctions::softmax(logits);
+    double sum = 0.0;
+    for (double p : probs) sum += p;
+    assert(std::abs(sum - 1.0) < 1e-12);
+    double denom = 1.0 + std::exp(-1.0) + std::exp(-2.0);
+    assert(std::abs(probs[0] - 1.0 / denom) < 1e-12);
+    assert(std::abs(probs[2] - std::exp(-2.0) / denom) < 1e-12);
+
+    std::vector<double> wide = x;
+    ActivationFunctions::softmaxInPlace(wide.data(), wide.size());
+    double maxVal = x.back(), wideSum = 0.0;
+    for (double v : x) wideSum += std::exp(v - maxVal);
+    for (size_t i = 0; i < x.size(); ++i) {
+        assert(std::abs(wide[i] - std::exp(x[i] - maxVal) / wideSum) < 1e-14);
+    }
+
+    // a diverged network must not report plausible probabilities
+    for (double bad : {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity()}) {
+        std::vector<double> diverged = x;
+        diverged[3] = bad;
+        ActivationFunctions::softmaxInPlace(diverged.data(), diverged.size());
+        for (double p : ActivationFunctions::softmax({0.5, bad, -1.0})) assert(std::isnan(p));
+        for (double p : diverged) assert(std::isnan(p));
+    }
+    std::cout << "Activation kernel tests passed!\n" << std::endl;
+}
+
 void testLossFunctions() {
     std::cout << "Testing MSE loss function..." << std::endl;
     std::vector<double> predicted = {0.8, 0.3, 0.9};
@@ -123,9 +210,244 @@ void testLayer() {
         assert(std::isfinite(val));
     }
 
+    std::cout << "Testing fused backward fills the gradient buffers..." << std::endl;
+    const double* weightGradientStorage = layer.getWeightGradients().data();
+    Matrix<double> expectedWeights = layer.computeWeightGradients(gradients);
+    std::vector<double> expectedBiases = layer.computeBiasGradients(gradients);
+    layer.forward(input);
+    layer.backward(gradients);
+    assert(layer.getWeightGradients().data() == weightGradientStorage);
+    for (size_t i = 0; i < expectedWeights.rows(); ++i) {
+        for (size_t j = 0; j < expectedWeights.cols(); ++j) {
+            assert(std::abs(layer.getWeightGradients()(i, j) - expectedWeights(i, j)) < 1e-12);
+        }
+        assert(std::abs(layer.getBiasGradients()[i] - expectedBiases[i]) < 1e-12);
+    }
+
+    Matrix<double> batch(4, 2, 1.0), copy(4, 2);
+    const double* copyStorage = copy.data();
+    copy = batch;
+    assert(copy.data() == copyStorage && copy(3, 1) == 1.0);
+
     std::cout << "Layer test passed!\n" << std::endl;
 }
 
+void testActivationDispatch() {
+    std::cout << "Testing built-in activations against std::function layers..." << std::endl;
+    using ActivationFunctions::Kind;
+    const char* names[] = {"relu", "sigmoid"};
+    for (const char* name : names) {
+        Kind kind = ActivationFunctions::kindFromName(name);
+        Layer builtin(5, 4, kind, SEED);
+        Layer custom = kind == Kind::Relu
+            ? Layer(5, 4, [](double x) { return ActivationFunctions::relu(x); },
+                    [](double y) { return ActivationFunctions::reluDerivative(y); }, name, SEED)
+            : Layer(5, 4, [](double x) { return ActivationFunctions::sigmoid(x); },
+                    [](double y) { return ActivationFunctions::sigmoidDerivative(y); }, name, SEED);
+        std::vector<double> input = {0.3, -1.2, 0.8, 2.0, -0.4};
+        std::vector<double> a = builtin.forward(input);
+        std::vector<double> b = custom.forward(input);
+        for (size_t i = 0; i < a.size(); ++i) {
+            assert(std::abs(a[i] - b[i]) < 1e-12);
+        }
+        std::vector<double> upstream = {0.5, -0.25, 1.0, 0.1};
+        std::vector<double> ga = builtin.backward(upstream);
+        std::vector<double> gb = custom.backward(upstream);
+        for (size_t i = 0; i < ga.size(); ++i) {
+            assert(std::abs(ga[i] - gb[i]) < 1e-12);
+        }
+        for (size_t i = 0; i < upstream.size(); ++i) {
+            assert(std::abs(builtin.getBiasGradients()[i] - custom.getBiasGradients()[i]) < 1e-12);
+        }
+    }
+    std::cout << "Activation dispatch test passed!\n" << std::endl;
+}
+
+void testOptimizers() {
+    std::cout << "Testing per-group Adam state..." << std::endl;
+    std::vector<double> a = {0.5, -1.0, 2.0}, b = {1.0, 0.25};
+    std::vector<double> ga = {0.1, -0.2, 0.3}, gb = {-0.5, 0.05};
+    Adam adam;
+    std::vector<Adam::ParameterGroup> groups = {{a.data(), ga.data(), a.size()},
+                                                {b.data(), gb.data(), b.size()}};
+
+    // reference Adam run independently on every tensor
+    std::vector<std::vector<double>> values = {a, b}, grads = {ga, gb};
+    std::vector<std::vector<double>> m = {{0, 0, 0}, {0, 0}}, v = {{0, 0, 0}, {0, 0}};
+    const double lr = 0.01, beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    for (int t = 1; t <= 3; ++t) {
+        adam.step(groups, lr);
+        assert(adam.stepCount() == t);
+        for (size_t k = 0; k < values.size(); ++k) {
+            for (size_t i = 0; i < values[k].size(); ++i) {
+                double g = grads[k][i];
+                m[k][i] = beta1 * m[k][i] + (1 - beta1) * g;
+                v[k][i] = beta2 * v[k][i] + (1 - beta2) * g * g;
+                double mHat = m[k][i] / (1 - std::pow(beta1, t));
+                double vHat = v[k][i] / (1 - std::pow(beta2, t));
+                values[k][i] -= lr * mHat / (std::sqrt(vHat) + eps);
+            }
+        }
+        for (size_t i = 0; i < a.size(); ++i) assert(std::abs(a[i] - values[0][i]) < 1e-12);
+        for (size_t i = 0; i < b.size(); ++i) assert(std::abs(b[i] - values[1][i]) < 1e-12);
+    }
+    std::cout << "Optimizer test passed!\n" << std::endl;
+}
+
+void testGemm() {
+    std::cout << "Testing GEMM against a reference product..." << std::endl;
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> dis(-1.0, 1.0);
+    auto randomMatrix = [&](size_t rows, size_t cols) {
+        Matrix<double> m(rows, cols);
+        for (size_t i = 0; i < rows; ++i)
+            for (size_t j = 0; j < cols; ++j) m(i, j) = dis(gen);
+        return m;
+    };
+
+    const size_t shapes[][3] = {{3, 5, 7}, {37, 53, 300}, {130, 70, 260}};
+    for (const auto& shape : shapes) {
+        const size_t M = shape[0], N = shape[1], K = shape[2];
+        for (int ta = 0; ta < 2; ++ta) {
+            for (int tb = 0; tb < 2; ++tb) {
+                Matrix<double> A = ta ? randomMatrix(K, M) : randomMatrix(M, K);
+                Matrix<double> B = tb ? randomMatrix(N, K) : randomMatrix(K, N);
+                Matrix<double> C = randomMatrix(M, N);
+                Matrix<double> expected = C;
+                for (size_t i = 0; i < M; ++i) {
+                    for (size_t j = 0; j < N; ++j) {
+                        double sum = 0.0;
+                        for (size_t p = 0; p < K; ++p) {
+                            sum += (ta ? A(p, i) : A(i, p)) * (tb ? B(j, p) : B(p, j));
+                        }
+                        expected(i, j) = 0.5 * sum - 2.0 * C(i, j);
+                    }
+                }
+                Gemm::gemm(ta ? Gemm::Transpose::Yes : Gemm::Transpose::No,
+                           tb ? Gemm::Transpose::Yes : Gemm::Transpose::No,
+                           M, N, K, 0.5, A.data(), A.stride(), B.data(), B.stride(),
+                           -2.0, C.data(), C.stride());
+                for (size_t i = 0; i < M; ++i)
+                    for (size_t j = 0; j < N; ++j)
+                        assert(std::abs(C(i, j) - expected(i, j)) < 1e-9);
+            }
+        }
+    }
+
+    Matrix<double> A = randomMatrix(9, 13);
+    std::vector<double> x(13, 0.5), y(9, 1.0), xt(9, -0.25), yt(13, 0.0);
+    Gemm::gemv(Gemm::Transpose::No, 9, 13, 1.0, A.data(), A.stride(), x.data(), 1.0, y.data());
+    Gemm::gemv(Gemm::Transpose::Yes, 9, 13, 1.0, A.data(), A.stride(), xt.data(), 0.0, yt.data());
+    for (size_t i = 0; i < 9; ++i) {
+        double sum = 1.0;
+        for (size_t j = 0; j < 13; ++j) sum += A(i, j) * 0.5;
+        assert(std::abs(y[i] - sum) < 1e-12);
+    }
+    for (size_t j = 0; j < 13; ++j) {
+        double sum = 0.0;
+        for (size_t i = 0; i < 9; ++i) sum += A(i, j) * -0.25;
+        assert(std::abs(yt[j] - sum) < 1e-12);
+    }
+    // float rows and columns past the widest vector, with alpha and beta
+    for (size_t M : {size_t(3), size_t(7)}) {
+        const size_t N = 37;
+        Matrix<float> F(M, N);
+        for (size_t i = 0; i < M; ++i)
+            for (size_t j = 0; j < N; ++j) F(i, j) = static_cast<float>(A(i % 9, j % 13));
+        std::vector<float> fx(N), fy(M, 2.0f), fxt(M), fyt(N, -1.0f);
+        for (size_t j = 0; j < N; ++j) fx[j] = 0.01f * static_cast<float>(j);
+        for (size_t i = 0; i < M; ++i) fxt[i] = 0.5f - 0.1f * static_cast<float>(i);
+        Gemm::gemv(Gemm::Transpose::No, M, N, 2.0f, F.data(), F.stride(), fx.data(), 0.5f, fy.data());
+        Gemm::gemv(Gemm::Transpose::Yes, M, N, 2.0f, F.data(), F.stride(), fxt.data(), 0.5f, fyt.data());
+        for (size_t i = 0; i < M; ++i) {
+            double sum = 0.0;
+            for (size_t j = 0; j < N; ++j) sum += double(F(i, j)) * fx[j];
+            assert(std::abs(fy[i] - (1.0 + 2.0 * sum)) < 1e-4);
+        }
+        for (size_t j = 0; j < N; ++j) {
+            double sum = 0.0;
+            for (size_t i = 0; i < M; ++i) sum += double(F(i, j)) * fxt[i];
+            assert(std::abs(fyt[j] - (-0.5 + 2.0 * sum)) < 1e-4);
+        }
+    }
+
+    // a bfloat16 right-hand side is widened exactly, so the product matches
+    // the reference on the widened values, small and blocked alike
+    for (const auto& shape : shapes) {
+        const size_t M = shape[0], N = shape[1], K = shape[2];
+        for (int ta = 0; ta < 2; ++ta) {
+            for (int tb = 0; tb < 2; ++tb) {
+                Matrix<double> A = ta ? randomMatrix(K, M) : randomMatrix(M, K);
+                Matrix<BFloat16> B(tb ? N : K, tb ? K : N);
+                for (size_t i = 0; i < B.rows(); ++i)
+                    for (size_t j = 0; j < B.cols(); ++j) B(i, j) = BFloat16(static_cast<float>(dis(gen)));
+                Matrix<double> C = randomMatrix(M, N);
+                Matrix<double> expected = C;
+                for (size_t i = 0; i < M; ++i) {
+                    for (size_t j = 0; j < N; ++j) {
+                        double sum = 0.0;
+                        for (size_t p = 0; p < K; ++p) {
+                            sum += (ta ? A(p, i) : A(i, p)) * static_cast<float>(tb ? B(j, p) : B(p, j));
+                        }
+                        expected(i, j) = 0.5 * sum + C(i, j);
+                    }
+                }
+                Gemm::gemm(ta ? Gemm::Transpose::Yes : Gemm::Transpose::No,
+                           tb ? Gemm::Transpose::Yes : Gemm::Transpose::No,
+                           M, N, K, 0.5, A.data(), A.stride(), B.data(), B.stride(),
+                           1.0, C.data(), C.stride());
+                for (size_t i = 0; i < M; ++i)
+                    for (size_t j = 0; j < N; ++j)
+                        assert(std::abs(C(i, j) - expected(i, j)) < 1e-9);
+            }
+        }
+    }
+
+    // weights packed once give the same product for any number of rows,
+    // including fewer than a micro-tile
+    Matrix<double> W = randomMatrix(70, 300);
+    Gemm::PackedMatrix<double> packedW;
+    Gemm::pack(Gemm::Transpose::Yes, 300, 70, W.data(), W.stride(), packedW);
+    assert(packedW.panelWidth == Gemm::packedPanelWidth<double>());
+    for (size_t M : {1, 2, 7, 64, 130}) {
+        Matrix<double> X = randomMatrix(M, 300);
+        Matrix<double> C = randomMatrix(M, 70);
+        Matrix<double> expected = C;
+        Gemm::gemm(Gemm::Transpose::No, Gemm::Transpose::Yes, M, 70, 300, 1.0, X.data(), X.stride(),
+                   W.data(), W.stride(), 1.0, expected.data(), expected.stride());
+        Gemm::gemm(M, X.data(), X.stride(), packedW, 1.0, C.data(), C.stride());
+        for (size_t i = 0; i < M; ++i)
+            for (size_t j = 0; j < 70; ++j)
+                assert(std::abs(C(i, j) - expected(i, j)) < 1e-9);
+    }
+
+    // the int8 kernel is exact, including the extreme values and ragged edges
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (const auto& shape : {std::array<size_t, 3>{1, 1, 1}, std::array<size_t, 3>{5, 7, 3},
+                              std::array<size_t, 3>{33, 10, 129}, std::array<size_t, 3>{4, 9, 1000},
+                              std::array<size_t, 3>{17, 35, 64}}) {
+        const size_t M = shape[0], N = shape[1], K = shape[2];
+        Matrix<uint8_t> qa(M, K);
+        Matrix<int8_t> qb(N, K);
+        Matrix<int32_t> qc(M, N);
+        for (size_t i = 0; i < M; ++i)
+            for (size_t p = 0; p < K; ++p) qa(i, p) = static_cast<uint8_t>(i == 0 ? 255 : byte(gen));
+        for (size_t j = 0; j < N; ++j)
+            for (size_t p = 0; p < K; ++p) qb(j, p) = static_cast<int8_t>(j == 0 ? -128 : byte(gen) - 128);
+        Matrix<int8_t> packed(1, Gemm::packedS8Size(N, K));
+        Gemm::packS8(N, K, qb.data(), qb.stride(), packed.data());
+        Gemm::gemmU8S8(M, N, K, qa.data(), qa.stride(), packed.data(), qc.data(), qc.stride());
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t j = 0; j < N; ++j) {
+                int32_t sum = 0;
+                for (size_t p = 0; p < K; ++p) sum += int32_t(qa(i, p)) * int32_t(qb(j, p));
+                assert(qc(i, j) == sum);
+            }
+        }
+    }
+    std::cout << "GEMM test passed!\n" << std::endl;
+}
+
 void testXOR() {
     std::cout << "Testing XOR Neural Network..." << std::endl;
 
@@ -159,6 +481,1088 @@ void testXOR() {
     std::cout << "XOR Neural Network test passed!\n" << std::endl;
 }
 
+void testMiniBatch() {
+    std::cout << "Testing batched forward matches per-sample forward..." << std::endl;
+    Layer layer(3, 4);
+    Matrix<double> batch = {{0.5, -0.3, 1.0}, {0.0, 2.0, -1.5}};
+    const Matrix<double>& batchOutput = layer.forwardBatch(batch);
+    for (size_t b = 0; b < batch.rows(); ++b) {
+        std::vector<double> output = layer.forward(batch[b]);
+        for (size_t i = 0; i < output.size(); ++i) {
+            assert(std::abs(output[i] - batchOutput(b, i)) < 1e-12);
+        }
+    }
+
+    std::cout << "Training XOR with mini-batches of 2..." << std::endl;
+    NeuralNetwork nn({2, 8, 1}, "sigmoid", "crossEntropy", "Adam", SEED);
+    Matrix<double> inputs = {{0.0, 0.0}, {0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}};
+    Matrix<double> targets = {{0.0}, {1.0}, {1.0}, {0.0}};
+    nn.train(inputs, targets, 1000, 0.05, 2);
+    double accuracy = nn.evaluate(inputs, targets);
+    std::cout << "Mini-batch XOR accuracy: " << accuracy * 100 << "%" << std::endl;
+    assert(accuracy >= 0.9);
+    std::cout << "Mini-batch test passed!\n" << std::endl;
+}
+
+void testFloatNetwork() {
+    std::cout << "Testing float activation kernels against the scalar functions..." << std::endl;
+    std::vector<float> x = {-20.0f, -3.5f, -0.25f, 0.0f, 0.75f, 4.0f, 30.0f};
+    std::vector<float> s = x;
+    ActivationFunctions::sigmoidInPlace(s.data(), s.size());
+    for (size_t i = 0; i < x.size(); ++i) {
+        assert(std::abs(s[i] - static_cast<float>(ActivationFunctions::sigmoid(x[i]))) < 1e-6f);
+    }
+    std::vector<float> p = x;
+    ActivationFunctions::softmaxInPlace(p.data(), p.size());
+    float total = 0.0f;
+    for (float v : p) total += v;
+    assert(std::abs(total - 1.0f) < 1e-5f);
+
+    std::cout << "Training XOR in float..." << std::endl;
+    BasicNeuralNetwork<float> nn({2, 8, 1}, "sigmoid", "crossEntropy", "Adam", SEED);
+    Matrix<float> inputs = {{0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}};
+    Matrix<float> targets = {{0.0f}, {1.0f}, {1.0f}, {0.0f}};
+    nn.train(inputs, targets, 1000, 0.05f, 2);
+    double accuracy = nn.evaluate(inputs, targets);
+    std::cout << "Float XOR accuracy: " << accuracy * 100 << "%" << std::endl;
+    assert(accuracy >= 0.9);
+    std::cout << "Float network test passed!\n" << std::endl;
+}
+
+void testDataParallelTraining() {
+    std::cout << "Testing thread pool..." << std::endl;
+    ThreadPool pool(4);
+    assert(pool.size() == 4);
+    std::vector<int> hits(1000, 0);
+    pool.parallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+    for (int h : hits) assert(h == 1);
+    bool caught = false;
+    try {
+        pool.parallelFor(8, [](size_t i) {
+            if (i == 5) throw std::runtime_error("task failed");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    std::cout << "Testing data-parallel training matches serial training..." << std::endl;
+    std::mt19937 gen(SEED);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    Matrix<double> inputs(64, 5), targets(64, 3, 0.0);
+    for (size_t r = 0; r < inputs.rows(); ++r) {
+        for (size_t c = 0; c < inputs.cols(); ++c) inputs(r, c) = noise(gen);
+        targets(r, r % 3) = 1.0;
+    }
+    NeuralNetwork serial({5, 16, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    NeuralNetwork parallel({5, 16, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    parallel.setThreadCount(3);
+    serial.train(inputs, targets, 20, 0.01, 16);
+    parallel.train(inputs, targets, 20, 0.01, 16);
+    for (size_t r = 0; r < inputs.rows(); ++r) {
+        std::vector<double> a = serial.predict(inputs[r]);
+        std::vector<double> b = parallel.predict(inputs[r]);
+        for (size_t i = 0; i < a.size(); ++i) {
+            assert(std::abs(a[i] - b[i]) < 1e-9);
+        }
+    }
+    std::cout << "Data-parallel training test passed!\n" << std::endl;
+
+    std::cout << "Testing concurrent const inference..." << std::endl;
+    const NeuralNetwork& model = serial;
+    std::vector<std::vector<double>> expected(inputs.rows());
+    for (size_t r = 0; r < inputs.rows(); ++r) {
+        expected[r] = model.predict(inputs[r]);
+    }
+    std::vector<NeuralNetwork::Workspace> workspaces(pool.size());
+    for (auto& workspace : workspaces) workspace = model.makeWorkspace();
+    std::atomic<int> mismatches(0);
+    pool.parallelFor(pool.size(), [&](size_t worker) {
+        std::vector<double> output(3);
+        for (int repeat = 0; repeat < 50; ++repeat) {
+            for (size_t r = 0; r < inputs.rows(); ++r) {
+                model.predict(inputs[r], output, workspaces[worker]);
+                if (output != expected[r]) mismatches++;
+            }
+        }
+    });
+    assert(mismatches == 0);
+    std::cout << "Concurrent inference test passed!\n" << std::endl;
+}
+
+void testModelSerialization() {
+    std::cout << "Testing binary model save/load..." << std::endl;
+    Matrix<double> inputs = {{0.0, 0.0}, {0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}};
+    Matrix<double> targets = {{0.0}, {1.0}, {1.0}, {0.0}};
+    NeuralNetwork trained({2, 8, 1}, "sigmoid", "crossEntropy", "Adam", SEED);
+    trained.train(inputs, targets, 200, 0.05, 2);
+    trained.save("model_test.bin", true);
+
+    NeuralNetwork loaded = NeuralNetwork::load("model_test.bin");
+    for (size_t r = 0; r < inputs.rows(); ++r) {
+        assert(trained.predict(inputs[r]) == loaded.predict(inputs[r]));
+    }
+
+    // the optimizer state comes along, so training resumes identically
+    trained.train(inputs, targets, 10, 0.05, 2);
+    loaded.train(inputs, targets, 10, 0.05, 2);
+    for (size_t r = 0; r < inputs.rows(); ++r) {
+        assert(trained.predict(inputs[r]) == loaded.predict(inputs[r]));
+    }
+
+    bool rejected = false;
+    try {
+        BasicNeuralNetwork<float>::load("model_test.bin");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+    std::remove("model_test.bin");
+    std::cout << "Model serialization test passed!\n" << std::endl;
+}
+
+void testCsvLoader() {
+    std::cout << "Testing CSV loader..." << std::endl;
+    {
+        std::ofstream csv("csv_test.csv", std::ios::binary);
+        csv << "id;\"width\";height;species\r\n";
+        for (int i = 0; i < 30000; ++i) {
+            const char* species = i % 3 == 0 ? "\"virginica\"" : (i % 3 == 1 ? "setosa" : "versicolor");
+            csv << i << "; " << i * 0.5 << ";" << -i << ";" << species << "\r\n";
+        }
+        csv << "30000;oops;1;setosa\r\n";
+        csv << "30001;1.0;2.0\r\n";
+        csv << "\r\n";
+        csv << "30002;1e3;-2.5e-1;setosa\r\n";
+        // one leading plus sign is accepted, as std::stod did
+        csv << "30003;+1.5; +2;setosa\r\n";
+        csv << "30004;+-1;1;setosa\r\n";
+        csv << "30005;1;++1;setosa";
+    }
+
+    DataLoader::CsvSpec spec;
+    spec.featureColumns = {2, 1};
+    spec.labelColumn = 3;
+    spec.hasHeader = true;
+    spec.delimiter = ';';
+    for (size_t threads : {1, 4}) {
+        spec.threads = threads;
+        DataLoader::BasicDataset<float> dataset = DataLoader::loadCSV<float>("csv_test.csv", spec);
+        assert(dataset.inputs.rows() == 30002 && dataset.inputs.cols() == 2);
+        assert(dataset.targets.rows() == 30002 && dataset.targets.cols() == 3);
+        assert((dataset.featureNames == std::vector<std::string>{"height", "width"}));
+        assert((dataset.classNames == std::vector<std::string>{"setosa", "versicolor", "virginica"}));
+        for (size_t i = 0; i < 30000; ++i) {
+            assert(dataset.inputs(i, 0) == -static_cast<float>(i));
+            assert(dataset.inputs(i, 1) == static_cast<float>(i * 0.5));
+            const size_t label = i % 3 == 0 ? 2 : (i % 3 == 1 ? 0 : 1);
+            for (size_t c = 0; c < 3; ++c) {
+                assert(dataset.targets(i, c) == (c == label ? 1.0f : 0.0f));
+            }
+        }
+        assert(dataset.inputs(30000, 0) == -0.25f && dataset.inputs(30000, 1) == 1000.0f);
+        assert(dataset.targets(30000, 0) == 1.0f);
+        assert(dataset.inputs(30001, 0) == 2.0f && dataset.inputs(30001, 1) == 1.5f);
+    }
+    std::remove("csv_test.csv");
+    std::cout << "CSV loader test passed!\n" << std::endl;
+}
+
+void testMappedDataset() {
+    std::cout << "Testing memory-mapped dataset files..." << std::endl;
+    {
+        std::ofstream csv("dataset_test.csv");
+        csv << "a,b,c,label\n";
+        for (int i = 0; i < 100; ++i) {
+            csv << i << "," << i * 0.25 << "," << 100 - i << "," << (i % 2 ? "odd" : "even") << "\n";
+        }
+    }
+    DataLoader::CsvSpec spec;
+    spec.featureColumns = {0, 1, 2};
+    spec.labelColumn = 3;
+    spec.hasHeader = true;
+    DataLoader::Dataset parsed = DataLoader::loadCSV("dataset_test.csv", spec);
+    DataLoader::convertCSV("dataset_test.csv", spec, "dataset_test.bin");
+
+    Matrix<double> batch;
+    {
+        DataLoader::MappedDataset mapped = DataLoader::mapDataset("dataset_test.bin");
+        assert(mapped.rows() == 100 && mapped.featureCount() == 3 && mapped.classCount() == 2);
+        assert(mapped.featureNames() == parsed.featureNames);
+        assert(mapped.classNames() == parsed.classNames);
+        for (size_t r = 0; r < mapped.rows(); ++r) {
+            assert(mapped.row(r).toVector() == parsed.inputs[r].toVector());
+            assert(mapped.labels()[r] == (r % 2 ? 1u : 0u));
+        }
+
+        // batches are views into the mapping, not copies
+        batch = mapped.batch(10, 20);
+        assert(batch.rows() == 20 && batch.data() == mapped.inputs().rowData(10));
+        Matrix<double> targets = mapped.targets(10, 20);
+        for (size_t r = 0; r < 20; ++r) {
+            assert(targets[r].toVector() == parsed.targets[10 + r].toVector());
+        }
+
+        DataLoader::Dataset dataset = mapped.toDataset();
+        assert(dataset.inputs.data() == mapped.inputs().data());
+        assert(dataset.targets.toNested() == parsed.targets.toNested());
+    }
+    // the view keeps the file mapped after the dataset is gone
+    assert(batch(0, 0) == 10.0 && batch(19, 2) == 71.0);
+
+    bool rejected = false;
+    try {
+        DataLoader::mapDataset<float>("dataset_test.bin");
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+    std::remove("dataset_test.csv");
+    std::remove("dataset_test.bin");
+    std::cout << "Mapped dataset test passed!\n" << std::endl;
+}
+
+void testIndexSplits() {
+    std::cout << "Testing index-based dataset splits..." << std::endl;
+    // 100 rows with a 60/30/10 class imbalance
+    DataLoader::Dataset dataset;
+    std::vector<int> labels;
+    dataset.inputs.resize(100, 2);
+    for (int i = 0; i < 100; ++i) {
+        dataset.inputs(i, 0) = i;
+        dataset.inputs(i, 1) = std::sin(i);
+        labels.push_back(i < 60 ? 0 : (i < 90 ? 1 : 2));
+    }
+    dataset.targets = DataLoader::oneHotEncode(labels, 3);
+
+    DataLoader::Split split = DataLoader::splitIndices(100, 0.6, 0.2, 0.2, SEED);
+    assert(split.train.size() == 60 && split.validation.size() == 20 && split.test.size() == 20);
+    DataLoader::Dataset trainSet, validationSet, testSet;
+    DataLoader::trainValidationTestSplit(dataset, trainSet, validationSet, testSet, 0.6, 0.2, 0.2, SEED);
+    assert(DataLoader::subset(dataset, split.validation).inputs.toNested() == validationSet.inputs.toNested());
+
+    auto countClasses = [&](const std::vector<size_t>& rows) {
+        std::vector<size_t> counts(3, 0);
+        for (size_t row : rows) counts[labels[row]]++;
+        return counts;
+    };
+    DataLoader::Split stratified = DataLoader::stratifiedSplit(dataset, 0.5, 0.3, 0.2, SEED);
+    assert((countClasses(stratified.train) == std::vector<size_t>{30, 15, 5}));
+    assert((countClasses(stratified.validation) == std::vector<size_t>{18, 9, 3}));
+    assert((countClasses(stratified.test) == std::vector<size_t>{12, 6, 2}));
+
+    for (const auto& folds : {DataLoader::kFold(100, 5, SEED), DataLoader::stratifiedKFold(dataset, 5, SEED)}) {
+        assert(folds.size() == 5);
+        std::vector<int> validated(100, 0);
+        for (const DataLoader::Split& fold : folds) {
+            assert(fold.train.size() + fold.validation.size() == 100 && fold.test.empty());
+            for (size_t row : fold.validation) validated[row]++;
+        }
+        assert(std::all_of(validated.begin(), validated.end(), [](int n) { return n == 1; }));
+    }
+    for (const DataLoader::Split& fold : DataLoader::stratifiedKFold(dataset, 5, SEED)) {
+        assert((countClasses(fold.validation) == std::vector<size_t>{12, 6, 2}));
+    }
+
+    // training on an index view matches training on the copied rows
+    DataLoader::Dataset copied = DataLoader::subset(dataset, stratified.train);
+    NeuralNetwork fromCopy({2, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    NeuralNetwork fromView({2, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    fromCopy.train(copied.inputs, copied.targets, 5, 0.01, 8);
+    fromView.train(dataset.inputs, dataset.targets, stratified.train, 5, 0.01, 8);
+    for (size_t r = 0; r < copied.inputs.rows(); ++r) {
+        assert(fromCopy.predict(copied.inputs[r]) == fromView.predict(copied.inputs[r]));
+    }
+    assert(fromCopy.evaluate(copied.inputs, copied.targets) ==
+           fromView.evaluate(dataset.inputs, dataset.targets, stratified.train));
+    std::cout << "Index split test passed!\n" << std::endl;
+}
+
+void testDataPipeline() {
+    std::cout << "Testing prefetching data pipeline..." << std::endl;
+    Matrix<double> inputs(50, 2);
+    Matrix<double> targets(50, 1);
+    for (size_t i = 0; i < 50; ++i) {
+        inputs(i, 0) = static_cast<double>(i);
+        inputs(i, 1) = 3.0;
+        targets(i, 0) = static_cast<double>(i % 2);
+    }
+
+    DataPipeline::Options options;
+    options.batchSize = 8;
+    options.seed = SEED;
+    options.slots = 3;
+    DataPipeline pipeline(inputs, targets, options);
+    DataPipeline twin(inputs, targets, options);
+    assert(pipeline.samples() == 50 && pipeline.batchesPerEpoch() == 7);
+    std::vector<std::vector<size_t>> epochs(2);
+    for (size_t epoch = 0; epoch < 2; ++epoch) {
+        for (size_t b = 0; b < pipeline.batchesPerEpoch(); ++b) {
+            const DataPipeline::Batch& batch = pipeline.next();
+            assert(batch.epoch == epoch && batch.inputs.rows() == (b < 6 ? 8u : 2u));
+            assert(batch.inputs.toNested() == twin.next().inputs.toNested());
+            for (size_t r = 0; r < batch.inputs.rows(); ++r) {
+                const size_t row = static_cast<size_t>(batch.inputs(r, 0));
+                assert(batch.targets(r, 0) == targets(row, 0));
+                epochs[epoch].push_back(row);
+            }
+        }
+        std::vector<size_t> sorted = epochs[epoch];
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            assert(sorted[i] == i);
+        }
+    }
+    // reshuffled every epoch
+    assert(epochs[0] != epochs[1]);
+
+    options.normalize = true;
+    DataPipeline normalized(inputs, targets, {10, 20, 30, 40}, options);
+    assert(normalized.featureMean()[0] == 25.0 && normalized.featureStd()[1] == 1.0);
+    const DataPipeline::Batch& batch = normalized.next();
+    double sum = 0.0;
+    for (size_t r = 0; r < batch.inputs.rows(); ++r) {
+        sum += batch.inputs(r, 0);
+        assert(batch.inputs(r, 1) == 3.0);
+    }
+    assert(batch.inputs.rows() == 4 && std::abs(sum) < 1e-12);
+
+    // without shuffling the pipeline feeds train() the same batches as the matrix overload
+    Matrix<double> xorInputs = {{0.0, 0.0}, {0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}};
+    Matrix<double> xorTargets = {{0.0}, {1.0}, {1.0}, {0.0}};
+    NeuralNetwork direct({2, 4, 1}, "sigmoid", "meanSquaredError", "SGD", SEED);
+    NeuralNetwork piped({2, 4, 1}, "sigmoid", "meanSquaredError", "SGD", SEED);
+    direct.train(xorInputs, xorTargets, 50, 0.5, 2);
+    DataPipeline::Options ordered;
+    ordered.batchSize = 2;
+    ordered.shuffle = false;
+    DataPipeline xorPipeline(xorInputs, xorTargets, ordered);
+    piped.train(xorPipeline, 50, 0.5);
+    for (size_t r = 0; r < xorInputs.rows(); ++r) {
+        assert(direct.predict(xorInputs[r]) == piped.predict(xorInputs[r]));
+    }
+    std::cout << "Data pipeline test passed!\n" << std::endl;
+}
+
+void testTrainingTelemetry() {
+    std::cout << "Testing training telemetry..." << std::endl;
+    Matrix<double> inputs = {{0.0, 0.0}, {0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}, {0.5, 0.5}};
+    Matrix<double> targets = {{0.0}, {1.0}, {1.0}, {0.0}, {1.0}};
+    NeuralNetwork nn({2, 8, 1}, "sigmoid", "meanSquaredError", "Adam", SEED);
+
+    std::vector<Telemetry::EpochMetrics> epochs;
+    nn.setMetricsSink(std::make_shared<Telemetry::CallbackSink>(
+        [&epochs](const Telemetry::EpochMetrics& metrics) { epochs.push_back(metrics); }));
+    // batches of 2 leave a partial one at the end of every epoch
+    nn.train(inputs, targets, 5, 0.05, 2);
+    assert(epochs.size() == 5);
+    for (size_t e = 0; e < epochs.size(); ++e) {
+        const Telemetry::EpochMetrics& m = epochs[e];
+        assert(m.epoch == static_cast<int>(e) && m.samples == 5 && m.batches == 3);
+        assert(m.loss > 0.0 && m.seconds > 0.0 && m.samplesPerSecond > 0.0);
+        // 2*2*8 + 2*8*1 multiply-adds per sample, the first layer has no input gradients
+        assert(m.flops == 5 * (2.0 * 16 * 2 + 2.0 * 8 * 3));
+        assert(m.times.layerForward.size() == 2 && m.times.layerBackward.size() == 2);
+        assert(m.times[Telemetry::Phase::Forward] > 0.0 && m.times[Telemetry::Phase::Optimizer] > 0.0);
+        assert(m.times[Telemetry::Phase::Forward] <= m.seconds * 1.01);
+        // training reaches a steady state where no matrix is reallocated
+        if (e > 0) assert(m.allocations == 0);
+    }
+
+    nn.setMetricsSink(std::make_shared<Telemetry::CsvSink>("telemetry_test.csv"));
+    nn.train(inputs, targets, 3, 0.05, 2);
+    nn.setMetricsSink(std::make_shared<Telemetry::JsonSink>("telemetry_test.json"));
+    nn.train(inputs, targets, 3, 0.05, 2);
+    nn.setMetricsSink(nullptr);
+    nn.train(inputs, targets, 3, 0.05, 2);
+
+    std::ifstream csv("telemetry_test.csv");
+    std::string line;
+    size_t lines = 0;
+    std::getline(csv, line);
+    assert(line.rfind("epoch,loss,samples", 0) == 0 && line.find("layer1_backward_seconds") != std::string::npos);
+    while (std::getline(csv, line)) lines++;
+    assert(lines == 3);
+    std::ifstream json("telemetry_test.json");
+    lines = 0;
+    while (std::getline(json, line)) {
+        assert(line.front() == '{' && line.back() == '}' && line.find("\"phases\"") != std::string::npos);
+        lines++;
+    }
+    assert(lines == 3);
+
+    // JSON has no NaN or infinity
+    Telemetry::EpochMetrics diverged;
+    diverged.loss = std::numeric_limits<double>::quiet_NaN();
+    diverged.samplesPerSecond = std::numeric_limits<double>::infinity();
+    {
+        Telemetry::JsonSink sink("telemetry_test.json");
+        sink.epoch(diverged);
+    }
+    std::ifstream divergedJson("telemetry_test.json");
+    std::getline(divergedJson, line);
+    assert(line.find("\"loss\": null,") != std::string::npos);
+    assert(line.find("\"samples_per_second\": null,") != std::string::npos);
+    assert(line.find("\"seconds\": 0,") != std::string::npos);
+    std::remove("telemetry_test.csv");
+    std::remove("telemetry_test.json");
+    std::cout << "Training telemetry test passed!\n" << std::endl;
+}
+
+void testInferenceServer() {
+    std::cout << "Testing micro-batching inference server..." << std::endl;
+    NeuralNetwork nn({4, 16, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    std::vector<std::vector<double>> inputs;
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (int i = 0; i < 64; ++i) {
+        inputs.push_back({dist(gen), dist(gen), dist(gen), dist(gen)});
+    }
+    auto matches = [&](const std::vector<double>& output, size_t i) {
+        std::vector<double> expected = nn.predict(inputs[i]);
+        if (output.size() != expected.size()) return false;
+        for (size_t j = 0; j < expected.size(); ++j) {
+            if (std::abs(output[j] - expected[j]) > 1e-12) return false;
+        }
+        return true;
+    };
+
+    // predictBatch agrees with one-row predict
+    Matrix<double> batch(inputs);
+    Matrix<double> outputs;
+    NeuralNetwork::Workspace workspace = nn.makeWorkspace();
+    nn.predictBatch(batch, outputs, workspace);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        assert(matches(outputs[i].toVector(), i));
+    }
+
+    InferenceServer::Options options;
+    options.maxBatchSize = 8;
+    options.maxQueueDelay = std::chrono::milliseconds(2);
+    options.socketPath = "inference_test.sock";
+    {
+        InferenceServer server(nn, options);
+        std::vector<std::thread> clients;
+        std::atomic<int> failures{0};
+        for (size_t c = 0; c < 8; ++c) {
+            clients.emplace_back([&, c] {
+                std::vector<std::future<std::vector<double>>> pending;
+                for (size_t i = c; i < inputs.size(); i += 8) {
+                    pending.push_back(server.submit(inputs[i]));
+                }
+                for (size_t k = 0; k < pending.size(); ++k) {
+                    if (!matches(pending[k].get(), c + 8 * k)) failures++;
+                }
+            });
+        }
+        for (size_t c = 0; c < 4; ++c) {
+            clients.emplace_back([&, c] {
+                InferenceClient client(options.socketPath);
+                for (size_t i = c; i < inputs.size(); i += 4) {
+                    if (!matches(client.predict(inputs[i]), i)) failures++;
+                }
+                bool rejected = false;
+                try {
+                    client.predict({1.0, 2.0});
+                } catch (const std::runtime_error&) {
+                    rejected = true;
+                }
+                // the connection stays usable after a rejected request
+                if (!rejected || !matches(client.predict(inputs[c]), c)) failures++;
+            });
+        }
+        for (std::thread& client : clients) {
+            client.join();
+        }
+        assert(failures == 0);
+
+        InferenceServer::Stats stats = server.stats();
+        assert(stats.requests == 64 + 64 + 4);
+        assert(stats.largestBatch <= 8 && stats.batches < stats.requests);
+
+        bool rejected = false;
+        try {
+            server.submit({1.0});
+        } catch (const std::invalid_argument&) {
+            rejected = true;
+        }
+        assert(rejected);
+
+        // short-lived clients one after another; their threads are reaped
+        // while the server keeps running
+        for (size_t c = 0; c < 20; ++c) {
+            InferenceClient client(options.socketPath);
+            assert(matches(client.predict(inputs[c]), c));
+        }
+    }
+
+    // a path that holds something other than a socket is left alone
+    {
+        const std::string path = "inference_test.not_socket";
+        std::ofstream(path) << "keep";
+        InferenceServer::Options fileOptions;
+        fileOptions.socketPath = path;
+        bool rejected = false;
+        try {
+            InferenceServer server(nn, fileOptions);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        std::ifstream kept(path);
+        std::string contents;
+        kept >> contents;
+        assert(rejected && contents == "keep");
+        std::remove(path.c_str());
+    }
+    std::cout << "Inference server test passed!\n" << std::endl;
+}
+
+void testDetailedEvaluation() {
+    std::cout << "Testing batched evaluation..." << std::endl;
+    // three classes, 600 rows: several evaluation blocks
+    std::mt19937 gen(SEED);
+    std::normal_distribution<double> noise(0.0, 0.5);
+    Matrix<double> inputs(600, 2);
+    std::vector<int> labels(600);
+    for (size_t i = 0; i < 600; ++i) {
+        labels[i] = static_cast<int>(i % 3);
+        inputs(i, 0) = labels[i] + noise(gen);
+        inputs(i, 1) = -labels[i] + noise(gen);
+    }
+    Matrix<double> targets = DataLoader::oneHotEncode(labels, 3);
+    NeuralNetwork nn({2, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    nn.setMetricsSink(nullptr);
+    nn.train(inputs, targets, 5, 0.01, 32);
+
+    NeuralNetwork::Evaluation serial = nn.evaluateDetailed(inputs, targets);
+    assert(serial.task == NeuralNetwork::Evaluation::Task::Classification && serial.samples == 600);
+    size_t correct = 0, total = 0;
+    double loss = 0.0;
+    for (size_t i = 0; i < 600; ++i) {
+        std::vector<double> output = nn.predict(inputs[i]);
+        size_t predicted = std::max_element(output.begin(), output.end()) - output.begin();
+        correct += predicted == static_cast<size_t>(labels[i]);
+        loss += LossFunction::crossEntropy(output, targets[i].toVector());
+    }
+    for (size_t a = 0; a < 3; ++a) {
+        for (size_t p = 0; p < 3; ++p) total += serial.confusion(a, p);
+    }
+    assert(total == 600 && serial.confusion(0, 0) + serial.confusion(1, 1) + serial.confusion(2, 2) == correct);
+    assert(serial.accuracy == correct / 600.0 && nn.evaluate(inputs, targets) == serial.accuracy);
+    assert(std::abs(serial.loss - loss / 600) < 1e-9);
+
+    nn.setThreadCount(4);
+    NeuralNetwork::Evaluation parallel = nn.evaluateDetailed(inputs, targets);
+    assert(parallel.accuracy == serial.accuracy && std::abs(parallel.loss - serial.loss) < 1e-12);
+    assert(parallel.confusion.toNested() == serial.confusion.toNested());
+
+    // a single 0/1 column is binary, anything else is scored within the tolerance
+    Matrix<double> xorInputs = {{0.0, 0.0}, {0.0, 1.0}, {1.0, 0.0}, {1.0, 1.0}};
+    Matrix<double> xorTargets = {{0.0}, {1.0}, {1.0}, {0.0}};
+    NeuralNetwork xorNet({2, 4, 1}, "sigmoid", "meanSquaredError", "SGD", SEED);
+    NeuralNetwork::Evaluation binary = xorNet.evaluateDetailed(xorInputs, xorTargets, std::vector<size_t>{1, 2, 3});
+    assert(binary.task == NeuralNetwork::Evaluation::Task::Binary && binary.samples == 3);
+    assert(binary.confusion.rows() == 2 && binary.confusion(0, 0) + binary.confusion(0, 1) == 1);
+    Matrix<double> regressionTargets = {{0.25}, {0.5}, {1.0}, {0.0}};
+    NeuralNetwork::Evaluation regression = xorNet.evaluateDetailed(xorInputs, regressionTargets, 1.0);
+    assert(regression.task == NeuralNetwork::Evaluation::Task::Regression);
+    assert(regression.confusion.empty() && regression.accuracy == 1.0);
+    std::cout << "Batched evaluation test passed!\n" << std::endl;
+}
+
+void testQuantization() {
+    std::cout << "Testing int8 post-training quantization..." << std::endl;
+    std::mt19937 gen(SEED);
+    DataLoader::Dataset data = syntheticClasses<double>(900, 6, gen);
+    const Matrix<double>& inputs = data.inputs;
+    const Matrix<double>& targets = data.targets;
+    NeuralNetwork nn({6, 64, 32, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    nn.setMetricsSink(nullptr);
+    nn.train(inputs, targets, 10, 0.01, 32);
+
+    // calibrate on a slice of the data, as with a held-out training subset
+    std::vector<size_t> calibrationRows(200);
+    std::iota(calibrationRows.begin(), calibrationRows.end(), size_t(0));
+    NeuralNetwork int8 = nn.quantized(inputs, calibrationRows);
+    assert(int8.getInputSize() == 6 && int8.getOutputSize() == 3);
+    assert(int8.getParameterBytes() * 4 < nn.getParameterBytes());
+
+    NeuralNetwork::Evaluation reference = nn.evaluateDetailed(inputs, targets);
+    NeuralNetwork::Evaluation quantized = int8.evaluateDetailed(inputs, targets);
+    std::cout << "Float accuracy " << reference.accuracy << ", int8 accuracy " << quantized.accuracy
+              << ", " << nn.getParameterBytes() << " -> " << int8.getParameterBytes() << " bytes" << std::endl;
+    assert(reference.accuracy > 0.9 && std::abs(quantized.accuracy - reference.accuracy) <= 0.02);
+    assert(std::abs(quantized.loss - reference.loss) < 0.05);
+
+    // single-row and batched inference agree, and stay close to the float model
+    NeuralNetwork::Workspace workspace = int8.makeWorkspace();
+    Matrix<double> batchOutputs;
+    int8.predictBatch(inputs, batchOutputs, workspace);
+    double largestError = 0.0;
+    for (size_t i = 0; i < 900; i += 7) {
+        std::vector<double> single = int8.predict(inputs[i]);
+        std::vector<double> exact = nn.predict(inputs[i]);
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(single[j] - batchOutputs(i, j)) < 1e-12);
+            largestError = std::max(largestError, std::abs(single[j] - exact[j]));
+        }
+    }
+    assert(largestError < 0.1);
+
+    // a float network quantizes too; inference only
+    BasicNeuralNetwork<float> small({6, 8, 3}, "sigmoid", "softmax", "crossEntropy", "SGD", SEED);
+    Matrix<float> floatInputs(4, 6, 0.5f);
+    BasicNeuralNetwork<float> smallInt8 = small.quantized(floatInputs);
+    assert(std::abs(smallInt8.predict(floatInputs[0])[0] - small.predict(floatInputs[0])[0]) < 0.05f);
+
+    bool threw = false;
+    try {
+        int8.train(inputs, targets, 1, 0.01);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    threw = false;
+    try {
+        int8.save("quantized_model.bin");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    std::cout << "Quantization test passed!\n" << std::endl;
+}
+
+void testInferencePlan() {
+    std::cout << "Testing compiled inference plans..." << std::endl;
+    NeuralNetwork nn({6, 64, 32, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    // more rows than one block, and a ragged last block
+    Matrix<double> inputs(150, 6);
+    for (size_t i = 0; i < inputs.rows(); ++i)
+        for (size_t j = 0; j < 6; ++j) inputs(i, j) = dist(gen);
+
+    InferencePlan plan = nn.compile();
+    assert(plan.getInputSize() == 6 && plan.getOutputSize() == 3 && plan.getLayerCount() == 3);
+    // the widest layer is packed, the small and narrow ones read directly
+    assert(plan.getKernel(0) == InferencePlan::Kernel::Direct);
+    assert(plan.getKernel(1) == InferencePlan::Kernel::Packed);
+    assert(plan.getKernel(2) == InferencePlan::Kernel::Direct);
+
+    NeuralNetwork::Workspace workspace = nn.makeWorkspace();
+    InferencePlan::Workspace planWorkspace = plan.makeWorkspace();
+    Matrix<double> expected, outputs;
+    nn.predictBatch(inputs, expected, workspace);
+    plan.predictBatch(inputs, outputs, planWorkspace);
+    assert(outputs.rows() == 150 && outputs.cols() == 3);
+    std::vector<double> single(3);
+    for (size_t i = 0; i < inputs.rows(); ++i) {
+        plan.predict(inputs[i], Span<double>(single), planWorkspace);
+        std::vector<double> reference = nn.predict(inputs[i]);
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(outputs(i, j) - expected(i, j)) < 1e-12);
+            assert(std::abs(single[j] - reference[j]) < 1e-12);
+        }
+    }
+
+    // a float plan, and a workspace that was never sized
+    BasicNeuralNetwork<float> small({4, 5, 2}, "sigmoid", "linear", "meanSquaredError", "SGD", SEED);
+    BasicInferencePlan<float> smallPlan = small.compile();
+    BasicInferencePlan<float>::Workspace empty;
+    std::vector<float> x = {0.1f, -0.2f, 0.3f, 0.4f}, y(2);
+    smallPlan.predict(Span<const float>(x), Span<float>(y), empty);
+    std::vector<float> reference = small.predict(x);
+    assert(std::abs(y[0] - reference[0]) < 1e-6f && std::abs(y[1] - reference[1]) < 1e-6f);
+
+    // only built-in activations on floating-point layers compile
+    NeuralNetwork custom;
+    custom.addLayer(std::make_unique<BasicLayer<double>>(
+        2, 2, [](double v) { return std::tanh(v); }, [](double v) { return 1.0 - v * v; }, SEED));
+    assert(!InferencePlan::supports(custom) && !InferencePlan::supports(NeuralNetwork()));
+    bool threw = false;
+    try {
+        custom.compile();
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(!InferencePlan::supports(nn.quantized(inputs)));
+    std::cout << "Inference plan test passed!\n" << std::endl;
+}
+
+void testStaticNetwork() {
+    std::cout << "Testing compile-time fixed-topology networks..." << std::endl;
+    NeuralNetwork nn({4, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    StaticNetwork<double, 4, 8, 3> fixed(nn);
+    static_assert(StaticNetwork<double, 4, 8, 3>::InputSize == 4, "input size");
+    static_assert(StaticNetwork<double, 4, 8, 3>::OutputSize == 3, "output size");
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> dist(-2.0, 2.0);
+    for (int i = 0; i < 50; ++i) {
+        std::array<double, 4> x = {dist(gen), dist(gen), dist(gen), dist(gen)};
+        std::array<double, 3> y = fixed.predict(x);
+        std::vector<double> expected = nn.predict(std::vector<double>(x.begin(), x.end()));
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(y[j] - expected[j]) < 1e-12);
+        }
+    }
+
+    // from a saved float model, with two hidden layers
+    BasicNeuralNetwork<float> small({3, 5, 4, 2}, "sigmoid", "linear", "meanSquaredError", "SGD", SEED);
+    small.save("static_model_test.bin");
+    auto loaded = StaticNetwork<float, 3, 5, 4, 2>::load("static_model_test.bin");
+    std::remove("static_model_test.bin");
+    std::vector<float> x = {0.3f, -0.7f, 1.1f};
+    std::vector<float> expected = small.predict(x);
+    float y[2];
+    loaded.predict(x.data(), y);
+    assert(std::abs(y[0] - expected[0]) < 1e-5f && std::abs(y[1] - expected[1]) < 1e-5f);
+
+    auto rejects = [](const NeuralNetwork& network) {
+        try {
+            StaticNetwork<double, 4, 8, 3> wrong(network);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    assert(rejects(NeuralNetwork({4, 9, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED)));
+    assert(rejects(NeuralNetwork({4, 8, 8, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED)));
+    NeuralNetwork custom;
+    custom.addLayer(std::make_unique<BasicLayer<double>>(
+        4, 8, [](double v) { return std::tanh(v); }, [](double v) { return 1.0 - v * v; }, SEED));
+    custom.addLayer(std::make_unique<BasicLayer<double>>(8, 3, true, SEED));
+    assert(rejects(custom));
+    std::cout << "Static network test passed!\n" << std::endl;
+}
+
+void testMixedPrecision() {
+    std::cout << "Testing bfloat16 mixed-precision training..." << std::endl;
+    auto bits = [](float value) { return BFloat16(value).bits; };
+    auto fromBits = [](uint32_t u) {
+        float value;
+        std::memcpy(&value, &u, sizeof(value));
+        return value;
+    };
+    assert(bits(1.0f) == 0x3f80 && bits(-2.0f) == 0xc000);
+    // ties round to even, everything else to nearest
+    assert(bits(fromBits(0x3f808000u)) == 0x3f80 && bits(fromBits(0x3f818000u)) == 0x3f82);
+    assert(bits(fromBits(0x3f808001u)) == 0x3f81);
+    assert(bits(std::numeric_limits<float>::infinity()) == 0x7f80);
+    assert(std::isnan(static_cast<float>(BFloat16(std::numeric_limits<float>::quiet_NaN()))));
+    assert(bits(fromBits(0x807fffffu)) == 0x8000); // subnormals flush to signed zero
+
+    // the dispatched array kernels agree with the scalar rounding bit for bit,
+    // including the tail after the last full vector
+    std::mt19937 gen(SEED);
+    std::uniform_int_distribution<uint32_t> anyBits;
+    std::vector<float> values(1000);
+    for (float& v : values) v = fromBits(anyBits(gen));
+    values[3] = fromBits(0x3f808000u);
+    std::vector<BFloat16> rounded(values.size());
+    Precision::convert(values.data(), rounded.data(), values.size());
+    std::vector<float> widened(values.size());
+    Precision::convert(rounded.data(), widened.data(), values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        assert(rounded[i].bits == bits(values[i]));
+        const float exact = static_cast<float>(rounded[i]);
+        assert(std::memcmp(&widened[i], &exact, sizeof(float)) == 0);
+    }
+
+    DataLoader::BasicDataset<float> data = syntheticClasses<float>(600, 8, gen);
+    const Matrix<float>& inputs = data.inputs;
+    const Matrix<float>& targets = data.targets;
+
+    BasicNeuralNetwork<float> full({8, 64, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    BasicNeuralNetwork<float> mixed({8, 64, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    full.setMetricsSink(nullptr);
+    mixed.setMetricsSink(nullptr);
+    mixed.setMixedPrecision(true);
+    assert(mixed.isMixedPrecision() && mixed.getLayer(0).isMixedPrecision());
+    full.train(inputs, targets, 5, 0.01f, 32);
+    mixed.train(inputs, targets, 5, 0.01f, 32);
+
+    BasicNeuralNetwork<float>::Evaluation fullResult = full.evaluateDetailed(inputs, targets);
+    BasicNeuralNetwork<float>::Evaluation mixedResult = mixed.evaluateDetailed(inputs, targets);
+    assert(mixedResult.accuracy > 0.9 && std::abs(mixedResult.accuracy - fullResult.accuracy) <= 0.02);
+    assert(std::abs(mixedResult.loss - fullResult.loss) < 0.05);
+
+    // the master weights keep the small updates bfloat16 would round away
+    const Matrix<float>& master = mixed.getLayer(0).getWeights();
+    size_t unrepresentable = 0;
+    for (size_t j = 0; j < 8; ++j) {
+        if (static_cast<float>(BFloat16(master(0, j))) != master(0, j)) ++unrepresentable;
+    }
+    assert(unrepresentable > 0);
+
+    // single-row and batched inference both read the bfloat16 weights
+    BasicNeuralNetwork<float>::Workspace workspace = mixed.makeWorkspace();
+    Matrix<float> batchOutputs;
+    mixed.predictBatch(inputs, batchOutputs, workspace);
+    for (size_t i = 0; i < 600; i += 13) {
+        std::vector<float> single = mixed.predict(inputs[i]);
+        for (size_t j = 0; j < 3; ++j) {
+            assert(std::abs(single[j] - batchOutputs(i, j)) < 1e-5f);
+        }
+    }
+
+    // so do the single-sample and batched backward passes
+    BasicLayer<float> layer = mixed.getLayer(0);
+    Matrix<float> row(1, 8), rowGradients(1, 64);
+    std::vector<float> gradients(64);
+    std::normal_distribution<float> noise(0.0f, 0.4f);
+    for (size_t j = 0; j < 8; ++j) row(0, j) = inputs(5, j);
+    for (size_t j = 0; j < 64; ++j) rowGradients(0, j) = gradients[j] = noise(gen);
+    layer.forward(Span<const float>(row.rowData(0), 8));
+    std::vector<float> singleGradients = layer.backward(gradients);
+    Matrix<float> singleWeightGradients = layer.getWeightGradients();
+    layer.forwardBatch(row);
+    const Matrix<float>& batchGradients = layer.backwardBatch(rowGradients);
+    for (size_t j = 0; j < 8; ++j) {
+        assert(std::abs(singleGradients[j] - batchGradients(0, j)) < 1e-5f);
+    }
+    const Matrix<float>& batchWeightGradients = layer.getWeightGradients();
+    for (size_t i = 0; i < 64; ++i) {
+        for (size_t j = 0; j < 8; ++j) {
+            assert(std::abs(singleWeightGradients(i, j) - batchWeightGradients(i, j)) < 1e-6f);
+        }
+    }
+
+    mixed.setMixedPrecision(false);
+    assert(!mixed.getLayer(0).isMixedPrecision());
+    std::cout << "Mixed precision test passed!\n" << std::endl;
+}
+
+void testSparse() {
+    std::cout << "Testing magnitude pruning and sparse layers..." << std::endl;
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+    // the CSR kernels against dense products, for a batch that leaves a tail
+    // after the blocks of four rows and one large enough to be transposed,
+    // with some empty weight rows
+    const size_t rows = 13, cols = 37;
+    Matrix<double> dense(rows, cols);
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t c = 0; c < cols; ++c) {
+            dense(r, c) = r % 5 == 2 || uniform(gen) < 0.4 ? 0.0 : uniform(gen);
+        }
+    }
+    Sparse::CsrMatrix<double> csr = Sparse::fromDense(dense);
+    assert(csr.rowStart.size() == rows + 1 && csr.rowStart[3] == csr.rowStart[2]);
+    for (size_t M : {size_t(7), size_t(37)}) {
+        Matrix<double> X(M, cols), D(M, rows);
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t c = 0; c < cols; ++c) X(i, c) = uniform(gen);
+            for (size_t r = 0; r < rows; ++r) D(i, r) = r % 3 == 0 ? 0.0 : uniform(gen);
+        }
+        Matrix<double> Y(M, rows, 1.0), G(M, cols, 5.0);
+        std::vector<double> gradients(csr.nonZeros());
+        Sparse::multiply(M, X.data(), X.stride(), csr, Y.data(), Y.stride());
+        Sparse::multiplyTransposed(M, D.data(), D.stride(), csr, G.data(), G.stride());
+        Sparse::gradients(M, 0.5, D.data(), D.stride(), X.data(), X.stride(), csr, gradients.data());
+        for (size_t i = 0; i < M; ++i) {
+            for (size_t r = 0; r < rows; ++r) {
+                double y = 1.0;
+                for (size_t c = 0; c < cols; ++c) y += X(i, c) * dense(r, c);
+                assert(std::abs(Y(i, r) - y) < 1e-12);
+            }
+            for (size_t c = 0; c < cols; ++c) {
+                double g = 0.0;
+                for (size_t r = 0; r < rows; ++r) g += D(i, r) * dense(r, c);
+                assert(std::abs(G(i, c) - g) < 1e-12);
+            }
+        }
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t k = csr.rowStart[r]; k < csr.rowStart[r + 1]; ++k) {
+                double g = 0.0;
+                for (size_t i = 0; i < M; ++i) g += D(i, r) * X(i, csr.columns[k]);
+                assert(std::abs(gradients[k] - 0.5 * g) < 1e-12);
+            }
+        }
+    }
+
+    // pruning zeroes exactly the smallest weights
+    Layer layer(40, 30, ActivationFunctions::Kind::Relu, SEED);
+    std::vector<double> magnitudes;
+    for (size_t o = 0; o < 30; ++o) {
+        for (size_t i = 0; i < 40; ++i) magnitudes.push_back(std::abs(layer.getWeights()(o, i)));
+    }
+    std::sort(magnitudes.begin(), magnitudes.end());
+    layer.prune(0.9);
+    assert(layer.getSparsity() == 0.9);
+    for (size_t o = 0; o < 30; ++o) {
+        for (size_t i = 0; i < 40; ++i) {
+            const double w = layer.getWeights()(o, i);
+            assert(w == 0.0 || std::abs(w) >= magnitudes[1080]);
+        }
+    }
+    bool rejected = false;
+    try {
+        layer.prune(1.5);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    // a sparse copy computes the same activations and gradients as the
+    // pruned dense layer, with the weight gradients restricted to its nonzeros
+    Layer sparse = layer;
+    sparse.sparsify();
+    assert(sparse.isSparse() && sparse.getWeights().empty() && sparse.getSparsity() == 0.9);
+    assert(sparse.getSparseWeights().nonZeros() == 120);
+    Matrix<double> batch(9, 40), upstream(9, 30);
+    for (size_t i = 0; i < 9; ++i) {
+        for (size_t j = 0; j < 40; ++j) batch(i, j) = uniform(gen);
+        for (size_t j = 0; j < 30; ++j) upstream(i, j) = uniform(gen);
+    }
+    const Matrix<double> denseOutputs = layer.forwardBatch(batch);
+    const Matrix<double>& sparseOutputs = sparse.forwardBatch(batch);
+    for (size_t i = 0; i < 9; ++i) {
+        for (size_t j = 0; j < 30; ++j) assert(std::abs(denseOutputs(i, j) - sparseOutputs(i, j)) < 1e-12);
+    }
+    const Matrix<double> denseInputGradients = layer.backwardBatch(upstream);
+    const Matrix<double>& sparseInputGradients = sparse.backwardBatch(upstream);
+    for (size_t i = 0; i < 9; ++i) {
+        for (size_t j = 0; j < 40; ++j) {
+            assert(std::abs(denseInputGradients(i, j) - sparseInputGradients(i, j)) < 1e-12);
+        }
+    }
+    const Sparse::CsrMatrix<double>& weights = sparse.getSparseWeights();
+    for (size_t r = 0; r < 30; ++r) {
+        for (size_t k = weights.rowStart[r]; k < weights.rowStart[r + 1]; ++k) {
+            assert(std::abs(sparse.getWeightGradients()(0, k) -
+                            layer.getWeightGradients()(r, weights.columns[k])) < 1e-12);
+        }
+    }
+    std::vector<double> single = sparse.forward(batch[0]);
+    for (size_t j = 0; j < 30; ++j) assert(std::abs(single[j] - denseOutputs(0, j)) < 1e-12);
+    sparse.backward(std::vector<double>(upstream[0].begin(), upstream[0].end()));
+    assert(sparse.getWeightGradients().cols() == 120);
+    rejected = false;
+    try {
+        sparse.setMixedPrecision(true);
+    } catch (const std::logic_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+
+    DataLoader::Dataset data = syntheticClasses<double>(600, 8, gen);
+    const Matrix<double>& inputs = data.inputs;
+    const Matrix<double>& targets = data.targets;
+
+    // one-shot pruning of a trained network, then sparse fine-tuning that
+    // keeps the pattern
+    NeuralNetwork network({8, 128, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    network.setMetricsSink(nullptr);
+    network.train(inputs, targets, 5, 0.01, 32);
+    const size_t denseBytes = network.getParameterBytes();
+    network.prune(0.9);
+    NeuralNetwork::Evaluation pruned = network.evaluateDetailed(inputs, targets);
+    Matrix<double> prunedOutputs;
+    NeuralNetwork::Workspace workspace = network.makeWorkspace();
+    network.predictBatch(inputs, prunedOutputs, workspace);
+    network.sparsify();
+    assert(network.getSparsity() >= 0.89 && network.getParameterBytes() < denseBytes / 3);
+    Matrix<double> sparseBatchOutputs;
+    network.predictBatch(inputs, sparseBatchOutputs, workspace);
+    for (size_t i = 0; i < 600; ++i) {
+        for (size_t j = 0; j < 3; ++j) assert(std::abs(sparseBatchOutputs(i, j) - prunedOutputs(i, j)) < 1e-12);
+    }
+    const double sparsity = network.getSparsity();
+    network.train(inputs, targets, 5, 0.01, 32);
+    NeuralNetwork::Evaluation tuned = network.evaluateDetailed(inputs, targets);
+    assert(network.getSparsity() == sparsity);
+    assert(tuned.loss < pruned.loss && tuned.accuracy > 0.9);
+    rejected = false;
+    try {
+        network.save("sparse_model.bin");
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    assert(rejected && !InferencePlan::supports(network));
+
+    // gradual pruning: the target is reached by the last scheduled epoch and
+    // the masked weights stay at zero while training goes on
+    NeuralNetwork gradual({8, 128, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    gradual.setMetricsSink(nullptr);
+    gradual.setPruningSchedule({0.8, 1, 4});
+    gradual.train(inputs, targets, 2, 0.01, 32);
+    const double early = gradual.getSparsity();
+    assert(early > 0.3 && early < 0.8);
+    gradual.train(inputs, targets, 8, 0.01, 32);
+    assert(gradual.getSparsity() >= 0.79 && gradual.getSparsity() < 0.81);
+    assert(gradual.evaluate(inputs, targets) > 0.9);
+    std::cout << "Sparse test passed!\n" << std::endl;
+}
+
+void testAsynchronousTraining() {
+    std::cout << "Testing asynchronous (Hogwild) training..." << std::endl;
+    std::mt19937 gen(SEED);
+    DataLoader::Dataset data = syntheticClasses<double>(600, 8, gen);
+    const Matrix<double>& inputs = data.inputs;
+    const Matrix<double>& targets = data.targets;
+
+    // one thread: shuffled per-sample SGD, reproducible for a fixed seed
+    NeuralNetwork first({8, 32, 3}, "relu", "softmax", "crossEntropy", "SGD", SEED);
+    NeuralNetwork second({8, 32, 3}, "relu", "softmax", "crossEntropy", "SGD", SEED);
+    for (NeuralNetwork* network : {&first, &second}) {
+        network->setMetricsSink(nullptr);
+        network->setAsynchronous(true, 7);
+        network->train(inputs, targets, 3, 0.05, 1);
+    }
+    assert(first.isAsynchronous() && first.evaluate(inputs, targets) > 0.9);
+    for (size_t i = 0; i < first.getLayerCount(); ++i) {
+        const Matrix<double>& a = first.getLayer(i).getWeights();
+        const Matrix<double>& b = second.getLayer(i).getWeights();
+        assert(std::equal(a.data(), a.data() + a.capacity(), b.data()));
+    }
+
+    // several threads updating the shared weights without locks, each with
+    // its own momentum, on a subset of the rows
+    NeuralNetwork shared({8, 32, 3}, "relu", "softmax", "crossEntropy", "Momentum", SEED);
+    shared.setMetricsSink(nullptr);
+    shared.setThreadCount(4);
+    shared.setAsynchronous(true, 7);
+    std::vector<size_t> rows(400);
+    std::iota(rows.begin(), rows.end(), size_t(100));
+    shared.train(inputs, targets, rows, 4, 0.01, 2);
+    assert(shared.evaluate(inputs, targets) > 0.9);
+
+    // the pattern of a sparse network survives the racing updates
+    shared.prune(0.5);
+    shared.sparsify();
+    const double sparsity = shared.getSparsity();
+    shared.train(inputs, targets, 2, 0.01, 2);
+    assert(shared.getSparsity() == sparsity && shared.evaluate(inputs, targets) > 0.9);
+
+    // so does the mask of a dense one, with Adam moments from before pruning
+    NeuralNetwork masked({8, 32, 3}, "relu", "softmax", "crossEntropy", "Adam", SEED);
+    masked.setMetricsSink(nullptr);
+    masked.setThreadCount(4);
+    masked.setAsynchronous(true, 7);
+    masked.train(inputs, targets, 1, 0.01, 2);
+    masked.prune(0.5);
+    const double maskedSparsity = masked.getSparsity();
+    masked.train(inputs, targets, 2, 0.01, 2);
+    assert(masked.getSparsity() == maskedSparsity && masked.evaluate(inputs, targets) > 0.9);
+
+    NeuralNetwork mixed({8, 32, 3}, "relu", "softmax", "crossEntropy", "SGD", SEED);
+    mixed.setMetricsSink(nullptr);
+    mixed.setMixedPrecision(true);
+    mixed.setAsynchronous(true);
+    bool rejected = false;
+    try {
+        mixed.train(inputs, targets, 1, 0.05, 1);
+    } catch (const std::logic_error&) {
+        rejected = true;
+    }
+    assert(rejected);
+    mixed.setAsynchronous(false);
+    assert(!mixed.isAsynchronous());
+    std::cout << "Asynchronous training test passed!\n" << std::endl;
+}
+
 void testIrisDataset() {
     std::cout << "Testing Iris Dataset Classification..." << std::endl;
     
@@ -173,7 +1577,8 @@ void testIrisDataset() {
     
     auto analyzeDistribution = [&](const DataLoader::Dataset& set, const std::string& setName) {
         std::vector<int> classCount(dataset.classNames.size(), 0);
-        for (const auto& target : set.targets) {
+        for (size_t row = 0; row < set.targets.rows(); ++row) {
+            Span<const double> target = set.targets[row];
             for (size_t i = 0; i < target.size(); ++i) {
                 if (target[i] == 1.0) {
                     classCount[i]++;
@@ -206,7 +1611,7 @@ void testIrisDataset() {
 
     std::cout << "Predicting on test set..." << std::endl;
     int correctPredictions = 0;
-    for (size_t i = 0; i < testSet.inputs.size(); ++i) {
+    for (size_t i = 0; i < testSet.inputs.rows(); ++i) {
         std::vector<double> prediction = nn.predict(testSet.inputs[i]);
         int predictedClass = std::distance(prediction.begin(), std::max_element(prediction.begin(), prediction.end()));
         std::cout << "Input: ";
@@ -221,7 +1626,7 @@ void testIrisDataset() {
         }
         assert(predictedClass == actualClass || validation_accuracy > 0.8);
     }
-    double test_accuracy = static_cast<double>(correctPredictions) / testSet.inputs.size();
+    double test_accuracy = static_cast<double>(correctPredictions) / testSet.inputs.rows();
     std::cout << "Test accuracy: " << test_accuracy * 100 << "%" << std::endl;
     assert(test_accuracy > 0.8);
     std::cout << "Iris dataset classification test passed!\n" << std::endl;
@@ -231,9 +1636,30 @@ int main() {
     std::cout << "Running tests..." << std::endl;
 
     testActivationFunctions();
+    testActivationKernels();
     testLossFunctions();
     testLayer();
+    testActivationDispatch();
+    testOptimizers();
+    testGemm();
     testXOR();
+    testMiniBatch();
+    testFloatNetwork();
+    testDataParallelTraining();
+    testModelSerialization();
+    testCsvLoader();
+    testMappedDataset();
+    testIndexSplits();
+    testDataPipeline();
+    testTrainingTelemetry();
+    testInferenceServer();
+    testDetailedEvaluation();
+    testQuantization();
+    testInferencePlan();
+    testStaticNetwork();
+    testMixedPrecision();
+    testSparse();
+    testAsynchronousTraining();
     testIrisDataset();
 
     std::cout << "All tests passed!" << std::endl;